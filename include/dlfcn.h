@@ -38,6 +38,7 @@ extern "C" {
 
 #if !defined(_POSIX_C_SOURCE) || defined(_DARWIN_C_SOURCE)
 #include <stdbool.h>
+#include <stddef.h>
 #include <Availability.h>
 /*
  * Structure filled in by dladdr().
@@ -50,6 +51,7 @@ typedef struct dl_info {
 } Dl_info;
 
 extern int dladdr(const void *, Dl_info *);
+extern size_t dladdr_batch(const void * const __addrs[], Dl_info __infos[], size_t __count) __OSX_AVAILABLE_STARTING(__MAC_10_7, __IPHONE_5_0);
 #endif /* not POSIX */
 
 extern int dlclose(void * __handle);
@@ -71,6 +73,7 @@ extern bool dlopen_preflight(const char* __path) __OSX_AVAILABLE_STARTING(__MAC_
 #define RTLD_NOLOAD	0x10
 #define RTLD_NODELETE	0x80
 #define RTLD_FIRST	0x100	/* Mac OS X 10.5 and later */
+#define RTLD_NOCACHE	0x200	/* forget search paths found missing by earlier loads */
 
 /*
  * Special handle arguments for dlsym().
@@ -74,6 +74,12 @@ public:
 	uint64_t		cacheType() const				INLINE { return E::get64(fields.cacheType); }
 	void			set_cacheType(uint64_t value)	INLINE { E::set64(fields.cacheType, value); }
 
+	uint64_t		pathHashOffset() const					INLINE { return E::get64(fields.pathHashOffset); }
+	void			set_pathHashOffset(uint64_t value)		INLINE { E::set64(fields.pathHashOffset, value); }
+
+	uint64_t		pathHashSize() const					INLINE { return E::get64(fields.pathHashSize); }
+	void			set_pathHashSize(uint64_t value)		INLINE { E::set64(fields.pathHashSize, value); }
+
 private:
 	dyld_cache_header			fields;
 };
@@ -199,6 +205,34 @@ private:
 };
 
 
+template <typename E>
+class dyldCachePathHashInfo {
+public:		
+	uint32_t		version() const								INLINE { return E::get32(fields.version); }
+	void			set_version(uint32_t value)					INLINE { E::set32(fields.version, value); }
+
+	uint32_t		bucketCount() const							INLINE { return E::get32(fields.bucketCount); }
+	void			set_bucketCount(uint32_t value)				INLINE { E::set32(fields.bucketCount, value); }
+
+private:
+	dyld_cache_path_hash_info				fields;
+};
+
+
+template <typename E>
+class dyldCachePathHashBucket {
+public:		
+	uint32_t		hash() const								INLINE { return E::get32(fields.hash); }
+	void			set_hash(uint32_t value)					INLINE { E::set32(fields.hash, value); }
+
+	uint32_t		imageIndex() const							INLINE { return E::get32(fields.imageIndex); }
+	void			set_imageIndex(uint32_t value)				INLINE { E::set32(fields.imageIndex, value); }
+
+private:
+	dyld_cache_path_hash_bucket				fields;
+};
+
+
 
 
 #endif // __DYLD_CACHE_ABSTRACTION__
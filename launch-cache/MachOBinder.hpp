@@ -75,6 +75,7 @@ public:
 		bool operator()(const char* left, const char* right) const { return (strcmp(left, right) == 0); }
 	};
 	typedef std::unordered_map<const char*, class Binder<A>*, CStringHash, CStringEquals> Map;
+	struct ResolverClient { Binder<A>* resolverDylib; const char* symbolName; };
 
 
 												Binder(const MachOLayoutAbstraction&);
@@ -82,9 +83,14 @@ public:
 	
 	const char*									getDylibID() const;
 	void										setDependentBinders(const Map& map);
+	void										resolveReExportedSymbols();
 	void										bind(std::vector<void*>&);
+	void										recordResolverClients();
 	void										optimize();
     void                                        addResolverClient(Binder<A>* clientDylib, const char* symbolName);
+	uint32_t									dependentDylibCount() const;
+	Binder<A>*									dependentDylib(uint32_t index, bool* reExport) const;
+	const std::vector<ResolverClient>&			pendingResolverClients() const;
 private:
 	typedef typename A::P					P;
 	typedef typename A::P::E				E;
@@ -133,6 +139,7 @@ private:
 	bool										fOriginallyPrebound;
 	bool										fReExportedSymbolsResolved;
 	ResolverClientsMap							fResolverInfo;
+	std::vector<ResolverClient>					fPendingResolverClients;
 };
 
 template <> 
@@ -432,6 +439,12 @@ void Binder<A>::hoistPrivateRexports()
 }
 
 
+//
+// bind() may run concurrently for different dylibs.  To make that safe it only writes
+// to this dylib's mapped segments, pointersInData, and fPendingResolverClients.  Callers
+// must first call resolveReExportedSymbols() on every binder (so lookups are read-only),
+// and afterwards call recordResolverClients() on each binder, in order, on one thread.
+//
 template <typename A>
 void Binder<A>::bind(std::vector<void*>& pointersInData)
 {
@@ -440,6 +453,34 @@ void Binder<A>::bind(std::vector<void*>& pointersInData)
 	// weak bind info is processed at launch time
 }
 
+template <typename A>
+void Binder<A>::recordResolverClients()
+{
+	for (typename std::vector<ResolverClient>::iterator it=fPendingResolverClients.begin(); it != fPendingResolverClients.end(); ++it)
+		it->resolverDylib->addResolverClient(this, it->symbolName);
+	fPendingResolverClients.clear();
+}
+
+template <typename A>
+const std::vector<typename Binder<A>::ResolverClient>& Binder<A>::pendingResolverClients() const
+{
+	return fPendingResolverClients;
+}
+
+template <typename A>
+uint32_t Binder<A>::dependentDylibCount() const
+{
+	return fDependentDylibs.size();
+}
+
+// returns NULL for a missing weak dylib
+template <typename A>
+Binder<A>* Binder<A>::dependentDylib(uint32_t index, bool* reExport) const
+{
+	*reExport = fDependentDylibs[index].reExport;
+	return fDependentDylibs[index].binder;
+}
+
 template <typename A>
 void Binder<A>::bindDyldInfoAt(uint8_t segmentIndex, uint64_t segmentOffset, uint8_t type, int libraryOrdinal, 
 							int64_t addend, const char* symbolName, bool lazyPointer, bool weakImport, std::vector<void*>& pointersInData)
@@ -483,7 +524,9 @@ void Binder<A>::bindDyldInfoAt(uint8_t segmentIndex, uint64_t segmentOffset, uin
 	if ( lazyPointer && isResolverSymbol ) {
         if ( foundIn != this ) {
 			// record that this dylib has a lazy pointer to a resolver function
-            foundIn->addResolverClient(this, symbolName);
+			// (applied to foundIn by recordResolverClients(), foundIn may be binding on another thread)
+			ResolverClient client = { foundIn, symbolName };
+			fPendingResolverClients.push_back(client);
            // fprintf(stderr, "have lazy pointer to resolver %s in %s\n", symbolName, this->getDylibID());
         }
 		return;
@@ -670,36 +713,43 @@ void Binder<A>::doBindDyldInfo(std::vector<void*>& pointersInData)
 	}
 }
 
+// since re-export chains can be any length, re-exports cannot be resolved in setDependencies()
+// instead we lazily, recursively update 
 template <typename A>
-bool Binder<A>::findExportedSymbolAddress(const char* name, pint_t* result, Binder<A>** foundIn, bool* isResolverSymbol, bool* isAbsolute)
+void Binder<A>::resolveReExportedSymbols()
 {
-    *foundIn = NULL;
-	// since re-export chains can be any length, re-exports cannot be resolved in setDependencies()
-	// instead we lazily, recursively update 
-	if ( !fReExportedSymbolsResolved ) {
+	if ( fReExportedSymbolsResolved ) 
+		return;
 		
-		// update fHashTable with any individual symbol re-exports
-		for (typename std::vector<SymbolReExport>::iterator it=fReExportedSymbols.begin(); it != fReExportedSymbols.end(); ++it) {
-			pint_t targetSymbolAddress;
-			bool isResolver;
-			bool isAb;
-
-			if ( it->dylibOrdinal <= 0 ) 
-				throw "bad mach-o binary, special library ordinal not allowed in re-exported symbols in dyld shared cache";
-			
-			Binder<A>* binder = fDependentDylibs[it->dylibOrdinal-1].binder;
-			
-			if ( ! binder->findExportedSymbolAddress(it->importName, &targetSymbolAddress, foundIn, &isResolver, &isAb) ) 
-				throwf("could not bind symbol %s in %s expected in %s", it->importName, this->getDylibID(), binder->getDylibID());
+	// update fHashTable with any individual symbol re-exports
+	for (typename std::vector<SymbolReExport>::iterator it=fReExportedSymbols.begin(); it != fReExportedSymbols.end(); ++it) {
+		pint_t targetSymbolAddress;
+		Binder<A>* foundIn;
+		bool isResolver;
+		bool isAb;
 
-			if ( isResolver )
-				fSymbolResolvers.insert(name);
+		if ( it->dylibOrdinal <= 0 ) 
+			throw "bad mach-o binary, special library ordinal not allowed in re-exported symbols in dyld shared cache";
+		
+		Binder<A>* binder = fDependentDylibs[it->dylibOrdinal-1].binder;
+		
+		if ( ! binder->findExportedSymbolAddress(it->importName, &targetSymbolAddress, &foundIn, &isResolver, &isAb) ) 
+			throwf("could not bind symbol %s in %s expected in %s", it->importName, this->getDylibID(), binder->getDylibID());
 
-			fHashTable[it->exportName] = targetSymbolAddress;
-		}
-		// mark as done
-		fReExportedSymbolsResolved = true;
+		if ( isResolver )
+			fSymbolResolvers.insert(it->exportName);
+
+		fHashTable[it->exportName] = targetSymbolAddress;
 	}
+	// mark as done
+	fReExportedSymbolsResolved = true;
+}
+
+template <typename A>
+bool Binder<A>::findExportedSymbolAddress(const char* name, pint_t* result, Binder<A>** foundIn, bool* isResolverSymbol, bool* isAbsolute)
+{
+    *foundIn = NULL;
+	this->resolveReExportedSymbols();
 
 	*isResolverSymbol = false;
 	if ( !fSymbolResolvers.empty() && fSymbolResolvers.count(name) ) {
@@ -111,13 +111,17 @@ private:
 	bool										fSplittingSegments;
 	bool										fHasSplitSegInfoV2;
 	std::vector<uint64_t>						fSectionOffsetsInSegment;
+	uint32_t*									fLastMappedAddr32;			// movw/movt pairing state for adjustReference()
+	uint32_t									fLastKind;
+	uint32_t									fLastToNewAddress;
 };
 
 
 template <typename A>
 Rebaser<A>::Rebaser(const MachOLayoutAbstraction& layout)
  : 	fLayout(layout), fLinkEditBase(0), fSymbolTable(NULL), fDynamicSymbolTable(NULL), 
-    fDyldInfo(NULL), fSplitSegInfo(NULL), fSplittingSegments(false), fHasSplitSegInfoV2(false)
+    fDyldInfo(NULL), fSplitSegInfo(NULL), fSplittingSegments(false), fHasSplitSegInfoV2(false),
+	fLastMappedAddr32(NULL), fLastKind(0), fLastToNewAddress(0)
 {
 	fHeader = (const macho_header<P>*)fLayout.getSegments()[0].mappedAddress();
 	switch ( fHeader->filetype() ) {
@@ -928,9 +932,6 @@ void Rebaser<arm>::adjustReference(uint32_t kind, uint8_t* mappedAddr, uint64_t
 {
 	uint32_t value32;
 	uint32_t* mappedAddr32 = (uint32_t*)mappedAddr;
-	static uint32_t* lastMappedAddr32 = NULL;
-	static uint32_t lastKind = 0;
-	static uint32_t lastToNewAddress = 0;
 	switch ( kind ) {
 		case DYLD_CACHE_ADJ_V2_DELTA_32:
 			value32 = arm64::P::E::get32(*mappedAddr32);
@@ -950,9 +951,9 @@ void Rebaser<arm>::adjustReference(uint32_t kind, uint8_t* mappedAddr, uint64_t
 		case DYLD_CACHE_ADJ_V2_THUMB_MOVW_MOVT:
 			// to update a movw/movt pair we need to extract the 32-bit they will make,
 			// add the adjust and write back the new movw/movt pair.
-			if ( lastKind == kind ) {
-				if ( lastToNewAddress == toNewAddress ) {
-					uint32_t instruction1 = E::get32(*lastMappedAddr32);
+			if ( fLastKind == kind ) {
+				if ( fLastToNewAddress == toNewAddress ) {
+					uint32_t instruction1 = E::get32(*fLastMappedAddr32);
 					uint32_t instruction2 = E::get32(*mappedAddr32);
 					if ( isThumbMovw(instruction1) && isThumbMovt(instruction2) ) {
 						uint16_t high = getThumbWord(instruction2);
@@ -973,7 +974,7 @@ void Rebaser<arm>::adjustReference(uint32_t kind, uint8_t* mappedAddr, uint64_t
 					else {
 						throw "two DYLD_CACHE_ADJ_V2_THUMB_MOVW_MOVT in a row but not";
 					}
-					E::set32(*lastMappedAddr32, instruction1);
+					E::set32(*fLastMappedAddr32, instruction1);
 					E::set32(*mappedAddr32, instruction2);
 					kind = 0;
 				}
@@ -985,9 +986,9 @@ void Rebaser<arm>::adjustReference(uint32_t kind, uint8_t* mappedAddr, uint64_t
 		case DYLD_CACHE_ADJ_V2_ARM_MOVW_MOVT:
 			// to update a movw/movt pair we need to extract the 32-bit they will make,
 			// add the adjust and write back the new movw/movt pair.
-			if ( lastKind == kind ) {
-				if ( lastToNewAddress == toNewAddress ) {
-					uint32_t instruction1 = E::get32(*lastMappedAddr32);
+			if ( fLastKind == kind ) {
+				if ( fLastToNewAddress == toNewAddress ) {
+					uint32_t instruction1 = E::get32(*fLastMappedAddr32);
 					uint32_t instruction2 = E::get32(*mappedAddr32);
 					if ( isArmMovw(instruction1) && isArmMovt(instruction2) ) {
 						uint16_t high = getArmWord(instruction2);
@@ -1008,7 +1009,7 @@ void Rebaser<arm>::adjustReference(uint32_t kind, uint8_t* mappedAddr, uint64_t
 					else {
 						throw "two DYLD_CACHE_ADJ_V2_ARM_MOVW_MOVT in a row but not";
 					}
-					E::set32(*lastMappedAddr32, instruction1);
+					E::set32(*fLastMappedAddr32, instruction1);
 					E::set32(*mappedAddr32, instruction2);
 					kind = 0;
 				}
@@ -1024,9 +1025,9 @@ void Rebaser<arm>::adjustReference(uint32_t kind, uint8_t* mappedAddr, uint64_t
 		default:
 			throwf("v2 split seg info kind (%d) not supported yet", kind);
 	}
-	lastKind = kind;
-	lastToNewAddress = toNewAddress;
-	lastMappedAddr32 = mappedAddr32;
+	fLastKind = kind;
+	fLastToNewAddress = toNewAddress;
+	fLastMappedAddr32 = mappedAddr32;
 }
 
 
@@ -45,6 +45,8 @@ struct dyld_cache_header
 	uint64_t	localSymbolsSize;		// size of local symbols information
 	uint8_t		uuid[16];				// unique value for each shared cache file
 	uint64_t	cacheType;				// 1 for development, 0 for optimized
+	uint64_t	pathHashOffset;			// file offset of dyld_cache_path_hash_info (zero means none)
+	uint64_t	pathHashSize;			// size of path hash table
 };
 
 struct dyld_cache_mapping_info {
@@ -95,6 +97,33 @@ struct dyld_cache_local_symbols_entry
 };
 
 
+// open addressed table (linear probing) of image paths, for O(1) lookup of images in cache
+struct dyld_cache_path_hash_info
+{
+	uint32_t	version;		// currently 1
+	uint32_t	bucketCount;	// always a power of two
+	// dyld_cache_path_hash_bucket buckets[bucketCount];
+};
+
+struct dyld_cache_path_hash_bucket
+{
+	uint32_t	hash;			// dyld_cache_path_hash() of image path
+	uint32_t	imageIndex;		// index into dyld_cache_image_info array, or DYLD_CACHE_PATH_HASH_EMPTY
+};
+
+#define DYLD_CACHE_PATH_HASH_EMPTY		0xFFFFFFFF
+
+// FNV-1a, must be the same in update_dyld_shared_cache and dyld
+static inline uint32_t dyld_cache_path_hash(const char* path)
+{
+	uint32_t hash = 2166136261U;
+	for (const char* s=path; *s != '\0'; ++s) {
+		hash ^= (uint8_t)*s;
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
 
 #define MACOSX_DYLD_SHARED_CACHE_DIR	"/var/db/dyld/"
 #define IPHONE_DYLD_SHARED_CACHE_DIR	"/System/Library/Caches/com.apple.dyld/"
@@ -34,15 +34,19 @@
 #include <mach-o/arch.h>
 #include <mach-o/loader.h>
 #include <mach/mach.h>
+#include <mach/mach_time.h>
 
 #include <map>
 #include <vector>
+#include <string>
 
 #include "dsc_iterator.h"
 #include "dyld_cache_format.h"
 #include "Architectures.hpp"
 #include "MachOFileAbstraction.hpp"
 #include "CacheFileAbstraction.hpp"
+#include "MachOTrie.hpp"
+#include "dyld_trie_walk.h"
 
 enum Mode {
 	modeNone,
@@ -52,7 +56,8 @@ enum Mode {
 	modeSlideInfo,
 	modeLinkEdit,
 	modeInfo,
-	modeSize
+	modeSize,
+	modeTrieWalk
 };
 
 struct Options {
@@ -76,17 +81,24 @@ struct TextInfoSorter {
 	}
 };
 
+struct TrieInfo {
+	const uint8_t*	start;
+	const uint8_t*	end;
+	const char*		path;
+};
+
 struct Results {
 	std::map<uint32_t, const char*>	pageToContent;
 	uint64_t						linkeditBase;
 	bool							dependentTargetFound;
 	std::vector<TextInfo>			textSegments;
+	std::vector<TrieInfo>			exportTries;
 };
 
 
 
 void usage() {
-	fprintf(stderr, "Usage: dyld_shared_cache_util -list [ -uuid ] [-vmaddr] | -dependents <dylib-path> [ -versions ] | -linkedit | -map [ shared-cache-file ] | -slide_info | -info\n");
+	fprintf(stderr, "Usage: dyld_shared_cache_util -list [ -uuid ] [-vmaddr] | -dependents <dylib-path> [ -versions ] | -linkedit | -map [ shared-cache-file ] | -slide_info | -info | -trie_walk\n");
 }
 
 #if __x86_64__
@@ -245,6 +257,102 @@ void collect_size(const dyld_shared_cache_dylib_info* dylibInfo, const dyld_shar
 
 
 
+/*
+ * collect export trie of each dylib, for -trie_walk
+ */
+template <typename A>
+void collect_export_trie(const dyld_shared_cache_dylib_info* dylibInfo, const dyld_shared_cache_segment_info* segInfo, 
+																		const Options& options, Results& results) 
+{
+	typedef typename A::P		P;
+	if ( strcmp(segInfo->name, "__TEXT") != 0 )
+		return;
+	if ( dylibInfo->isAlias )
+		return;
+	const macho_header<P>* mh = (const macho_header<P>*)dylibInfo->machHeader;
+	const macho_load_command<P>* const cmds = (macho_load_command<P>*)((long)mh + sizeof(macho_header<P>));
+	const macho_load_command<P>* cmd = cmds;
+	for (uint32_t i = 0; i < mh->ncmds(); i++) {
+		if ( cmd->cmd() == LC_DYLD_INFO_ONLY ) {
+			const macho_dyld_info_command<P>* dyldInfo = (macho_dyld_info_command<P>*)cmd;
+			if ( dyldInfo->export_size() != 0 ) {
+				TrieInfo info;
+				info.start = (uint8_t*)options.mappedCache + dyldInfo->export_off();
+				info.end = info.start + dyldInfo->export_size();
+				info.path = dylibInfo->path;
+				results.exportTries.push_back(info);
+			}
+		}
+		cmd = (const macho_load_command<P>*)(((uint8_t*)cmd)+cmd->cmdsize());
+	}
+}
+
+
+/*
+ * Replay every export trie in the cache through dyld's vector and scalar trie walkers.
+ * Looks up each exported name, plus a longer and a shorter variant of it which
+ * usually miss, and checks that both walkers give the same answer.
+ */
+static bool replay_export_tries(const Results& results)
+{
+	const int rounds = 5;
+	uint64_t scalarTime = 0;
+	uint64_t vectorTime = 0;
+	uint64_t lookups = 0;
+	uint64_t mismatches = 0;
+	for (std::vector<TrieInfo>::const_iterator it = results.exportTries.begin(); it != results.exportTries.end(); ++it) {
+		std::vector<mach_o::trie::Entry> exports;
+		mach_o::trie::parseTrie(it->start, it->end, exports);
+		std::vector<std::string> names;
+		names.reserve(exports.size()*3);
+		for (std::vector<mach_o::trie::Entry>::iterator eit = exports.begin(); eit != exports.end(); ++eit) {
+			std::string name = eit->name;
+			names.push_back(name);
+			names.push_back(name + "$miss");
+			if ( name.size() > 1 )
+				names.push_back(name.substr(0, name.size()-1));
+		}
+		std::vector<const uint8_t*> scalarResults(names.size());
+		std::vector<const uint8_t*> vectorResults(names.size());
+		for (int round=0; round < rounds; ++round) {
+			bool malformed = false;
+			uint64_t t0 = mach_absolute_time();
+			for (size_t i=0; i < names.size(); ++i)
+				scalarResults[i] = dyld_trie_walk_scalar(it->start, it->end, names[i].c_str(), &malformed);
+			uint64_t t1 = mach_absolute_time();
+			for (size_t i=0; i < names.size(); ++i)
+				vectorResults[i] = dyld_trie_walk(it->start, it->end, names[i].c_str(), &malformed);
+			uint64_t t2 = mach_absolute_time();
+			scalarTime += (t1 - t0);
+			vectorTime += (t2 - t1);
+			if ( malformed ) {
+				fprintf(stderr, "Error: malformed export trie in %s\n", it->path);
+				return false;
+			}
+		}
+		for (size_t i=0; i < names.size(); ++i) {
+			if ( scalarResults[i] != vectorResults[i] ) {
+				fprintf(stderr, "Error: trie walkers disagree on %s in %s\n", names[i].c_str(), it->path);
+				++mismatches;
+			}
+		}
+		lookups += names.size();
+		for (std::vector<mach_o::trie::Entry>::iterator eit = exports.begin(); eit != exports.end(); ++eit)
+			::free((void*)eit->name);
+	}
+	
+	mach_timebase_info_data_t timebase;
+	mach_timebase_info(&timebase);
+	uint64_t scalarNanos = (scalarTime * timebase.numer) / timebase.denom;
+	uint64_t vectorNanos = (vectorTime * timebase.numer) / timebase.denom;
+	printf("export tries: %lu, lookups: %llu x %d rounds, mismatches: %llu\n", results.exportTries.size(), lookups, rounds, mismatches);
+	printf("scalar walker: %llu ms, %s walker: %llu ms", scalarNanos/1000000, (DYLD_TRIE_WALK_VECTOR ? "vector" : "scalar+uleb"), vectorNanos/1000000);
+	if ( vectorNanos != 0 )
+		printf(", speedup %.2fx", (double)scalarNanos/(double)vectorNanos);
+	printf("\n");
+	return (mismatches == 0);
+}
+
 
 static void add_linkedit(uint32_t pageStart, uint32_t pageEnd, const char* message, Results& results) 
 {	
@@ -331,7 +439,7 @@ void print_map(const dyld_shared_cache_dylib_info* dylibInfo, const dyld_shared_
 
 static void checkMode(Mode mode) {
 	if ( mode != modeNone ) {
-		fprintf(stderr, "Error: select one of: -list, -dependents, -info, -slide_info, -linkedit, -map, or -size\n");
+		fprintf(stderr, "Error: select one of: -list, -dependents, -info, -slide_info, -linkedit, -map, -size, or -trie_walk\n");
 		usage();
 		exit(1);
 	}
@@ -385,6 +493,10 @@ int main (int argc, const char* argv[]) {
 			else if (strcmp(opt, "-size") == 0) {
 				checkMode(options.mode);
 				options.mode = modeSize;
+            } 
+			else if (strcmp(opt, "-trie_walk") == 0) {
+				checkMode(options.mode);
+				options.mode = modeTrieWalk;
             } 
 			else if (strcmp(opt, "-uuid") == 0) {
                 options.printUUIDs = true;
@@ -410,7 +522,7 @@ int main (int argc, const char* argv[]) {
     }
     
 	if ( options.mode == modeNone ) {
-		fprintf(stderr, "Error: select one of -list, -dependents, -info, -linkedit, or -map\n");
+		fprintf(stderr, "Error: select one of -list, -dependents, -info, -linkedit, -map, or -trie_walk\n");
 		usage();
 		exit(1);
 	}
@@ -521,6 +633,9 @@ int main (int argc, const char* argv[]) {
 				case modeSize:
 					callback = collect_size<x86>;
 					break;
+				case modeTrieWalk:
+					callback = collect_export_trie<x86>;
+					break;
 				case modeNone:
 				case modeInfo:
 				case modeSlideInfo:
@@ -545,6 +660,9 @@ int main (int argc, const char* argv[]) {
 				case modeSize:
 					callback = collect_size<x86_64>;
 					break;
+				case modeTrieWalk:
+					callback = collect_export_trie<x86_64>;
+					break;
 				case modeNone:
 				case modeInfo:
 				case modeSlideInfo:
@@ -569,6 +687,9 @@ int main (int argc, const char* argv[]) {
 				case modeSize:
 					callback = collect_size<arm>;
 					break;
+				case modeTrieWalk:
+					callback = collect_export_trie<arm>;
+					break;
 				case modeNone:
 				case modeInfo:
 				case modeSlideInfo:
@@ -592,6 +713,9 @@ int main (int argc, const char* argv[]) {
 				case modeSize:
 					callback = collect_size<arm64>;
 					break;
+				case modeTrieWalk:
+					callback = collect_export_trie<arm64>;
+					break;
 				case modeNone:
 				case modeInfo:
 				case modeSlideInfo:
@@ -626,6 +750,10 @@ int main (int argc, const char* argv[]) {
 				printf(" 0x%08llX  %s\n", it->textSize, it->path);
 			}
 		}
+		else if ( options.mode == modeTrieWalk ) {
+			if ( !replay_export_tries(results) )
+				exit(1);
+		}
 		
 		if ( (options.mode == modeDependencies) && options.dependentsOfPath && !results.dependentTargetFound) {
 			fprintf(stderr, "Error: could not find '%s' in the shared cache at\n  %s\n", options.dependentsOfPath, sharedCachePath);
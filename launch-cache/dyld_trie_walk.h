@@ -0,0 +1,243 @@
+/* -*- mode: C++; c-basic-offset: 4; tab-width: 4 -*-
+ *
+ * Copyright (c) 2015 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+#ifndef __DYLD_TRIE_WALK__
+#define __DYLD_TRIE_WALK__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+//
+// Export trie walkers shared by dyld and the shared cache tools.
+//
+// dyld_trie_walk() returns a pointer to the terminal info of the node for symbol s,
+// or NULL if s is not in the trie.  It is the hotspot of symbol lookup, so it compares
+// edges 16 bytes at a time where SSE2 or NEON is available and decodes single byte
+// child offsets inline.  dyld_trie_walk_scalar() is the original byte at a time walker,
+// kept as the reference the vector walker is checked against.
+//
+// Neither walker throws, *malformed is set if a uleb128 runs off the end of the trie.
+//
+
+#if __SSE2__
+	#include <emmintrin.h>
+	#define DYLD_TRIE_WALK_VECTOR 1
+#elif __ARM_NEON__ || __ARM_NEON
+	#include <arm_neon.h>
+	#define DYLD_TRIE_WALK_VECTOR 1
+#else
+	#define DYLD_TRIE_WALK_VECTOR 0
+#endif
+
+
+static inline uint64_t dyld_trie_read_uleb128(const uint8_t** p, const uint8_t* end, bool* malformed)
+{
+	uint64_t result = 0;
+	int		 bit = 0;
+	do {
+		if ( (*p == end) || (bit > 63) ) {
+			*malformed = true;
+			return 0;
+		}
+		result |= ((uint64_t)(**p & 0x7f)) << bit;
+		bit += 7;
+	} while ( *(*p)++ & 0x80 );
+	return result;
+}
+
+
+#if DYLD_TRIE_WALK_VECTOR
+// a 16 byte load at p must not cross into the next (possibly unmapped) page
+static inline bool dyld_trie_can_load16(const void* p)
+{
+	return ( ((uintptr_t)p & 4095) <= (4096-16) );
+}
+
+// number of leading bytes (0 to 16) of edge that are non-zero and equal to sym
+static inline unsigned int dyld_trie_edge_prefix16(const uint8_t* edge, const char* sym)
+{
+#if __SSE2__
+	__m128i e = _mm_loadu_si128((const __m128i*)edge);
+	__m128i s = _mm_loadu_si128((const __m128i*)sym);
+	unsigned int same = _mm_movemask_epi8(_mm_cmpeq_epi8(e, s));
+	unsigned int zero = _mm_movemask_epi8(_mm_cmpeq_epi8(e, _mm_setzero_si128()));
+	unsigned int stop = (~same | zero) & 0xFFFF;
+	return ( stop != 0 ) ? __builtin_ctz(stop) : 16;
+#else
+	uint8x16_t e = vld1q_u8(edge);
+	uint8x16_t s = vld1q_u8((const uint8_t*)sym);
+	uint8x16_t good = vandq_u8(vceqq_u8(e, s), vtstq_u8(e, e));
+	// narrow each byte of the compare result to 4 bits of a 64-bit mask
+	uint64_t bits = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(good), 4)), 0);
+	uint64_t stop = ~bits;
+	return ( stop != 0 ) ? (unsigned int)(__builtin_ctzll(stop) >> 2) : 16;
+#endif
+}
+#endif // DYLD_TRIE_WALK_VECTOR
+
+
+// Compares the edge string at *edge to the symbol suffix at *sym.  On a match, advances *sym
+// past the edge.  Either way *edge is left pointing at the edge's zero terminator.
+static inline bool dyld_trie_match_edge(const uint8_t** edge, const char** sym, const uint8_t* end)
+{
+	const uint8_t* e = *edge;
+	const char* s = *sym;
+#if DYLD_TRIE_WALK_VECTOR
+	while ( (e + 16 <= end) && dyld_trie_can_load16(e) && dyld_trie_can_load16(s) ) {
+		unsigned int n = dyld_trie_edge_prefix16(e, s);
+		e += n;
+		s += n;
+		if ( n != 16 )
+			break;
+	}
+#endif
+	// scalar compare of the rest, a symbol shorter than the edge stops at its terminator
+	while ( (*e != '\0') && (*e == (uint8_t)*s) ) {
+		++e;
+		++s;
+	}
+	if ( *e == '\0' ) {
+		*edge = e;
+		*sym = s;
+		return true;
+	}
+	// wrong edge, skip the rest of it
+	while ( *e != '\0' )
+		++e;
+	*edge = e;
+	return false;
+}
+
+
+static inline const uint8_t* dyld_trie_walk(const uint8_t* start, const uint8_t* end, const char* s, bool* malformed)
+{
+	const uint8_t* p = start;
+	while ( p != NULL ) {
+		uint64_t terminalSize = *p++;
+		if ( terminalSize > 127 ) {
+			// except for re-export-with-rename, all terminal sizes fit in one byte
+			--p;
+			terminalSize = dyld_trie_read_uleb128(&p, end, malformed);
+			if ( *malformed )
+				return NULL;
+		}
+		if ( (*s == '\0') && (terminalSize != 0) )
+			return p;
+		const uint8_t* children = p + terminalSize;
+		uint8_t childrenRemaining = *children++;
+		p = children;
+		uint64_t nodeOffset = 0;
+		for (; childrenRemaining > 0; --childrenRemaining) {
+			if ( dyld_trie_match_edge(&p, &s, end) ) {
+				// the symbol so far matches this edge (child), so advance to the child's node
+				++p; // skip over zero terminator
+				if ( (*p & 0x80) == 0 ) {
+					// small tries and the first level of most tries use single byte offsets
+					nodeOffset = *p;
+				}
+				else {
+					nodeOffset = dyld_trie_read_uleb128(&p, end, malformed);
+					if ( *malformed )
+						return NULL;
+				}
+				break;
+			}
+			// advance to next child
+			++p; // skip over zero terminator
+			// skip over uleb128 until last byte is found
+			while ( (*p & 0x80) != 0 )
+				++p;
+			++p; // skip over last byte of uleb128
+		}
+		if ( nodeOffset != 0 )
+			p = &start[nodeOffset];
+		else
+			p = NULL;
+	}
+	return NULL;
+}
+
+
+static inline const uint8_t* dyld_trie_walk_scalar(const uint8_t* start, const uint8_t* end, const char* s, bool* malformed)
+{
+	const uint8_t* p = start;
+	while ( p != NULL ) {
+		uint64_t terminalSize = *p++;
+		if ( terminalSize > 127 ) {
+			// except for re-export-with-rename, all terminal sizes fit in one byte
+			--p;
+			terminalSize = dyld_trie_read_uleb128(&p, end, malformed);
+			if ( *malformed )
+				return NULL;
+		}
+		if ( (*s == '\0') && (terminalSize != 0) )
+			return p;
+		const uint8_t* children = p + terminalSize;
+		uint8_t childrenRemaining = *children++;
+		p = children;
+		uint64_t nodeOffset = 0;
+		for (; childrenRemaining > 0; --childrenRemaining) {
+			const char* ss = s;
+			bool wrongEdge = false;
+			// scan whole edge to get to next edge
+			// if edge is longer than target symbol name, don't read past end of symbol name
+			char c = *p;
+			while ( c != '\0' ) {
+				if ( !wrongEdge ) {
+					if ( c != *ss )
+						wrongEdge = true;
+					++ss;
+				}
+				++p;
+				c = *p;
+			}
+			if ( wrongEdge ) {
+				// advance to next child
+				++p; // skip over zero terminator
+				// skip over uleb128 until last byte is found
+				while ( (*p & 0x80) != 0 )
+					++p;
+				++p; // skip over last byte of uleb128
+			}
+			else {
+ 				// the symbol so far matches this edge (child)
+				// so advance to the child's node
+				++p;
+				nodeOffset = dyld_trie_read_uleb128(&p, end, malformed);
+				if ( *malformed )
+					return NULL;
+				s = ss;
+				break;
+			}
+		}
+		if ( nodeOffset != 0 )
+			p = &start[nodeOffset];
+		else
+			p = NULL;
+	}
+	return NULL;
+}
+
+
+#endif // __DYLD_TRIE_WALK__
@@ -43,6 +43,8 @@
 #include <sys/sysctl.h>
 #include <sys/resource.h>
 #include <dirent.h>
+#include <pthread.h>
+#include <libkern/OSAtomic.h>
 #include <servers/bootstrap.h>
 #include <mach-o/loader.h>
 #include <mach-o/fat.h>
@@ -78,8 +80,18 @@ static bool							verbose = false;
 static bool							progress = false;
 static bool							iPhoneOS = false;
 static bool							rootless = true;
+static bool							verifyDeterministic = false;
+static bool							incremental = false;
 static std::vector<const char*>		warnings;
 
+struct LaunchProfileTouch
+{
+	const char*	installName;
+	const char*	segmentName;
+	uint64_t	offset;
+};
+static std::vector<LaunchProfileTouch>	launchProfile;
+
 
 static void warn(const char *arch, const char *format, ...)
 {
@@ -102,6 +114,60 @@ static void warn(const char *arch, const char *format, ...)
 }
 
 
+//
+// Calls work(context, index) for every index in [0, count) on up to threadCount threads
+// (the calling thread is one of them).  Rather than handing each thread a fixed slice,
+// idle threads take the next index from a shared counter, so one big dylib does not
+// leave the other cores waiting.  work() must not throw and must only write state owned
+// by its index.
+//
+struct ParallelWork {
+	void				(*work)(void* context, uint32_t index);
+	void*				context;
+	uint32_t			count;
+	volatile int32_t	next;
+};
+
+static void* parallelWorker(void* arg)
+{
+	ParallelWork* pw = (ParallelWork*)arg;
+	for (int32_t index = OSAtomicIncrement32Barrier(&pw->next)-1; index < (int32_t)pw->count; index = OSAtomicIncrement32Barrier(&pw->next)-1)
+		pw->work(pw->context, index);
+	return NULL;
+}
+
+static void parallelForEach(uint32_t count, unsigned int threadCount, void (*work)(void* context, uint32_t index), void* context)
+{
+	ParallelWork pw = { work, context, count, 0 };
+	std::vector<pthread_t> threads;
+	for (unsigned int i=1; (i < threadCount) && (i < count); ++i) {
+		pthread_t thread;
+		if ( pthread_create(&thread, NULL, &parallelWorker, &pw) == 0 )
+			threads.push_back(thread);
+	}
+	parallelWorker(&pw);
+	for (pthread_t thread : threads)
+		pthread_join(thread, NULL);
+}
+
+static double absoluteTimeToMilliseconds(uint64_t machTime)
+{
+	static mach_timebase_info_data_t timebase;
+	if ( timebase.denom == 0 )
+		mach_timebase_info(&timebase);
+	return ((double)machTime * timebase.numer / timebase.denom) / 1000000.0;
+}
+
+static unsigned int workerThreadCount()
+{
+	int cpuCount = 1;
+	size_t len = sizeof(cpuCount);
+	if ( (sysctlbyname("hw.activecpu", &cpuCount, &len, NULL, 0) != 0) || (cpuCount < 1) )
+		cpuCount = 1;
+	return cpuCount;
+}
+
+
 class CStringHash {
 public:
 	size_t operator()(const char* __s) const {
@@ -717,14 +783,19 @@ public:
 	uint32_t	add(const char* str);
 	uint32_t	addUnique(const char* str);
 	const char* stringAtIndex(uint32_t) const;
+	uint32_t	shareSuffixes();
+	uint32_t	sharedOffset(uint32_t offset) const;
 	
 private:
 	typedef std::unordered_map<const char*, uint32_t, CStringHash, CStringEquals> StringToOffset;
+	struct StringInfo { uint32_t offset; uint32_t length; };
+	class SuffixSorter;
 
 	char*			fBuffer;
 	uint32_t		fBufferAllocated;
 	uint32_t		fBufferUsed;
 	StringToOffset	fUniqueStrings;
+	std::vector<std::pair<uint32_t, uint32_t> >	fOldToNewOffsets;
 };
 
 
@@ -774,6 +845,108 @@ const char* StringPool::stringAtIndex(uint32_t index) const
 	return &fBuffer[index];
 }
 
+// orders strings by their reversed text, largest first, and puts a string after every
+// string that ends with it
+class StringPool::SuffixSorter
+{
+public:
+	SuffixSorter(const char* buffer, const std::vector<StringInfo>& strings) : fBuffer(buffer), fStrings(strings) {}
+	bool operator()(uint32_t left, uint32_t right) const {
+		const char* leftStart = &fBuffer[fStrings[left].offset];
+		const char* rightStart = &fBuffer[fStrings[right].offset];
+		const char* l = leftStart + fStrings[left].length;
+		const char* r = rightStart + fStrings[right].length;
+		while ( (l > leftStart) && (r > rightStart) ) {
+			--l;
+			--r;
+			if ( *l != *r )
+				return ((uint8_t)*l > (uint8_t)*r);
+		}
+		if ( fStrings[left].length != fStrings[right].length )
+			return (fStrings[left].length > fStrings[right].length);
+		return (left < right);
+	}
+private:
+	const char*						fBuffer;
+	const std::vector<StringInfo>&	fStrings;
+};
+
+//
+// Rebuilds the pool so that a string which is the tail of another string (e.g. "_foo" and
+// "__Z3_foo") is not stored twice, but points into the longer one.  Strings that are not
+// a tail of another keep their relative order.  Offsets returned by add() before this call
+// must be translated with sharedOffset().  Returns the number of bytes saved.
+//
+uint32_t StringPool::shareSuffixes()
+{
+	std::vector<StringInfo> strings;
+	for (uint32_t offset=0; offset < fBufferUsed; ) {
+		StringInfo info;
+		info.offset = offset;
+		info.length = strlen(&fBuffer[offset]);
+		strings.push_back(info);
+		offset += info.length + 1;
+	}
+	const uint32_t count = strings.size();
+	std::vector<uint32_t> order(count);
+	for (uint32_t i=0; i < count; ++i)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), SuffixSorter(fBuffer, strings));
+	
+	// after sorting, any string that can share storage is a tail of the string just before it
+	std::vector<uint32_t> host(count);
+	std::vector<uint32_t> hostDelta(count);
+	for (uint32_t k=0; k < count; ++k) {
+		const uint32_t i = order[k];
+		host[i] = i;
+		hostDelta[i] = 0;
+		if ( k != 0 ) {
+			const uint32_t prev = order[k-1];
+			const uint32_t len = strings[i].length;
+			if ( (strings[prev].length >= len) 
+				&& (memcmp(&fBuffer[strings[prev].offset + strings[prev].length - len], &fBuffer[strings[i].offset], len) == 0) ) {
+				host[i] = host[prev];
+				hostDelta[i] = hostDelta[prev] + strings[prev].length - len;
+			}
+		}
+	}
+	
+	// copy strings that are not tails of another into a new buffer
+	char* newBuffer = (char*)malloc(fBufferAllocated);
+	uint32_t newBufferUsed = 0;
+	std::vector<uint32_t> newOffsets(count);
+	for (uint32_t i=0; i < count; ++i) {
+		if ( host[i] == i ) {
+			newOffsets[i] = newBufferUsed;
+			memcpy(&newBuffer[newBufferUsed], &fBuffer[strings[i].offset], strings[i].length+1);
+			newBufferUsed += strings[i].length+1;
+		}
+	}
+	fUniqueStrings.clear();
+	fOldToNewOffsets.clear();
+	fOldToNewOffsets.reserve(count);
+	for (uint32_t i=0; i < count; ++i) {
+		uint32_t newOffset = newOffsets[host[i]] + hostDelta[i];
+		fOldToNewOffsets.push_back(std::make_pair(strings[i].offset, newOffset));
+		fUniqueStrings[&newBuffer[newOffset]] = newOffset;
+	}
+	free(fBuffer);
+	fBuffer = newBuffer;
+	uint32_t saved = fBufferUsed - newBufferUsed;
+	fBufferUsed = newBufferUsed;
+	return saved;
+}
+
+uint32_t StringPool::sharedOffset(uint32_t offset) const
+{
+	if ( fOldToNewOffsets.empty() )
+		return offset;
+	std::vector<std::pair<uint32_t, uint32_t> >::const_iterator pos = std::lower_bound(fOldToNewOffsets.begin(), fOldToNewOffsets.end(), std::make_pair(offset, (uint32_t)0));
+	if ( (pos == fOldToNewOffsets.end()) || (pos->first != offset) )
+		throwf("string pool offset 0x%08X is not the start of a string", offset);
+	return pos->second;
+}
+
 
 
 struct LocalSymbolInfo
@@ -824,11 +997,71 @@ private:
 	static uint64_t			getWritableSegmentNewAddress(uint64_t proposedNewAddress, uint64_t originalAddress, uint64_t executableSlide);
 	static bool				addCacheSlideInfo();
 	static uint64_t			pathHash(const char*);
+	static void				addToPathHashTable(dyldCachePathHashBucket<E>* buckets, uint32_t bucketCount, const char* path, uint32_t imageIndex);
 	
 	static uint64_t			pageAlign(uint64_t addr);
 	static uint64_t			regionAlign(uint64_t addr);
 	static uint64_t			pageAlign4KB(uint64_t addr);
+	typedef std::pair<const MachOLayoutAbstraction::Segment*, uint64_t>		LaunchTouch;
+	typedef std::map<const MachOLayoutAbstraction::Segment*, uint32_t>		SegmentRanks;
 	void					assignNewBaseAddresses(bool verify);
+	void					assignNewBaseAddressesInOrder(const SegmentRanks* launchRanks);
+	void					resolveLaunchProfile(std::vector<LaunchTouch>& touches);
+	void					countLaunchProfilePages(const std::vector<LaunchTouch>& touches, uint32_t& pages, uint32_t& writablePages);
+	void					setSegmentMappedAddresses(uint8_t* cache);
+	void					rebaseAndBind(uint8_t* cache, unsigned int threadCount, std::vector<Binder<A>*>& binders, std::vector<void*>& pointersInData, 
+											bool& canEmitDevelopmentCache);
+	bool					loadIncrementalState(const char* path);
+	void					assignPreviousBaseAddresses();
+	void					saveIncrementalState(const char* path, const uint8_t* cache, uint32_t cacheFileSize);
+	bool					reusedDylib(uint32_t index) const { return (index < fIncrementalDylibs.size()) && fIncrementalDylibs[index].reused; }
+
+	struct DylibFixups {
+		std::vector<void*>	rebasedPointers;
+		std::vector<void*>	boundPointers;
+		const char*			error;
+		bool				rebased;
+		bool				reused;
+	};
+	
+	// -incremental state of one dylib, as it was right after rebasing and binding
+	struct IncrementalSegment {
+		char				name[16];
+		uint64_t			address;
+		uint64_t			slotSize;		// distance to the next segment in the same mapping
+	};
+	struct IncrementalDependent {
+		uint32_t			index;
+		uint32_t			reExport;
+	};
+	struct IncrementalResolverClient {
+		uint32_t			resolverIndex;
+		const char*			symbolName;
+	};
+	struct IncrementalDylib {
+		const char*								installName;
+		uint64_t								inode;
+		uint64_t								modTime;
+		uint64_t								address;
+		bool									rebased;
+		bool									reused;
+		std::vector<IncrementalSegment>			segments;
+		std::vector<uint32_t>					rebasedPointers;	// cache file offsets
+		std::vector<uint32_t>					boundPointers;		// cache file offsets
+		uint32_t								exportsOffset;		// cache file offset of trie, or zero if in sideExportTrie
+		std::vector<uint8_t>					sideExportTrie;
+		std::vector<IncrementalDependent>		dependents;
+		std::vector<IncrementalResolverClient>	resolverClients;
+	};
+	
+	struct FixupsWork {
+		SharedCache<A>*				cache;
+		std::vector<Binder<A>*>*	binders;
+		std::vector<DylibFixups>*	fixups;
+	};
+	
+	static void				rebaseDylib(void* context, uint32_t index);
+	static void				bindDylib(void* context, uint32_t index);
 
 	struct LayoutInfo {
 		const MachOLayoutAbstraction*		layout;
@@ -836,6 +1069,8 @@ private:
 		dyld_cache_image_info				info;
 	};
 	
+	static bool				previousBaseAddressesFit(const std::vector<LayoutInfo>& dylibs, const std::vector<IncrementalDylib>& previous);
+
 	struct ByNameSorter {
 		bool operator()(const LayoutInfo& left, const LayoutInfo& right) 
 				{ return (strcmp(left.layout->getID().name, right.layout->getID().name) < 0); }
@@ -893,6 +1128,8 @@ private:
 	StringPool							fUnmappedLocalsStringPool;
 	std::vector<LocalSymbolInfo>		fLocalSymbolInfos;
 	uint32_t							fHeaderSize;
+	uint32_t							fPathHashOffset;
+	uint32_t							fPathHashBucketCount;
     uint8_t*							fInMemoryCache;
 	uint64_t							fDyldBaseAddress;
 	uint64_t							fLinkEditsTotalUnoptimizedSize;
@@ -910,12 +1147,23 @@ private:
 	uint32_t							fSizeOfOldIndirectSymbolsInCombinedLinkedit;
 	uint32_t							fOffsetOfOldStringPoolInCombinedLinkedit;
 	uint32_t							fSizeOfOldStringPoolInCombinedLinkedit;
+	uint32_t							fStringPoolSuffixBytesSaved;
 	uint32_t							fOffsetOfFunctionStartsInCombinedLinkedit;
 	uint32_t							fSizeOfFunctionStartsInCombinedLinkedit;
 	uint32_t							fOffsetOfDataInCodeInCombinedLinkedit;
 	uint32_t							fSizeOfDataInCodeInCombinedLinkedit;
 	uint32_t							fLinkEditsTotalOptimizedSize;
 	uint32_t							fUnmappedLocalSymbolsSize;
+	std::vector<IncrementalDylib>		fIncrementalDylibs;
+	std::vector<shared_file_mapping_np>	fIncrementalMappings;
+	uint64_t							fIncrementalLinkEditsStartAddress;
+	uint64_t							fIncrementalLinkEditsTotalUnoptimizedSize;
+	uint64_t							fIncrementalImageOffset;
+	uint32_t							fIncrementalReusedCount;
+	uint32_t							fLaunchProfilePages;
+	uint32_t							fLaunchProfileWritablePages;
+	uint32_t							fLaunchProfileUnorderedPages;
+	uint32_t							fLaunchProfileUnorderedWritablePages;
 };
 
 
@@ -1061,16 +1309,18 @@ template <typename A>
 SharedCache<A>::SharedCache(ArchGraph* graph, const char* rootPath, const std::vector<const char*>& overlayPaths, const char* cacheDir, bool explicitCacheDir, bool alphaSort, bool verify, bool optimize, uint64_t dyldBaseAddress) 
   : fArchGraph(graph), fVerify(verify), fExistingIsNotUpToDate(true), 
 	fCacheFileInFinalLocation(rootPath[0] == '\0'), fCacheFilePath(NULL),
-	fExistingCacheForVerification(NULL), fDyldBaseAddress(dyldBaseAddress),
+	fExistingCacheForVerification(NULL), fPathHashOffset(0), fPathHashBucketCount(0), fDyldBaseAddress(dyldBaseAddress),
 	fOffsetOfBindInfoInCombinedLinkedit(0), fOffsetOfWeakBindInfoInCombinedLinkedit(0),
 	fOffsetOfLazyBindInfoInCombinedLinkedit(0), fOffsetOfExportInfoInCombinedLinkedit(0),
 	fOffsetOfOldSymbolTableInfoInCombinedLinkedit(0), fSizeOfOldSymbolTableInfoInCombinedLinkedit(0),
 	fOffsetOfOldExternalRelocationsInCombinedLinkedit(0), fSizeOfOldExternalRelocationsInCombinedLinkedit(0),
 	fOffsetOfOldIndirectSymbolsInCombinedLinkedit(0), fSizeOfOldIndirectSymbolsInCombinedLinkedit(0),
-	fOffsetOfOldStringPoolInCombinedLinkedit(0), fSizeOfOldStringPoolInCombinedLinkedit(0),
+	fOffsetOfOldStringPoolInCombinedLinkedit(0), fSizeOfOldStringPoolInCombinedLinkedit(0), fStringPoolSuffixBytesSaved(0),
 	fOffsetOfFunctionStartsInCombinedLinkedit(0), fSizeOfFunctionStartsInCombinedLinkedit(0),
 	fOffsetOfDataInCodeInCombinedLinkedit(0), fSizeOfDataInCodeInCombinedLinkedit(0),
-	fUnmappedLocalSymbolsSize(0)
+	fUnmappedLocalSymbolsSize(0), fIncrementalLinkEditsStartAddress(0), fIncrementalLinkEditsTotalUnoptimizedSize(0),
+	fIncrementalImageOffset(0), fIncrementalReusedCount(0), fLaunchProfilePages(0), fLaunchProfileWritablePages(0),
+	fLaunchProfileUnorderedPages(0), fLaunchProfileUnorderedWritablePages(0)
 {
 	if ( fArchGraph->getArchPair().arch != arch() )
 		throwf("SharedCache object is wrong architecture: 0x%08X vs 0x%08X", fArchGraph->getArchPair().arch, arch());
@@ -1157,9 +1407,16 @@ SharedCache<A>::SharedCache(ArchGraph* graph, const char* rootPath, const std::v
 	}
 	
 	// sort shared dylibs
+	char incrementalPath[strlen(fCacheFilePath)+strlen(".incremental")+1];
+	sprintf(incrementalPath, "%s.incremental", fCacheFilePath);
+	bool reusingLayout = false;
 	if ( verify ) {
 		// already sorted by notUpToDate()
 	}
+	else if ( incremental && this->loadIncrementalState(incrementalPath) ) {
+		// already sorted, and assigned addresses, to match previous build
+		reusingLayout = true;
+	}
 	else if ( alphaSort ) {
 		std::sort(fDylibs.begin(), fDylibs.end(), ByNameSorter());
 	}
@@ -1172,7 +1429,8 @@ SharedCache<A>::SharedCache(ArchGraph* graph, const char* rootPath, const std::v
 	}
 	
 	// assign segments in each dylib a new address
-	this->assignNewBaseAddresses(verify);
+	if ( !reusingLayout )
+		this->assignNewBaseAddresses(verify);
 	
 	// calculate where string pool offset will start
 	// calculate cache file header size
@@ -1200,6 +1458,20 @@ SharedCache<A>::SharedCache(ArchGraph* graph, const char* rootPath, const std::v
 	}
 	std::sort(fDylibAliases.begin(), fDylibAliases.end(), ByNameSorter());
 	//fprintf(stderr, "fHeaderSize=0x%08X, fDylibAliases.size()=%lu\n", fHeaderSize, fDylibAliases.size());
+	// path hash table goes after alias strings, but is optional so only add it if it fits
+	fPathHashBucketCount = 1;
+	while ( fPathHashBucketCount < 2*(fDylibs.size()+fDylibAliases.size()) )
+		fPathHashBucketCount *= 2;
+	const uint32_t pathHashOffset = (fHeaderSize + 7) & (-8);
+	const uint32_t pathHashEnd = pathHashOffset + sizeof(dyld_cache_path_hash_info) + fPathHashBucketCount*sizeof(dyld_cache_path_hash_bucket);
+	if ( pageAlign(pathHashEnd) <= FIRST_DYLIB_TEXT_OFFSET ) {
+		fPathHashOffset = pathHashOffset;
+		fHeaderSize = pathHashEnd;
+	}
+	else {
+		fPathHashOffset = 0;
+		fPathHashBucketCount = 0;
+	}
 	fHeaderSize = pageAlign(fHeaderSize);
 	
 	// check that cache we are about to create for verification purposes has same layout as existing cache
@@ -1239,16 +1511,139 @@ uint64_t SharedCache<A>::pathHash(const char* path)
 		sum += sum*4 + *s;
 	return sum;
 }
+
+template <typename A>
+void SharedCache<A>::addToPathHashTable(dyldCachePathHashBucket<E>* buckets, uint32_t bucketCount, const char* path, uint32_t imageIndex)
+{
+	const uint32_t hash = dyld_cache_path_hash(path);
+	const uint32_t mask = bucketCount - 1;
+	for (uint32_t i = hash & mask; ; i = (i+1) & mask) {
+		if ( buckets[i].imageIndex() == DYLD_CACHE_PATH_HASH_EMPTY ) {
+			buckets[i].set_hash(hash);
+			buckets[i].set_imageIndex(imageIndex);
+			return;
+		}
+	}
+}
 	
 
+//
+// With a -launch_profile, the __TEXT and __DATA* segments touched while launching are laid out
+// ahead of the rest, in the order they were first touched, so the launch-hot parts of all dylibs
+// share as few pages as possible.  A segment is never split, so the gain comes from packing
+// hot segments next to each other rather than next to cold ones.
+//
 template <typename A>
 void SharedCache<A>::assignNewBaseAddresses(bool verify)
 {
+	std::vector<LaunchTouch> touches;
+	if ( !verify )
+		this->resolveLaunchProfile(touches);
+	if ( touches.empty() ) {
+		this->assignNewBaseAddressesInOrder(NULL);
+		return;
+	}
+	
+	// lay out in the usual order first, just to report what the profile saves
+	this->assignNewBaseAddressesInOrder(NULL);
+	this->countLaunchProfilePages(touches, fLaunchProfileUnorderedPages, fLaunchProfileUnorderedWritablePages);
+	fMappings.clear();
+	for(typename std::vector<LayoutInfo>::iterator it = fDylibs.begin(); it != fDylibs.end(); ++it) 
+		it->info.address = 0;
+	
+	SegmentRanks ranks;
+	for (uint32_t i=0; i < touches.size(); ++i) 
+		ranks.insert(std::make_pair(touches[i].first, i));
+	this->assignNewBaseAddressesInOrder(&ranks);
+	this->countLaunchProfilePages(touches, fLaunchProfilePages, fLaunchProfileWritablePages);
+	if ( verbose )
+		fprintf(stderr, "update_dyld_shared_cache: for %s, launch profile touches %u pages (%u writable), %u pages (%u writable) without profile ordering\n", 
+						archName(), fLaunchProfilePages, fLaunchProfileWritablePages, fLaunchProfileUnorderedPages, fLaunchProfileUnorderedWritablePages);
+}
+
+
+//
+// Maps each -launch_profile entry to the segment it touches in this cache.  Entries for
+// dylibs not in this cache (e.g. other architectures) are ignored.
+//
+template <typename A>
+void SharedCache<A>::resolveLaunchProfile(std::vector<LaunchTouch>& touches)
+{
+	if ( launchProfile.empty() )
+		return;
+	typedef std::unordered_map<const char*, const MachOLayoutAbstraction*, typename Binder<A>::CStringHash, typename Binder<A>::CStringEquals> NameToLayout;
+	NameToLayout nameToLayout;
+	for(typename std::vector<LayoutInfo>::const_iterator it = fDylibs.begin(); it != fDylibs.end(); ++it) {
+		nameToLayout[it->layout->getID().name] = it->layout;
+		for(std::vector<const char*>::const_iterator ait = it->aliases.begin(); ait != it->aliases.end(); ++ait) 
+			nameToLayout[*ait] = it->layout;
+	}
+	uint32_t unmatched = 0;
+	for(std::vector<LaunchProfileTouch>::const_iterator it = launchProfile.begin(); it != launchProfile.end(); ++it) {
+		typename NameToLayout::const_iterator pos = nameToLayout.find(it->installName);
+		const MachOLayoutAbstraction::Segment* seg = (pos != nameToLayout.end()) ? pos->second->getSegment(it->segmentName) : NULL;
+		if ( (seg == NULL) || (it->offset >= seg->size()) ) {
+			++unmatched;
+			continue;
+		}
+		touches.push_back(std::make_pair(seg, it->offset));
+	}
+	if ( verbose && (unmatched != 0) )
+		fprintf(stderr, "update_dyld_shared_cache: for %s, %u of %lu launch profile entries are not in this cache\n", archName(), unmatched, launchProfile.size());
+}
+
+
+template <typename A>
+void SharedCache<A>::countLaunchProfilePages(const std::vector<LaunchTouch>& touches, uint32_t& pages, uint32_t& writablePages)
+{
+	// count in units of the VM page size the cache regions are aligned to
+	const uint64_t pageSize = regionAlign(1);
+	std::set<uint64_t> touchedPages;
+	std::set<uint64_t> touchedWritablePages;
+	for(typename std::vector<LaunchTouch>::const_iterator it = touches.begin(); it != touches.end(); ++it) {
+		const uint64_t page = (it->first->newAddress() + it->second) / pageSize;
+		touchedPages.insert(page);
+		if ( it->first->writable() )
+			touchedWritablePages.insert(page);
+	}
+	pages = touchedPages.size();
+	writablePages = touchedWritablePages.size();
+}
+
+
+template <typename A>
+void SharedCache<A>::assignNewBaseAddressesInOrder(const SegmentRanks* launchRanks)
+{
+	// segments touched at launch go first, in order of first touch, otherwise fDylibs order is kept
+	struct LaunchOrder {
+		const SegmentRanks* ranks;
+		uint32_t rank(const MachOLayoutAbstraction::Segment* seg) const {
+			typename SegmentRanks::const_iterator pos = ranks->find(seg);
+			return (pos != ranks->end()) ? pos->second : UINT32_MAX;
+		}
+		uint32_t textRank(const LayoutInfo* info) const {
+			uint32_t result = UINT32_MAX;
+			for (const MachOLayoutAbstraction::Segment& seg : info->layout->getSegments()) {
+				if ( seg.executable() && !seg.writable() )
+					result = std::min(result, rank(&seg));
+			}
+			return result;
+		}
+		bool operator()(const LayoutInfo* left, const LayoutInfo* right) const { return textRank(left) < textRank(right); }
+		bool operator()(const MachOLayoutAbstraction::Segment* left, const MachOLayoutAbstraction::Segment* right) const { return rank(left) < rank(right); }
+	};
+	LaunchOrder launchOrder = { launchRanks };
+	std::vector<LayoutInfo*> textOrder;
+	for(typename std::vector<LayoutInfo>::iterator it = fDylibs.begin(); it != fDylibs.end(); ++it) 
+		textOrder.push_back(&*it);
+	if ( launchRanks != NULL )
+		std::stable_sort(textOrder.begin(), textOrder.end(), launchOrder);
+
 	// first layout TEXT for dylibs
 	const uint64_t startExecuteAddress = sharedRegionStartAddress();
 	uint64_t currentExecuteAddress = startExecuteAddress + FIRST_DYLIB_TEXT_OFFSET;	
-	for(typename std::vector<LayoutInfo>::iterator it = fDylibs.begin(); it != fDylibs.end(); ++it) {
-		std::vector<MachOLayoutAbstraction::Segment>& segs = ((MachOLayoutAbstraction*)(it->layout))->getSegments();
+	for(typename std::vector<LayoutInfo*>::iterator it = textOrder.begin(); it != textOrder.end(); ++it) {
+		std::vector<MachOLayoutAbstraction::Segment>& segs = ((MachOLayoutAbstraction*)((*it)->layout))->getSegments();
 		for (int i=0; i < segs.size(); ++i) {
 			MachOLayoutAbstraction::Segment& seg = segs[i];
 			seg.reset();
@@ -1256,8 +1651,8 @@ void SharedCache<A>::assignNewBaseAddresses(bool verify)
 				// <rdar://problem/15947734> Some dylib require extra alignment
 				currentExecuteAddress = (currentExecuteAddress + seg.alignment() - 1) & (-seg.alignment());
 				// __TEXT segment
-				if ( it->info.address == 0 )
-					it->info.address = currentExecuteAddress;
+				if ( (*it)->info.address == 0 )
+					(*it)->info.address = currentExecuteAddress;
 				seg.setNewAddress(currentExecuteAddress);
 				currentExecuteAddress += pageAlign(seg.size());
 			}
@@ -1288,6 +1683,11 @@ void SharedCache<A>::assignNewBaseAddresses(bool verify)
 			}
 		}
 	}
+	if ( launchRanks != NULL ) {
+		std::stable_sort(dataConstSegs.begin(), dataConstSegs.end(), launchOrder);
+		std::stable_sort(dataSegs.begin(), dataSegs.end(), launchOrder);
+		std::stable_sort(dataDirtySegs.begin(), dataDirtySegs.end(), launchOrder);
+	}
 	// coalesce all __DATA_CONST segments
 	for (MachOLayoutAbstraction::Segment* seg : dataConstSegs) {
 	#if DENSE_PACK
@@ -1423,6 +1823,401 @@ void SharedCache<A>::assignNewBaseAddresses(bool verify)
 }
 
 
+//
+// -incremental keeps, next to the cache file, a snapshot of the cache buffer as it was right
+// after rebasing and binding, together with the layout and the pointers rebasing and binding
+// found.  Everything after that (stub optimization, LINKEDIT merging, ObjC optimization, slide
+// info) is redone from the snapshot on every build, so only the rebase/bind work is reused.
+//
+#define INCREMENTAL_STATE_MAGIC "dyld_incr_v1"
+
+static void appendIncrementalBytes(std::vector<uint8_t>& buffer, const void* bytes, size_t size)
+{
+	buffer.insert(buffer.end(), (const uint8_t*)bytes, (const uint8_t*)bytes + size);
+}
+
+template <typename T>
+static void appendIncrementalValue(std::vector<uint8_t>& buffer, const T& value)
+{
+	appendIncrementalBytes(buffer, &value, sizeof(T));
+}
+
+template <typename T>
+static void appendIncrementalVector(std::vector<uint8_t>& buffer, const std::vector<T>& vec)
+{
+	appendIncrementalValue(buffer, (uint32_t)vec.size());
+	if ( !vec.empty() )
+		appendIncrementalBytes(buffer, &vec[0], vec.size()*sizeof(T));
+}
+
+static void appendIncrementalString(std::vector<uint8_t>& buffer, const char* str)
+{
+	const uint32_t len = strlen(str)+1;
+	appendIncrementalValue(buffer, len);
+	appendIncrementalBytes(buffer, str, len);
+}
+
+class IncrementalStateReader
+{
+public:
+						IncrementalStateReader(const uint8_t* start, const uint8_t* end) : fCurrent(start), fEnd(end) {}
+	const uint8_t*		bytes(size_t size) {
+							if ( size > (size_t)(fEnd - fCurrent) )
+								throw "it is truncated";
+							const uint8_t* result = fCurrent;
+							fCurrent += size;
+							return result;
+						}
+	template <typename T>
+	T					value() { T result; memcpy(&result, bytes(sizeof(T)), sizeof(T)); return result; }
+	template <typename T>
+	void				vector(std::vector<T>& vec) {
+							const uint32_t count = value<uint32_t>();
+							const uint8_t* start = bytes((size_t)count*sizeof(T));
+							vec.resize(count);
+							if ( count != 0 )
+								memcpy(&vec[0], start, (size_t)count*sizeof(T));
+						}
+	const char*			string() {
+							const uint32_t len = value<uint32_t>();
+							const char* str = (const char*)bytes(len);
+							if ( (len == 0) || (str[len-1] != '\0') )
+								throw "it contains a malformed string";
+							return strdup(str);
+						}
+private:
+	const uint8_t*		fCurrent;
+	const uint8_t*		fEnd;
+};
+
+
+//
+// Loads the -incremental state of the previous build.  If it was built from the same set of dylibs,
+// sorts fDylibs to match it, marks the dylibs whose contents can be reused, and assigns every segment
+// its previous address.  Returns false, leaving no incremental state, if a full build is needed.
+//
+template <typename A>
+bool SharedCache<A>::loadIncrementalState(const char* path)
+{
+	int fd = ::open(path, O_RDONLY, 0);
+	if ( fd == -1 ) {
+		if ( verbose )
+			fprintf(stderr, "update_dyld_shared_cache: for %s, no incremental state in %s, doing full build\n", archName(), path);
+		return false;
+	}
+	try {
+		struct stat stat_buf;
+		if ( fstat(fd, &stat_buf) == -1 )
+			throw "it can't be stat'ed";
+		uint8_t prefix[40];
+		if ( ::pread(fd, prefix, sizeof(prefix), 0) != sizeof(prefix) )
+			throw "it can't be read";
+		char archPairName[16];
+		strlcpy(archPairName, fArchGraph->archName(), 16);
+		if ( (memcmp(prefix, INCREMENTAL_STATE_MAGIC, sizeof(INCREMENTAL_STATE_MAGIC)) != 0) || (strncmp((char*)&prefix[16], archPairName, 16) != 0) )
+			throw "it has an invalid header";
+		uint64_t indexSize;
+		memcpy(&indexSize, &prefix[32], sizeof(uint64_t));
+		if ( (indexSize < sizeof(prefix)) || (indexSize > (uint64_t)stat_buf.st_size) )
+			throw "it has an invalid header";
+		std::vector<uint8_t> index(indexSize);
+		if ( ::pread(fd, &index[0], indexSize, 0) != (ssize_t)indexSize )
+			throw "it can't be read";
+		::close(fd);
+		fd = -1;
+		
+		IncrementalStateReader reader(&index[sizeof(prefix)], &index[0]+indexSize);
+		const uint32_t cacheSize = reader.value<uint32_t>();
+		reader.vector(fIncrementalMappings);
+		fIncrementalLinkEditsStartAddress = reader.value<uint64_t>();
+		fIncrementalLinkEditsTotalUnoptimizedSize = reader.value<uint64_t>();
+		const uint32_t dylibCount = reader.value<uint32_t>();
+		if ( dylibCount != fDylibs.size() )
+			throw "the set of dylibs changed";
+		std::vector<IncrementalDylib> dylibs(dylibCount);
+		for (uint32_t i=0; i < dylibCount; ++i) {
+			IncrementalDylib& dylib = dylibs[i];
+			dylib.installName = reader.string();
+			dylib.inode = reader.value<uint64_t>();
+			dylib.modTime = reader.value<uint64_t>();
+			dylib.address = reader.value<uint64_t>();
+			dylib.rebased = (reader.value<uint8_t>() != 0);
+			dylib.reused = false;
+			reader.vector(dylib.segments);
+			reader.vector(dylib.rebasedPointers);
+			reader.vector(dylib.boundPointers);
+			dylib.exportsOffset = reader.value<uint32_t>();
+			reader.vector(dylib.sideExportTrie);
+			reader.vector(dylib.dependents);
+			const uint32_t clientCount = reader.value<uint32_t>();
+			for (uint32_t j=0; j < clientCount; ++j) {
+				IncrementalResolverClient client;
+				client.resolverIndex = reader.value<uint32_t>();
+				client.symbolName = reader.string();
+				if ( client.resolverIndex >= dylibCount )
+					throw "it is corrupt";
+				dylib.resolverClients.push_back(client);
+			}
+			for (const IncrementalDependent& dep : dylib.dependents) {
+				if ( dep.index >= dylibCount )
+					throw "it is corrupt";
+			}
+			for (uint32_t offset : dylib.rebasedPointers) {
+				if ( offset > cacheSize-sizeof(pint_t) )
+					throw "it is corrupt";
+			}
+			for (uint32_t offset : dylib.boundPointers) {
+				if ( offset > cacheSize-sizeof(pint_t) )
+					throw "it is corrupt";
+			}
+			if ( dylib.exportsOffset >= cacheSize )
+				throw "it is corrupt";
+		}
+		uint64_t mappingsEnd = 0;
+		for (const shared_file_mapping_np& mapping : fIncrementalMappings) {
+			if ( mapping.sfm_file_offset + mapping.sfm_size > mappingsEnd )
+				mappingsEnd = mapping.sfm_file_offset + mapping.sfm_size;
+		}
+		fIncrementalImageOffset = pageAlign4KB(indexSize);
+		if ( (fIncrementalMappings.size() != 3) || (mappingsEnd != cacheSize) || (fIncrementalImageOffset+cacheSize > (uint64_t)stat_buf.st_size) )
+			throw "it is corrupt";
+
+		// put dylibs in previous order, and find which ones changed
+		typedef std::unordered_map<const char*, uint32_t, typename Binder<A>::CStringHash, typename Binder<A>::CStringEquals> NameToIndex;
+		NameToIndex nameToIndex;
+		for (uint32_t i=0; i < dylibCount; ++i) 
+			nameToIndex[fDylibs[i].layout->getID().name] = i;
+		std::vector<LayoutInfo> sortedDylibs;
+		std::vector<bool> changed(dylibCount);
+		uint32_t changedCount = 0;
+		for (uint32_t i=0; i < dylibCount; ++i) {
+			typename NameToIndex::iterator pos = nameToIndex.find(dylibs[i].installName);
+			if ( pos == nameToIndex.end() )
+				throw "the set of dylibs changed";
+			const LayoutInfo& info = fDylibs[pos->second];
+			nameToIndex.erase(pos);
+			sortedDylibs.push_back(info);
+			changed[i] = ( (info.layout->getInode() != dylibs[i].inode) || ((uint64_t)info.layout->getLastModTime() != dylibs[i].modTime) );
+			if ( changed[i] ) {
+				++changedCount;
+				if ( verbose )
+					fprintf(stderr, "update_dyld_shared_cache: for %s, %s changed since previous build\n", archName(), dylibs[i].installName);
+			}
+		}
+		
+		// symbols found through a changed dylib, or through a dylib re-exporting one, may have moved,
+		// so rebind any dylib which links against one of those
+		std::vector<bool> exportsChanged(changed);
+		for (bool more=true; more; ) {
+			more = false;
+			for (uint32_t i=0; i < dylibCount; ++i) {
+				if ( exportsChanged[i] )
+					continue;
+				for (const IncrementalDependent& dep : dylibs[i].dependents) {
+					if ( dep.reExport && exportsChanged[dep.index] ) {
+						exportsChanged[i] = true;
+						more = true;
+						break;
+					}
+				}
+			}
+		}
+		fIncrementalReusedCount = 0;
+		for (uint32_t i=0; i < dylibCount; ++i) {
+			if ( exportsChanged[i] )
+				continue;
+			dylibs[i].reused = true;
+			for (const IncrementalDependent& dep : dylibs[i].dependents) {
+				if ( exportsChanged[dep.index] ) {
+					dylibs[i].reused = false;
+					break;
+				}
+			}
+			if ( dylibs[i].reused )
+				++fIncrementalReusedCount;
+		}
+
+		// nothing is changed unless every dylib fits, so a full build can still start from scratch
+		if ( !previousBaseAddressesFit(sortedDylibs, dylibs) ) 
+			throw "a changed dylib no longer fits in its previous address range";
+		fDylibs.swap(sortedDylibs);
+		fIncrementalDylibs.swap(dylibs);
+		this->assignPreviousBaseAddresses();
+		if ( verbose )
+			fprintf(stderr, "update_dyld_shared_cache: for %s, %u dylibs changed, reusing rebased and bound contents of %u of %lu dylibs\n", 
+							archName(), changedCount, fIncrementalReusedCount, fDylibs.size());
+		return true;
+	}
+	catch (const char* msg) {
+		if ( fd != -1 )
+			::close(fd);
+		if ( verbose )
+			fprintf(stderr, "update_dyld_shared_cache: for %s, not using incremental state in %s because %s, doing full build\n", archName(), path, msg);
+		fIncrementalDylibs.clear();
+		fIncrementalMappings.clear();
+		fIncrementalReusedCount = 0;
+		return false;
+	}
+}
+
+
+//
+// Returns true if every segment of every dylib can have the address it had in the previous build:
+// it still has the same name, and fits in the space up to the next segment.  Changes nothing.
+//
+template <typename A>
+bool SharedCache<A>::previousBaseAddressesFit(const std::vector<LayoutInfo>& dylibs, const std::vector<IncrementalDylib>& previous)
+{
+	for (uint32_t i=0; i < dylibs.size(); ++i) {
+		const std::vector<MachOLayoutAbstraction::Segment>& segs = dylibs[i].layout->getSegments();
+		if ( segs.size() != previous[i].segments.size() ) 
+			return false;
+		for (size_t j=0; j < segs.size(); ++j) {
+			const MachOLayoutAbstraction::Segment& seg = segs[j];
+			const IncrementalSegment& slot = previous[i].segments[j];
+			if ( strcmp(seg.name(), slot.name) != 0 )
+				return false;
+			if ( seg.writable() && seg.executable() )
+				return false;
+			uint64_t size = seg.size();
+			if ( seg.writable() && (strcmp(seg.name(), "__DATA_DIRTY") == 0) ) {
+				// same packing as assignNewBaseAddresses()
+				size = seg.sectionsSize();
+				if ( (seg.sectionsAlignment() != 0) && ((slot.address % seg.sectionsAlignment()) != 0) )
+					return false;
+			}
+			if ( seg.executable() && (seg.alignment() != 0) && ((slot.address % seg.alignment()) != 0) )
+				return false;
+			if ( size > slot.slotSize ) 
+				return false;
+		}
+	}
+	return true;
+}
+
+
+//
+// Gives every segment the address it had in the previous build.  previousBaseAddressesFit()
+// must have returned true for fDylibs.
+//
+template <typename A>
+void SharedCache<A>::assignPreviousBaseAddresses()
+{
+	fFirstLinkEditSegment = NULL;
+	for (uint32_t i=0; i < fDylibs.size(); ++i) {
+		LayoutInfo& info = fDylibs[i];
+		const IncrementalDylib& previous = fIncrementalDylibs[i];
+		std::vector<MachOLayoutAbstraction::Segment>& segs = ((MachOLayoutAbstraction*)(info.layout))->getSegments();
+		for (size_t j=0; j < segs.size(); ++j) {
+			MachOLayoutAbstraction::Segment& seg = segs[j];
+			seg.reset();
+			if ( seg.writable() && (strcmp(seg.name(), "__DATA_DIRTY") == 0) ) {
+				seg.setSize(seg.sectionsSize());
+				if ( seg.fileSize() > seg.sectionsSize() )
+					seg.setFileSize(seg.sectionsSize());
+			}
+			seg.setNewAddress(previous.segments[j].address);
+			if ( (fFirstLinkEditSegment == NULL) && (strcmp(seg.name(), "__LINKEDIT") == 0) )
+				fFirstLinkEditSegment = &seg;
+		}
+		info.info.address = previous.address;
+	}
+	fMappings = fIncrementalMappings;
+	fLinkEditsStartAddress = fIncrementalLinkEditsStartAddress;
+	fLinkEditsTotalUnoptimizedSize = fIncrementalLinkEditsTotalUnoptimizedSize;
+}
+
+
+//
+// Writes the -incremental state for this build: the cache buffer right after rebasing and binding,
+// and what rebaseAndBind() recorded in fIncrementalDylibs.
+//
+template <typename A>
+void SharedCache<A>::saveIncrementalState(const char* path, const uint8_t* cache, uint32_t cacheFileSize)
+{
+	// each segment may grow, in a later build, up to the start of the next segment in its mapping
+	std::vector<std::pair<uint64_t, IncrementalSegment*> > slots;
+	for (uint32_t i=0; i < fDylibs.size(); ++i) {
+		IncrementalDylib& dylib = fIncrementalDylibs[i];
+		dylib.segments.clear();
+		for (const MachOLayoutAbstraction::Segment& seg : fDylibs[i].layout->getSegments()) {
+			IncrementalSegment slot;
+			bzero(&slot, sizeof(slot));
+			strlcpy(slot.name, seg.name(), 16);
+			slot.address = seg.newAddress();
+			dylib.segments.push_back(slot);
+		}
+	}
+	for (uint32_t i=0; i < fDylibs.size(); ++i) {
+		const std::vector<MachOLayoutAbstraction::Segment>& segs = fDylibs[i].layout->getSegments();
+		for (size_t j=0; j < segs.size(); ++j) {
+			if ( segs[j].size() > 0 )
+				slots.push_back(std::make_pair(segs[j].newAddress(), &fIncrementalDylibs[i].segments[j]));
+		}
+	}
+	std::sort(slots.begin(), slots.end());
+	for (size_t i=0; i < slots.size(); ++i) {
+		IncrementalSegment* slot = slots[i].second;
+		for (const shared_file_mapping_np& mapping : fMappings) {
+			if ( (mapping.sfm_address <= slot->address) && (slot->address < mapping.sfm_address+mapping.sfm_size) ) {
+				uint64_t end = mapping.sfm_address+mapping.sfm_size;
+				if ( (i+1 < slots.size()) && (slots[i+1].first < end) )
+					end = slots[i+1].first;
+				slot->slotSize = end - slot->address;
+				break;
+			}
+		}
+	}
+	
+	std::vector<uint8_t> index;
+	char magic[16];
+	char archPairName[16];
+	bzero(magic, sizeof(magic));
+	bzero(archPairName, sizeof(archPairName));
+	strlcpy(magic, INCREMENTAL_STATE_MAGIC, 16);
+	strlcpy(archPairName, fArchGraph->archName(), 16);
+	appendIncrementalBytes(index, magic, 16);
+	appendIncrementalBytes(index, archPairName, 16);
+	appendIncrementalValue(index, (uint64_t)0); // index size, filled in below
+	appendIncrementalValue(index, cacheFileSize);
+	appendIncrementalVector(index, fMappings);
+	appendIncrementalValue(index, fLinkEditsStartAddress);
+	appendIncrementalValue(index, fLinkEditsTotalUnoptimizedSize);
+	appendIncrementalValue(index, (uint32_t)fIncrementalDylibs.size());
+	for (const IncrementalDylib& dylib : fIncrementalDylibs) {
+		appendIncrementalString(index, dylib.installName);
+		appendIncrementalValue(index, dylib.inode);
+		appendIncrementalValue(index, dylib.modTime);
+		appendIncrementalValue(index, dylib.address);
+		appendIncrementalValue(index, (uint8_t)dylib.rebased);
+		appendIncrementalVector(index, dylib.segments);
+		appendIncrementalVector(index, dylib.rebasedPointers);
+		appendIncrementalVector(index, dylib.boundPointers);
+		appendIncrementalValue(index, dylib.exportsOffset);
+		appendIncrementalVector(index, dylib.sideExportTrie);
+		appendIncrementalVector(index, dylib.dependents);
+		appendIncrementalValue(index, (uint32_t)dylib.resolverClients.size());
+		for (const IncrementalResolverClient& client : dylib.resolverClients) {
+			appendIncrementalValue(index, client.resolverIndex);
+			appendIncrementalString(index, client.symbolName);
+		}
+	}
+	const uint64_t indexSize = index.size();
+	memcpy(&index[32], &indexSize, sizeof(uint64_t));
+
+	int fd = ::open(path, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+	if ( fd == -1 )
+		throwf("can't create incremental state file %s, errno=%d", path, errno);
+	if ( (::pwrite(fd, &index[0], indexSize, 0) != (ssize_t)indexSize)
+		|| (::pwrite(fd, cache, cacheFileSize, pageAlign4KB(indexSize)) != (ssize_t)cacheFileSize) ) {
+		::close(fd);
+		::unlink(path);
+		throwf("write() failure creating incremental state file %s, errno=%d", path, errno);
+	}
+	::close(fd);
+}
+
+
 template <typename A>
 uint64_t SharedCache<A>::cacheFileOffsetForVMAddress(uint64_t vmaddr) const
 {
@@ -1597,37 +2392,79 @@ bool SharedCache<A>::notUpToDate(const char* path, unsigned int aliasCount)
 
 
 
+//
+// Merges the LINKEDIT of every dylib into one shared LINKEDIT.  This is done in passes
+// so the per-dylib work can run in parallel and still produce the same bytes as merging
+// one dylib after another:
+//   1) gatherSymbols() (parallel) builds each dylib's new symbol table in a private
+//      vector, with n_strx holding an index into the dylib's own list of unique names
+//   2) assign*() (serial, in dylib order) adds each dylib's unique names to the merged
+//      string pools, which are then tail merged, and turns the per-section sizes into
+//      offsets with a running sum
+//   3) copySymbolsAndInfo() and copyTablesAndLoadCommands() (parallel) write each
+//      dylib's fragments at its assigned offsets and update its load commands
+//
 template <typename A>
 class LinkEditOptimizer
 {
 public:
-											LinkEditOptimizer(const MachOLayoutAbstraction&, const SharedCache<A>&, uint8_t*, StringPool&);
+	typedef typename A::P					P;
+
+	struct MergeWork {
+		std::vector<LinkEditOptimizer<A>*>*	optimizers;
+		macho_nlist<P>*						unmappedSymbols;
+		const StringPool*					stringPool;
+		const StringPool*					unmappedLocalsStringPool;
+		bool								dontMapLocalSymbols;
+		bool								keepSignatures;
+		uint64_t							newVMAddress;
+		uint64_t							linkEditSize;
+		uint32_t							stringPoolOffset;
+		uint32_t							stringPoolSize;
+		uint32_t							linkEditsFileOffset;
+	};
+
+											LinkEditOptimizer(const MachOLayoutAbstraction&, const SharedCache<A>&, uint8_t*);
 	virtual									~LinkEditOptimizer() {}
 
-		void								copyBindInfo(uint32_t&);
-		void								copyWeakBindInfo(uint32_t&);
-		void								copyLazyBindInfo(uint32_t&);
-		void								copyExportInfo(uint32_t&);
-		void								copyLocalSymbols(uint32_t symbolTableOffset, uint32_t&, bool dontMapLocalSymbols,
-															uint8_t* cacheStart, StringPool& unmappedLocalsStringPool, 
-															std::vector<macho_nlist<typename A::P> >& unmappedSymbols,
-															std::vector<LocalSymbolInfo>& info);
-		void								copyExportedSymbols(uint32_t symbolTableOffset, uint32_t&);
-		void								copyImportedSymbols(uint32_t symbolTableOffset, uint32_t&);
-		void								copyExternalRelocations(uint32_t& offset);
-		void								copyIndirectSymbolTable(uint32_t& offset);
-		void								copyFunctionStarts(uint32_t& offset);
-		void								copyDataInCode(uint32_t& offset);
-		void								updateLoadCommands(uint64_t newVMAddress, uint64_t size, uint32_t stringPoolOffset, 
-																uint32_t linkEditsFileOffset, bool keepSignatures);
+		static void							gatherSymbols(void* mergeWork, uint32_t index);
+		static void							copySymbolsAndInfo(void* mergeWork, uint32_t index);
+		static void							copyTablesAndLoadCommands(void* mergeWork, uint32_t index);
+
+		void								assignBindInfoOffset(uint32_t&);
+		void								assignWeakBindInfoOffset(uint32_t&);
+		void								assignLazyBindInfoOffset(uint32_t&);
+		void								assignExportInfoOffset(uint32_t&);
+		void								assignSymbolTableOffset(uint32_t symbolTableOffset, uint32_t& symbolIndex);
+		void								assignUnmappedLocalSymbols(uint32_t& unmappedIndex, uint8_t* cacheStart, std::vector<LocalSymbolInfo>& info);
+		void								assignStringPoolOffsets(StringPool& stringPool, StringPool& unmappedLocalsStringPool);
+		void								assignExternalRelocationsOffset(uint32_t& offset);
+		void								assignIndirectSymbolTableOffset(uint32_t& offset);
+		void								assignFunctionStartsOffset(uint32_t& offset);
+		void								assignDataInCodeOffset(uint32_t& offset);
+		const char*							error() const { return fError; }
+		uint64_t							workTime() const { return fWorkTime; }
 	
 
 protected:
-	typedef typename A::P					P;
 	typedef typename A::P::E				E;
 	typedef typename A::P::uint_t			pint_t;
 			
 private:
+	typedef std::unordered_map<const char*, uint32_t, CStringHash, CStringEquals> NameToIndex;
+
+		void								gatherLocalSymbols(bool dontMapLocalSymbols);
+		void								gatherExportedSymbols();
+		void								gatherImportedSymbols();
+		void								copyInfo();
+		void								copySymbols(macho_nlist<P>* unmappedSymbols, const StringPool& stringPool, const StringPool& unmappedLocalsStringPool);
+		void								copyExternalRelocations();
+		void								copyIndirectSymbolTable();
+		void								copyFunctionStarts();
+		void								copyDataInCode();
+		void								updateLoadCommands(uint64_t newVMAddress, uint64_t size, uint32_t stringPoolOffset, uint32_t stringPoolSize,
+																uint32_t linkEditsFileOffset, bool keepSignatures);
+		static uint32_t						nameIndex(const char* name, std::vector<const char*>& names, NameToIndex& indexes);
 
 	const SharedCache<A>&						fSharedCache;
 	const macho_header<P>*						fHeader; 
@@ -1641,8 +2478,17 @@ private:
 	macho_symtab_command<P>*					fSymbolTableLoadCommand;
 	const macho_nlist<P>*						fSymbolTable;
 	const char*									fStrings;
-	StringPool&									fNewStringPool;
 	std::map<uint32_t,uint32_t>					fOldToNewSymbolIndexes;
+	std::vector<macho_nlist<P> >				fNewSymbols;			// locals, exports, imports. n_strx is index into fNames
+	std::vector<const char*>					fNames;					// unique names of fNewSymbols, in first use order
+	std::vector<uint32_t>						fNameOffsets;			// offset of each fNames string in merged string pool
+	NameToIndex									fNameIndexes;
+	std::vector<macho_nlist<P> >				fUnmappedLocals;		// n_strx is index into fUnmappedNames
+	std::vector<const char*>					fUnmappedNames;
+	std::vector<uint32_t>						fUnmappedNameOffsets;
+	NameToIndex									fUnmappedNameIndexes;
+	const char*									fError;
+	uint64_t									fWorkTime;
 	uint32_t									fBindInfoOffsetIntoNewLinkEdit;
 	uint32_t									fBindInfoSizeInNewLinkEdit;
 	uint32_t									fWeakBindInfoOffsetIntoNewLinkEdit;
@@ -1669,10 +2515,10 @@ private:
 
 
 template <typename A>
-LinkEditOptimizer<A>::LinkEditOptimizer(const MachOLayoutAbstraction& layout, const SharedCache<A>& sharedCache, uint8_t* newLinkEdit, StringPool& stringPool)
+LinkEditOptimizer<A>::LinkEditOptimizer(const MachOLayoutAbstraction& layout, const SharedCache<A>& sharedCache, uint8_t* newLinkEdit)
  : 	fSharedCache(sharedCache), fLayout(layout), fLinkEditBase(NULL), fNewLinkEditStart(newLinkEdit), fDyldInfo(NULL),
 	fDynamicSymbolTable(NULL), fFunctionStarts(NULL), fDataInCode(NULL), 
-	fSymbolTableLoadCommand(NULL), fSymbolTable(NULL), fStrings(NULL), fNewStringPool(stringPool),
+	fSymbolTableLoadCommand(NULL), fSymbolTable(NULL), fStrings(NULL), fError(NULL), fWorkTime(0),
 	fBindInfoOffsetIntoNewLinkEdit(0), fBindInfoSizeInNewLinkEdit(0),
 	fWeakBindInfoOffsetIntoNewLinkEdit(0), fWeakBindInfoSizeInNewLinkEdit(0),
 	fLazyBindInfoOffsetIntoNewLinkEdit(0), fLazyBindInfoSizeInNewLinkEdit(0),
@@ -1737,164 +2583,275 @@ class SymbolSorter
 {
 public:
 	typedef typename A::P P;
-	SymbolSorter(const StringPool& pool) : fStringPool(pool) {}
+	SymbolSorter(const std::vector<const char*>& names) : fNames(names) {}
 	bool operator()(const macho_nlist<P>& left, const macho_nlist<P>& right) { 
-		return (strcmp(fStringPool.stringAtIndex(left.n_strx()) , fStringPool.stringAtIndex(right.n_strx())) < 0); 
+		return (strcmp(fNames[left.n_strx()], fNames[right.n_strx()]) < 0); 
 	} 
 	
 private:
-	const StringPool& fStringPool;
+	const std::vector<const char*>& fNames;
 };
 
 
 template <typename A>
-void LinkEditOptimizer<A>::copyBindInfo(uint32_t& offset)
+uint32_t LinkEditOptimizer<A>::nameIndex(const char* name, std::vector<const char*>& names, NameToIndex& indexes)
+{
+	typename NameToIndex::iterator pos = indexes.find(name);
+	if ( pos != indexes.end() ) 
+		return pos->second;
+	uint32_t index = names.size();
+	names.push_back(name);
+	indexes[name] = index;
+	return index;
+}
+
+
+template <typename A>
+void LinkEditOptimizer<A>::gatherSymbols(void* mergeWork, uint32_t index)
+{
+	MergeWork* work = (MergeWork*)mergeWork;
+	LinkEditOptimizer<A>* optimizer = (*work->optimizers)[index];
+	uint64_t startTime = mach_absolute_time();
+	optimizer->gatherLocalSymbols(work->dontMapLocalSymbols);
+	optimizer->gatherExportedSymbols();
+	optimizer->gatherImportedSymbols();
+	optimizer->fWorkTime += (mach_absolute_time() - startTime);
+}
+
+template <typename A>
+void LinkEditOptimizer<A>::copySymbolsAndInfo(void* mergeWork, uint32_t index)
+{
+	MergeWork* work = (MergeWork*)mergeWork;
+	LinkEditOptimizer<A>* optimizer = (*work->optimizers)[index];
+	uint64_t startTime = mach_absolute_time();
+	try {
+		optimizer->copyInfo();
+		optimizer->copySymbols(work->unmappedSymbols, *work->stringPool, *work->unmappedLocalsStringPool);
+	}
+	catch (const char* msg) {
+		optimizer->fError = msg;
+	}
+	optimizer->fWorkTime += (mach_absolute_time() - startTime);
+}
+
+// external relocations start 8-byte aligned, rounding down, after the symbol table, so
+// this pass must not start until every dylib's symbols have been copied
+template <typename A>
+void LinkEditOptimizer<A>::copyTablesAndLoadCommands(void* mergeWork, uint32_t index)
+{
+	MergeWork* work = (MergeWork*)mergeWork;
+	LinkEditOptimizer<A>* optimizer = (*work->optimizers)[index];
+	uint64_t startTime = mach_absolute_time();
+	try {
+		optimizer->copyExternalRelocations();
+		optimizer->copyFunctionStarts();
+		optimizer->copyDataInCode();
+		optimizer->copyIndirectSymbolTable();
+		optimizer->updateLoadCommands(work->newVMAddress, work->linkEditSize, work->stringPoolOffset, work->stringPoolSize, 
+										work->linkEditsFileOffset, work->keepSignatures);
+	}
+	catch (const char* msg) {
+		optimizer->fError = msg;
+	}
+	optimizer->fWorkTime += (mach_absolute_time() - startTime);
+}
+
+
+template <typename A>
+void LinkEditOptimizer<A>::assignBindInfoOffset(uint32_t& offset)
 {
 	if ( (fDyldInfo != NULL) && (fDyldInfo->bind_off() != 0) ) {
 		fBindInfoOffsetIntoNewLinkEdit = offset;
 		fBindInfoSizeInNewLinkEdit = fDyldInfo->bind_size();
-		memcpy(fNewLinkEditStart+offset, &fLinkEditBase[fDyldInfo->bind_off()], fDyldInfo->bind_size());
 		offset += fDyldInfo->bind_size();
 	}
 }
 
 template <typename A>
-void LinkEditOptimizer<A>::copyWeakBindInfo(uint32_t& offset)
+void LinkEditOptimizer<A>::assignWeakBindInfoOffset(uint32_t& offset)
 {
 	if ( (fDyldInfo != NULL) && (fDyldInfo->weak_bind_off() != 0) ) {
 		fWeakBindInfoOffsetIntoNewLinkEdit = offset;
 		fWeakBindInfoSizeInNewLinkEdit = fDyldInfo->weak_bind_size();
-		memcpy(fNewLinkEditStart+offset, &fLinkEditBase[fDyldInfo->weak_bind_off()], fDyldInfo->weak_bind_size());
 		offset += fDyldInfo->weak_bind_size();
 	}
 }
 
 template <typename A>
-void LinkEditOptimizer<A>::copyLazyBindInfo(uint32_t& offset)
+void LinkEditOptimizer<A>::assignLazyBindInfoOffset(uint32_t& offset)
 {
 	if ( (fDyldInfo != NULL) && (fDyldInfo->lazy_bind_off() != 0) ) {
 		fLazyBindInfoOffsetIntoNewLinkEdit = offset;
 		fLazyBindInfoSizeInNewLinkEdit = fDyldInfo->lazy_bind_size();
-		memcpy(fNewLinkEditStart+offset, &fLinkEditBase[fDyldInfo->lazy_bind_off()], fDyldInfo->lazy_bind_size());
 		offset += fDyldInfo->lazy_bind_size();
 	}
 }
 
 template <typename A>
-void LinkEditOptimizer<A>::copyExportInfo(uint32_t& offset)
+void LinkEditOptimizer<A>::assignExportInfoOffset(uint32_t& offset)
 {
 	if ( (fDyldInfo != NULL) && (fLayout.getDyldInfoExports() != NULL) ) {
 		fExportInfoOffsetIntoNewLinkEdit = offset;
 		fExportInfoSizeInNewLinkEdit = fDyldInfo->export_size();
-		memcpy(fNewLinkEditStart+offset, fLayout.getDyldInfoExports(), fDyldInfo->export_size());
 		offset += fDyldInfo->export_size();
 	}
 }
 
+template <typename A>
+void LinkEditOptimizer<A>::copyInfo()
+{
+	if ( fBindInfoSizeInNewLinkEdit != 0 )
+		memcpy(fNewLinkEditStart+fBindInfoOffsetIntoNewLinkEdit, &fLinkEditBase[fDyldInfo->bind_off()], fBindInfoSizeInNewLinkEdit);
+	if ( fWeakBindInfoSizeInNewLinkEdit != 0 )
+		memcpy(fNewLinkEditStart+fWeakBindInfoOffsetIntoNewLinkEdit, &fLinkEditBase[fDyldInfo->weak_bind_off()], fWeakBindInfoSizeInNewLinkEdit);
+	if ( fLazyBindInfoSizeInNewLinkEdit != 0 )
+		memcpy(fNewLinkEditStart+fLazyBindInfoOffsetIntoNewLinkEdit, &fLinkEditBase[fDyldInfo->lazy_bind_off()], fLazyBindInfoSizeInNewLinkEdit);
+	if ( fExportInfoSizeInNewLinkEdit != 0 )
+		memcpy(fNewLinkEditStart+fExportInfoOffsetIntoNewLinkEdit, fLayout.getDyldInfoExports(), fExportInfoSizeInNewLinkEdit);
+}
+
 
 template <typename A>
-void LinkEditOptimizer<A>::copyLocalSymbols(uint32_t symbolTableOffset, uint32_t& symbolIndex, bool dontMapLocalSymbols, uint8_t* cacheStart, 
-											StringPool&	unmappedLocalsStringPool, std::vector<macho_nlist<P> >& unmappedSymbols,
-											std::vector<LocalSymbolInfo>& dylibInfos)
+void LinkEditOptimizer<A>::gatherLocalSymbols(bool dontMapLocalSymbols)
 {
-	fLocalSymbolsStartIndexInNewLinkEdit = symbolIndex;
-	LocalSymbolInfo localInfo;
-	localInfo.dylibOffset = ((uint8_t*)fHeader) - cacheStart;
-	localInfo.nlistStartIndex = unmappedSymbols.size();
-	localInfo.nlistCount = 0;
-	fSymbolTableStartOffsetInNewLinkEdit = symbolTableOffset + symbolIndex*sizeof(macho_nlist<P>);
-	macho_nlist<P>* const newSymbolTableStart = (macho_nlist<P>*)(fNewLinkEditStart+symbolTableOffset);
 	const macho_nlist<P>* const firstLocal = &fSymbolTable[fDynamicSymbolTable->ilocalsym()];
 	const macho_nlist<P>* const lastLocal  = &fSymbolTable[fDynamicSymbolTable->ilocalsym()+fDynamicSymbolTable->nlocalsym()];
-	uint32_t oldIndex = fDynamicSymbolTable->ilocalsym();
-	for (const macho_nlist<P>* entry = firstLocal; entry < lastLocal; ++entry, ++oldIndex) {
+	for (const macho_nlist<P>* entry = firstLocal; entry < lastLocal; ++entry) {
 		// <rdar://problem/12237639> don't copy stab symbols
 		if ( (entry->n_sect() != NO_SECT) && ((entry->n_type() & N_STAB) == 0) ) {
 			const char* name = &fStrings[entry->n_strx()];
-			macho_nlist<P>* newSymbolEntry = &newSymbolTableStart[symbolIndex];
-			*newSymbolEntry = *entry;
 			if ( dontMapLocalSymbols ) {
 				// if local in __text, add <redacted> symbol name to shared cache so backtraces don't have bogus names
 				if ( entry->n_sect() == 1 ) {
-					newSymbolEntry->set_n_strx(fNewStringPool.addUnique("<redacted>"));
-					++symbolIndex;
+					fNewSymbols.push_back(*entry);
+					fNewSymbols.back().set_n_strx(nameIndex("<redacted>", fNames, fNameIndexes));
 				}
 				// copy local symbol to unmmapped locals area
-				unmappedSymbols.push_back(*entry);			
-				unmappedSymbols.back().set_n_strx(unmappedLocalsStringPool.addUnique(name));
+				fUnmappedLocals.push_back(*entry);
+				fUnmappedLocals.back().set_n_strx(nameIndex(name, fUnmappedNames, fUnmappedNameIndexes));
 			}
 			else {
-				newSymbolEntry->set_n_strx(fNewStringPool.addUnique(name));
-				++symbolIndex;
+				fNewSymbols.push_back(*entry);
+				fNewSymbols.back().set_n_strx(nameIndex(name, fNames, fNameIndexes));
 			}
 		}
 	}
-	fLocalSymbolsCountInNewLinkEdit = symbolIndex - fLocalSymbolsStartIndexInNewLinkEdit;
-	localInfo.nlistCount = unmappedSymbols.size() - localInfo.nlistStartIndex;
-	dylibInfos.push_back(localInfo);
-	//fprintf(stderr, "%u locals starting at %u for %s\n", fLocalSymbolsCountInNewLinkEdit, fLocalSymbolsStartIndexInNewLinkEdit, fLayout.getFilePath());
+	fLocalSymbolsCountInNewLinkEdit = fNewSymbols.size();
+	fUnmappedLocalSymbolsCountInNewLinkEdit = fUnmappedLocals.size();
 }
 
 
 template <typename A>
-void LinkEditOptimizer<A>::copyExportedSymbols(uint32_t symbolTableOffset, uint32_t& symbolIndex)
+void LinkEditOptimizer<A>::gatherExportedSymbols()
 {
-	fExportedSymbolsStartIndexInNewLinkEdit = symbolIndex;
-	macho_nlist<P>* const newSymbolTableStart = (macho_nlist<P>*)(fNewLinkEditStart+symbolTableOffset);
+	const uint32_t exportsStart = fNewSymbols.size();
 	const macho_nlist<P>* const firstExport = &fSymbolTable[fDynamicSymbolTable->iextdefsym()];
 	const macho_nlist<P>* const lastExport  = &fSymbolTable[fDynamicSymbolTable->iextdefsym()+fDynamicSymbolTable->nextdefsym()];
 	uint32_t oldIndex = fDynamicSymbolTable->iextdefsym();
 	for (const macho_nlist<P>* entry = firstExport; entry < lastExport; ++entry, ++oldIndex) {
 		if ( ((entry->n_type() & N_TYPE) == N_SECT) && (strncmp(&fStrings[entry->n_strx()], ".objc_", 6) != 0)
 						&& (strncmp(&fStrings[entry->n_strx()], "$ld$", 4) != 0) ) {
-			macho_nlist<P>* newSymbolEntry = &newSymbolTableStart[symbolIndex];
-			*newSymbolEntry = *entry;
-			newSymbolEntry->set_n_strx(fNewStringPool.addUnique(&fStrings[entry->n_strx()]));
-			fOldToNewSymbolIndexes[oldIndex] = symbolIndex-fLocalSymbolsStartIndexInNewLinkEdit;
-			++symbolIndex;
+			fOldToNewSymbolIndexes[oldIndex] = fNewSymbols.size();
+			fNewSymbols.push_back(*entry);
+			fNewSymbols.back().set_n_strx(nameIndex(&fStrings[entry->n_strx()], fNames, fNameIndexes));
 		}
 	}
-	fExportedSymbolsCountInNewLinkEdit = symbolIndex - fExportedSymbolsStartIndexInNewLinkEdit;
-	//fprintf(stderr, "%u exports starting at %u for %s\n", fExportedSymbolsCountInNewLinkEdit, fExportedSymbolsStartIndexInNewLinkEdit, fLayout.getFilePath());
+	fExportedSymbolsCountInNewLinkEdit = fNewSymbols.size() - exportsStart;
 	// sort by name, so that dyld does not need a toc
-	macho_nlist<P>* newSymbolsStart = &newSymbolTableStart[fExportedSymbolsStartIndexInNewLinkEdit];
-	macho_nlist<P>* newSymbolsEnd = &newSymbolTableStart[fExportedSymbolsStartIndexInNewLinkEdit+fExportedSymbolsCountInNewLinkEdit];
-	std::sort(newSymbolsStart, newSymbolsEnd, SymbolSorter<A>(fNewStringPool));
-	//for (macho_nlist<P>* entry = newSymbolsStart; entry < newSymbolsEnd; ++entry)
-	//	fprintf(stderr, "\t%u\t %s\n", (entry-newSymbolsStart)+fExportedSymbolsStartIndexInNewLinkEdit, fNewStringPool.stringAtIndex(entry->n_strx()));
+	std::sort(fNewSymbols.begin()+exportsStart, fNewSymbols.end(), SymbolSorter<A>(fNames));
 }
 
 
 template <typename A>
-void LinkEditOptimizer<A>::copyImportedSymbols(uint32_t symbolTableOffset, uint32_t& symbolIndex)
+void LinkEditOptimizer<A>::gatherImportedSymbols()
 {
-	fImportSymbolsStartIndexInNewLinkEdit = symbolIndex;
-	macho_nlist<P>* const newSymbolTableStart = (macho_nlist<P>*)(fNewLinkEditStart+symbolTableOffset);
+	const uint32_t importsStart = fNewSymbols.size();
 	const macho_nlist<P>* const firstImport = &fSymbolTable[fDynamicSymbolTable->iundefsym()];
 	const macho_nlist<P>* const lastImport  = &fSymbolTable[fDynamicSymbolTable->iundefsym()+fDynamicSymbolTable->nundefsym()];
 	uint32_t oldIndex = fDynamicSymbolTable->iundefsym();
 	for (const macho_nlist<P>* entry = firstImport; entry < lastImport; ++entry, ++oldIndex) {
 		if ( ((entry->n_type() & N_TYPE) == N_UNDF) && (strncmp(&fStrings[entry->n_strx()], ".objc_", 6) != 0) ) {
-			macho_nlist<P>* newSymbolEntry = &newSymbolTableStart[symbolIndex];
-			*newSymbolEntry = *entry;
-			newSymbolEntry->set_n_strx(fNewStringPool.addUnique(&fStrings[entry->n_strx()]));
-			fOldToNewSymbolIndexes[oldIndex] = symbolIndex-fLocalSymbolsStartIndexInNewLinkEdit;
-			++symbolIndex;
+			fOldToNewSymbolIndexes[oldIndex] = fNewSymbols.size();
+			fNewSymbols.push_back(*entry);
+			fNewSymbols.back().set_n_strx(nameIndex(&fStrings[entry->n_strx()], fNames, fNameIndexes));
 		}
 	}
-	fImportedSymbolsCountInNewLinkEdit = symbolIndex - fImportSymbolsStartIndexInNewLinkEdit;
-	//fprintf(stderr, "%u imports starting at %u for %s\n", fImportedSymbolsCountInNewLinkEdit, fImportSymbolsStartIndexInNewLinkEdit, fLayout.getFilePath());
-	//macho_nlist<P>* newSymbolsStart = &((macho_nlist<P>*)fNewLinkEditStart)[fImportSymbolsStartIndexInNewLinkEdit];
-	//macho_nlist<P>* newSymbolsEnd = &((macho_nlist<P>*)fNewLinkEditStart)[fImportSymbolsStartIndexInNewLinkEdit+fImportedSymbolsCountInNewLinkEdit];
-	//for (macho_nlist<P>* entry = newSymbolsStart; entry < newSymbolsEnd; ++entry)
-	//	fprintf(stderr, "\t%u\t%s\n", (entry-newSymbolsStart)+fImportSymbolsStartIndexInNewLinkEdit, fNewStringPool.stringAtIndex(entry->n_strx()));
+	fImportedSymbolsCountInNewLinkEdit = fNewSymbols.size() - importsStart;
 }
 
 
+// Adding each dylib's unique names in dylib order puts every string in the pool at the
+// same offset as adding every symbol name in order would, but with far fewer lookups.
 template <typename A>
-void LinkEditOptimizer<A>::copyExternalRelocations(uint32_t& offset)
+void LinkEditOptimizer<A>::assignStringPoolOffsets(StringPool& stringPool, StringPool& unmappedLocalsStringPool)
+{
+	fNameOffsets.reserve(fNames.size());
+	for (std::vector<const char*>::iterator it=fNames.begin(); it != fNames.end(); ++it) 
+		fNameOffsets.push_back(stringPool.addUnique(*it));
+	fUnmappedNameOffsets.reserve(fUnmappedNames.size());
+	for (std::vector<const char*>::iterator it=fUnmappedNames.begin(); it != fUnmappedNames.end(); ++it) 
+		fUnmappedNameOffsets.push_back(unmappedLocalsStringPool.addUnique(*it));
+}
+
+
+template <typename A>
+void LinkEditOptimizer<A>::assignSymbolTableOffset(uint32_t symbolTableOffset, uint32_t& symbolIndex)
+{
+	fSymbolTableStartOffsetInNewLinkEdit = symbolTableOffset + symbolIndex*sizeof(macho_nlist<P>);
+	fLocalSymbolsStartIndexInNewLinkEdit = symbolIndex;
+	fExportedSymbolsStartIndexInNewLinkEdit = fLocalSymbolsStartIndexInNewLinkEdit + fLocalSymbolsCountInNewLinkEdit;
+	fImportSymbolsStartIndexInNewLinkEdit = fExportedSymbolsStartIndexInNewLinkEdit + fExportedSymbolsCountInNewLinkEdit;
+	symbolIndex += fNewSymbols.size();
+	//fprintf(stderr, "%u locals starting at %u for %s\n", fLocalSymbolsCountInNewLinkEdit, fLocalSymbolsStartIndexInNewLinkEdit, fLayout.getFilePath());
+}
+
+
+template <typename A>
+void LinkEditOptimizer<A>::assignUnmappedLocalSymbols(uint32_t& unmappedIndex, uint8_t* cacheStart, std::vector<LocalSymbolInfo>& dylibInfos)
+{
+	fUnmappedLocalSymbolsStartIndexInNewLinkEdit = unmappedIndex;
+	LocalSymbolInfo localInfo;
+	localInfo.dylibOffset = ((uint8_t*)fHeader) - cacheStart;
+	localInfo.nlistStartIndex = unmappedIndex;
+	localInfo.nlistCount = fUnmappedLocalSymbolsCountInNewLinkEdit;
+	dylibInfos.push_back(localInfo);
+	unmappedIndex += fUnmappedLocalSymbolsCountInNewLinkEdit;
+}
+
+
+template <typename A>
+void LinkEditOptimizer<A>::copySymbols(macho_nlist<P>* unmappedSymbols, const StringPool& stringPool, const StringPool& unmappedLocalsStringPool)
+{
+	// string pools have been tail merged since offsets were assigned
+	for (std::vector<uint32_t>::iterator it=fNameOffsets.begin(); it != fNameOffsets.end(); ++it)
+		*it = stringPool.sharedOffset(*it);
+	for (std::vector<uint32_t>::iterator it=fUnmappedNameOffsets.begin(); it != fUnmappedNameOffsets.end(); ++it)
+		*it = unmappedLocalsStringPool.sharedOffset(*it);
+
+	macho_nlist<P>* newSymbolEntry = (macho_nlist<P>*)(fNewLinkEditStart+fSymbolTableStartOffsetInNewLinkEdit);
+	for (typename std::vector<macho_nlist<P> >::iterator it=fNewSymbols.begin(); it != fNewSymbols.end(); ++it, ++newSymbolEntry) {
+		*newSymbolEntry = *it;
+		newSymbolEntry->set_n_strx(fNameOffsets[it->n_strx()]);
+	}
+	macho_nlist<P>* unmappedEntry = &unmappedSymbols[fUnmappedLocalSymbolsStartIndexInNewLinkEdit];
+	for (typename std::vector<macho_nlist<P> >::iterator it=fUnmappedLocals.begin(); it != fUnmappedLocals.end(); ++it, ++unmappedEntry) {
+		*unmappedEntry = *it;
+		unmappedEntry->set_n_strx(fUnmappedNameOffsets[it->n_strx()]);
+	}
+}
+
+
+template <typename A>
+void LinkEditOptimizer<A>::assignExternalRelocationsOffset(uint32_t& offset)
 {
 	fExternalRelocationsOffsetIntoNewLinkEdit = offset;
+	offset += fDynamicSymbolTable->nextrel() * sizeof(macho_relocation_info<P>);
+}
+
+template <typename A>
+void LinkEditOptimizer<A>::copyExternalRelocations()
+{
+	uint32_t offset = fExternalRelocationsOffsetIntoNewLinkEdit;
 	const macho_relocation_info<P>* const relocsStart = (macho_relocation_info<P>*)(&fLinkEditBase[fDynamicSymbolTable->extreloff()]);
 	const macho_relocation_info<P>* const relocsEnd = &relocsStart[fDynamicSymbolTable->nextrel()];
 	for (const macho_relocation_info<P>* reloc=relocsStart; reloc < relocsEnd; ++reloc) {
@@ -1909,32 +2866,50 @@ void LinkEditOptimizer<A>::copyExternalRelocations(uint32_t& offset)
 }
 
 template <typename A>
-void LinkEditOptimizer<A>::copyFunctionStarts(uint32_t& offset)
+void LinkEditOptimizer<A>::assignFunctionStartsOffset(uint32_t& offset)
 {	
 	if ( fFunctionStarts != NULL ) {
 		fFunctionStartsOffsetInNewLinkEdit = offset;
-		memcpy(&fNewLinkEditStart[offset], &fLinkEditBase[fFunctionStarts->dataoff()], fFunctionStarts->datasize());
 		offset += fFunctionStarts->datasize();
 	}
 }
 
 template <typename A>
-void LinkEditOptimizer<A>::copyDataInCode(uint32_t& offset)
+void LinkEditOptimizer<A>::copyFunctionStarts()
+{	
+	if ( fFunctionStarts != NULL ) 
+		memcpy(&fNewLinkEditStart[fFunctionStartsOffsetInNewLinkEdit], &fLinkEditBase[fFunctionStarts->dataoff()], fFunctionStarts->datasize());
+}
+
+template <typename A>
+void LinkEditOptimizer<A>::assignDataInCodeOffset(uint32_t& offset)
 {	
 	if ( fDataInCode != NULL ) {
 		fDataInCodeOffsetInNewLinkEdit = offset;
-		memcpy(&fNewLinkEditStart[offset], &fLinkEditBase[fDataInCode->dataoff()], fDataInCode->datasize());
 		offset += fDataInCode->datasize();
 	}
 }
 
+template <typename A>
+void LinkEditOptimizer<A>::copyDataInCode()
+{	
+	if ( fDataInCode != NULL ) 
+		memcpy(&fNewLinkEditStart[fDataInCodeOffsetInNewLinkEdit], &fLinkEditBase[fDataInCode->dataoff()], fDataInCode->datasize());
+}
+
 
 template <typename A>
-void LinkEditOptimizer<A>::copyIndirectSymbolTable(uint32_t& offset)
+void LinkEditOptimizer<A>::assignIndirectSymbolTableOffset(uint32_t& offset)
 {	
 	fIndirectSymbolTableOffsetInfoNewLinkEdit = offset;
+	offset += (fDynamicSymbolTable->nindirectsyms() * 4);
+}
+
+template <typename A>
+void LinkEditOptimizer<A>::copyIndirectSymbolTable()
+{	
 	const uint32_t* const indirectTable = (uint32_t*)&this->fLinkEditBase[fDynamicSymbolTable->indirectsymoff()];
-	uint32_t* newIndirectTable = (uint32_t*)&fNewLinkEditStart[offset];
+	uint32_t* newIndirectTable = (uint32_t*)&fNewLinkEditStart[fIndirectSymbolTableOffsetInfoNewLinkEdit];
 	for (int i=0; i < fDynamicSymbolTable->nindirectsyms(); ++i) {
 		uint32_t oldSymbolIndex = E::get32(indirectTable[i]); 
 		uint32_t newSymbolIndex = oldSymbolIndex;
@@ -1945,11 +2920,10 @@ void LinkEditOptimizer<A>::copyIndirectSymbolTable(uint32_t& offset)
 		}
 		E::set32(newIndirectTable[i], newSymbolIndex);
 	}
-	offset += (fDynamicSymbolTable->nindirectsyms() * 4);
 }
 
 template <typename A>
-void LinkEditOptimizer<A>::updateLoadCommands(uint64_t newVMAddress, uint64_t leSize, uint32_t stringPoolOffset, 
+void LinkEditOptimizer<A>::updateLoadCommands(uint64_t newVMAddress, uint64_t leSize, uint32_t stringPoolOffset, uint32_t stringPoolSize,
 												uint32_t linkEditsFileOffset, bool keepSignatures)
 {
 	// set LINKEDIT segment commmand to new merged LINKEDIT
@@ -2024,7 +2998,7 @@ void LinkEditOptimizer<A>::updateLoadCommands(uint64_t newVMAddress, uint64_t le
 	fSymbolTableLoadCommand->set_symoff(linkEditsFileOffset+fSymbolTableStartOffsetInNewLinkEdit);
 	fSymbolTableLoadCommand->set_nsyms(fLocalSymbolsCountInNewLinkEdit+fExportedSymbolsCountInNewLinkEdit+fImportedSymbolsCountInNewLinkEdit);
 	fSymbolTableLoadCommand->set_stroff(linkEditsFileOffset+stringPoolOffset);
-	fSymbolTableLoadCommand->set_strsize(fNewStringPool.size());
+	fSymbolTableLoadCommand->set_strsize(stringPoolSize);
 	fDynamicSymbolTable->set_ilocalsym(0);
 	fDynamicSymbolTable->set_nlocalsym(fLocalSymbolsCountInNewLinkEdit);
 	fDynamicSymbolTable->set_iextdefsym(fExportedSymbolsStartIndexInNewLinkEdit-fLocalSymbolsStartIndexInNewLinkEdit);
@@ -2104,82 +3078,103 @@ uint8_t* SharedCache<A>::optimizeLINKEDIT(bool keepSignatures, bool dontMapLocal
 	// create optimizer object for each LINKEDIT segment
 	std::vector<LinkEditOptimizer<A>*> optimizers;
 	for(typename std::vector<LayoutInfo>::const_iterator it = fDylibs.begin(); it != fDylibs.end(); ++it) {
-		optimizers.push_back(new LinkEditOptimizer<A>(*it->layout, *this, newLinkEdit, stringPool));
+		optimizers.push_back(new LinkEditOptimizer<A>(*it->layout, *this, newLinkEdit));
 	}
+	const uint32_t dylibCount = optimizers.size();
+	const unsigned int threadCount = workerThreadCount();
+	typename LinkEditOptimizer<A>::MergeWork work;
+	bzero(&work, sizeof(work));
+	work.optimizers = &optimizers;
+	work.dontMapLocalSymbols = dontMapLocalSymbols;
+	work.keepSignatures = keepSignatures;
+	
+	// build each dylib's new symbol table
+	uint64_t parallelTime = mach_absolute_time();
+	parallelForEach(dylibCount, threadCount, &LinkEditOptimizer<A>::gatherSymbols, &work);
+	parallelTime = mach_absolute_time() - parallelTime;
+	
+	// add symbol names to string pools in dylib order
+	uint64_t serialTime = mach_absolute_time();
+	for(typename std::vector<LinkEditOptimizer<A>*>::iterator it = optimizers.begin(); it != optimizers.end(); ++it) {
+		(*it)->assignStringPoolOffsets(stringPool, fUnmappedLocalsStringPool);
+	}
+	// store names that are the tail of another name inside that name
+	uint32_t unsharedStringPoolSize = stringPool.size() + fUnmappedLocalsStringPool.size();
+	fStringPoolSuffixBytesSaved = stringPool.shareSuffixes() + fUnmappedLocalsStringPool.shareSuffixes();
+	if ( verbose )
+		fprintf(stderr, "update_dyld_shared_cache: for %s, sharing string suffixes saved %uKB of %uKB\n", 
+				archName(), fStringPoolSuffixBytesSaved/1024, unsharedStringPoolSize/1024);
 
 	// rebase info is not copied because images in shared cache are never rebased
 	
-	// copy weak bind info
+	// weak bind info
 	uint32_t offset = 0;
 	fOffsetOfWeakBindInfoInCombinedLinkedit = offset;
 	for(typename std::vector<LinkEditOptimizer<A>*>::iterator it = optimizers.begin(); it != optimizers.end(); ++it) {
-		(*it)->copyWeakBindInfo(offset);
+		(*it)->assignWeakBindInfoOffset(offset);
 	}
 	
-	// copy export info
+	// export info
 	fOffsetOfExportInfoInCombinedLinkedit = offset;
 	for(typename std::vector<LinkEditOptimizer<A>*>::iterator it = optimizers.begin(); it != optimizers.end(); ++it) {
-		(*it)->copyExportInfo(offset);
+		(*it)->assignExportInfoOffset(offset);
 	}
 
-	// copy bind info
+	// bind info
 	fOffsetOfBindInfoInCombinedLinkedit = offset;
 	for(typename std::vector<LinkEditOptimizer<A>*>::iterator it = optimizers.begin(); it != optimizers.end(); ++it) {
-		(*it)->copyBindInfo(offset);
+		(*it)->assignBindInfoOffset(offset);
 	}
 	
-	// copy lazy bind info
+	// lazy bind info
 	fOffsetOfLazyBindInfoInCombinedLinkedit = offset;
 	for(typename std::vector<LinkEditOptimizer<A>*>::iterator it = optimizers.begin(); it != optimizers.end(); ++it) {
-		(*it)->copyLazyBindInfo(offset);
+		(*it)->assignLazyBindInfoOffset(offset);
 	}
 
-	// copy symbol table entries
+	// symbol table entries
 	fOffsetOfOldSymbolTableInfoInCombinedLinkedit = offset;
 	uint32_t symbolTableOffset = offset;
 	uint32_t symbolTableIndex = 0;
-	if ( dontMapLocalSymbols ) 
-		fUnmappedLocalSymbols.reserve(16384);
+	uint32_t unmappedLocalsIndex = 0;
 	for(typename std::vector<LinkEditOptimizer<A>*>::iterator it = optimizers.begin(); it != optimizers.end(); ++it) {
-		(*it)->copyLocalSymbols(symbolTableOffset, symbolTableIndex, dontMapLocalSymbols, fInMemoryCache,
-								fUnmappedLocalsStringPool, fUnmappedLocalSymbols, fLocalSymbolInfos);
-		(*it)->copyExportedSymbols(symbolTableOffset, symbolTableIndex);
-		(*it)->copyImportedSymbols(symbolTableOffset, symbolTableIndex);
+		(*it)->assignSymbolTableOffset(symbolTableOffset, symbolTableIndex);
+		(*it)->assignUnmappedLocalSymbols(unmappedLocalsIndex, fInMemoryCache, fLocalSymbolInfos);
 	}
+	fUnmappedLocalSymbols.resize(unmappedLocalsIndex);
 	fSizeOfOldSymbolTableInfoInCombinedLinkedit =  symbolTableIndex * sizeof(macho_nlist<typename A::P>);
 	offset = symbolTableOffset + fSizeOfOldSymbolTableInfoInCombinedLinkedit & (-8);
 	
-	// copy external relocations, 8-byte aligned after end of symbol table
+	// external relocations, 8-byte aligned after end of symbol table
 	fOffsetOfOldExternalRelocationsInCombinedLinkedit = offset;
 	for(typename std::vector<LinkEditOptimizer<A>*>::iterator it = optimizers.begin(); it != optimizers.end(); ++it) {
-		(*it)->copyExternalRelocations(offset);
+		(*it)->assignExternalRelocationsOffset(offset);
 	}
 	fSizeOfOldExternalRelocationsInCombinedLinkedit = offset - fOffsetOfOldExternalRelocationsInCombinedLinkedit;
 	
-	// copy function starts
+	// function starts
 	fOffsetOfFunctionStartsInCombinedLinkedit = offset;
 	for(typename std::vector<LinkEditOptimizer<A>*>::iterator it = optimizers.begin(); it != optimizers.end(); ++it) {
-		(*it)->copyFunctionStarts(offset);
+		(*it)->assignFunctionStartsOffset(offset);
 	}
 	fSizeOfFunctionStartsInCombinedLinkedit = offset - fOffsetOfFunctionStartsInCombinedLinkedit;
 
-	// copy data-in-code info
+	// data-in-code info
 	fOffsetOfDataInCodeInCombinedLinkedit = offset;
 	for(typename std::vector<LinkEditOptimizer<A>*>::iterator it = optimizers.begin(); it != optimizers.end(); ++it) {
-		(*it)->copyDataInCode(offset);
+		(*it)->assignDataInCodeOffset(offset);
 	}
 	fSizeOfDataInCodeInCombinedLinkedit = offset - fOffsetOfDataInCodeInCombinedLinkedit;
 
-	// copy indirect symbol tables
+	// indirect symbol tables
 	fOffsetOfOldIndirectSymbolsInCombinedLinkedit = offset;
 	for(typename std::vector<LinkEditOptimizer<A>*>::iterator it = optimizers.begin(); it != optimizers.end(); ++it) {
-		(*it)->copyIndirectSymbolTable(offset);
+		(*it)->assignIndirectSymbolTableOffset(offset);
 	}
 	fSizeOfOldIndirectSymbolsInCombinedLinkedit = offset - fOffsetOfOldIndirectSymbolsInCombinedLinkedit;
 		
-	// copy string pool
+	// string pool
 	fOffsetOfOldStringPoolInCombinedLinkedit = offset;
-	memcpy(&newLinkEdit[offset], stringPool.getBuffer(), stringPool.size());
 	fSizeOfOldStringPoolInCombinedLinkedit = stringPool.size();
 	
 	// total new size round up to page size
@@ -2188,10 +3183,35 @@ uint8_t* SharedCache<A>::optimizeLINKEDIT(bool keepSignatures, bool dontMapLocal
 	// choose new linkedit file offset 
 	uint32_t linkEditsFileOffset = cacheFileOffsetForVMAddress(fLinkEditsStartAddress);
 //	uint32_t linkEditsFileOffset = fLinkEditsStartAddress - sharedRegionStartAddress();	
-
-	// update load commands so that all dylibs shared different areas of the same LINKEDIT segment
+	serialTime = mach_absolute_time() - serialTime;
+
+	// copy each dylib's pieces into place, and update load commands so that all dylibs share
+	// different areas of the same LINKEDIT segment
+	work.unmappedSymbols = fUnmappedLocalSymbols.empty() ? NULL : &fUnmappedLocalSymbols[0];
+	work.stringPool = &stringPool;
+	work.unmappedLocalsStringPool = &fUnmappedLocalsStringPool;
+	work.newVMAddress = fLinkEditsStartAddress;
+	work.linkEditSize = fLinkEditsTotalOptimizedSize;
+	work.stringPoolOffset = fOffsetOfOldStringPoolInCombinedLinkedit;
+	work.stringPoolSize = stringPool.size();
+	work.linkEditsFileOffset = linkEditsFileOffset;
+	uint64_t copyTime = mach_absolute_time();
+	parallelForEach(dylibCount, threadCount, &LinkEditOptimizer<A>::copySymbolsAndInfo, &work);
+	parallelForEach(dylibCount, threadCount, &LinkEditOptimizer<A>::copyTablesAndLoadCommands, &work);
+	memcpy(&newLinkEdit[fOffsetOfOldStringPoolInCombinedLinkedit], stringPool.getBuffer(), stringPool.size());
+	parallelTime += mach_absolute_time() - copyTime;
+	
+	uint64_t dylibsWorkTime = 0;
 	for(typename std::vector<LinkEditOptimizer<A>*>::iterator it = optimizers.begin(); it != optimizers.end(); ++it) {
-		(*it)->updateLoadCommands(fLinkEditsStartAddress, fLinkEditsTotalOptimizedSize, fOffsetOfOldStringPoolInCombinedLinkedit, linkEditsFileOffset, keepSignatures);
+		if ( (*it)->error() != NULL ) 
+			throwf("%s in %s", (*it)->error(), fDylibs[it - optimizers.begin()].layout->getID().name);
+		dylibsWorkTime += (*it)->workTime();
+	}
+	if ( progress ) {
+		// per dylib work summed is what one thread would have taken
+		fprintf(stderr, "update_dyld_shared_cache: for %s, merged %u LINKEDITs in %.1fms on %u threads, %.1fms serial, %.1fx speedup\n", 
+				archName(), dylibCount, absoluteTimeToMilliseconds(parallelTime+serialTime), threadCount,
+				absoluteTimeToMilliseconds(dylibsWorkTime+serialTime), (double)(dylibsWorkTime+serialTime)/(double)(parallelTime+serialTime));
 	}
 
 	//fprintf(stderr, "fLinkEditsTotalUnoptimizedSize=%llu, fLinkEditsTotalOptimizedSize=%u\n", fLinkEditsTotalUnoptimizedSize, fLinkEditsTotalOptimizedSize);
@@ -2907,6 +3927,207 @@ template <>	 bool	SharedCache<x86>::addCacheSlideInfo()	{ return false; }
 template <>	 bool	SharedCache<arm64>::addCacheSlideInfo()	{ return true; }
 
 
+template <typename A>
+void SharedCache<A>::setSegmentMappedAddresses(uint8_t* cache)
+{
+	for(typename std::vector<LayoutInfo>::const_iterator it = fDylibs.begin(); it != fDylibs.end(); ++it) {
+		std::vector<MachOLayoutAbstraction::Segment>& segs = ((MachOLayoutAbstraction*)(it->layout))->getSegments();
+		for (int i=0; i < segs.size(); ++i) {
+			MachOLayoutAbstraction::Segment& seg = segs[i];
+			if ( seg.size() > 0 )
+				seg.setMappedAddress(cache + cacheFileOffsetForVMAddress(seg.newAddress()));
+			//fprintf(stderr, "%s at %p to %p for %s\n", seg.name(), seg.mappedAddress(), (char*)seg.mappedAddress()+ seg.size(), it->layout->getID().name);
+		}
+	}
+}
+
+
+template <typename A>
+void SharedCache<A>::rebaseDylib(void* context, uint32_t index)
+{
+	FixupsWork* work = (FixupsWork*)context;
+	DylibFixups& fixups = (*work->fixups)[index];
+	if ( fixups.reused )
+		return;
+	try {
+		Rebaser<A> r(*work->cache->fDylibs[index].layout);
+		fixups.rebased = r.rebase(fixups.rebasedPointers);
+	}
+	catch (const char* msg) {
+		fixups.error = msg;
+	}
+}
+
+template <typename A>
+void SharedCache<A>::bindDylib(void* context, uint32_t index)
+{
+	FixupsWork* work = (FixupsWork*)context;
+	DylibFixups& fixups = (*work->fixups)[index];
+	if ( fixups.reused )
+		return;
+	try {
+		(*work->binders)[index]->bind(fixups.boundPointers);
+	}
+	catch (const char* msg) {
+		fixups.error = msg;
+	}
+}
+
+//
+// Rebases and binds every dylib, in parallel on threadCount threads.  Each dylib records its
+// pointers in its own DylibFixups, and results are merged in fDylibs order afterwards, so
+// the cache contents, messages, and pointersInData are the same for any thread count.
+// With -incremental, dylibs reused from the previous build are neither rebased nor bound,
+// and what this build found is recorded in fIncrementalDylibs for the next one.
+//
+template <typename A>
+void SharedCache<A>::rebaseAndBind(uint8_t* cache, unsigned int threadCount, std::vector<Binder<A>*>& binders, std::vector<void*>& pointersInData, 
+									bool& canEmitDevelopmentCache)
+{
+	const uint32_t dylibCount = fDylibs.size();
+	std::vector<DylibFixups> fixups(dylibCount);
+	for (uint32_t i=0; i < dylibCount; ++i) {
+		fixups[i].error = NULL;
+		fixups[i].rebased = false;
+		fixups[i].reused = this->reusedDylib(i);
+		if ( fixups[i].reused ) {
+			// contents were copied already rebased and bound, so restore what rebasing and binding found
+			const IncrementalDylib& previous = fIncrementalDylibs[i];
+			fixups[i].rebased = previous.rebased;
+			for (uint32_t offset : previous.rebasedPointers)
+				fixups[i].rebasedPointers.push_back(&cache[offset]);
+			for (uint32_t offset : previous.boundPointers)
+				fixups[i].boundPointers.push_back(&cache[offset]);
+			if ( previous.exportsOffset != 0 )
+				fDylibs[i].layout->setDyldInfoExports(&cache[previous.exportsOffset]);
+			else if ( !previous.sideExportTrie.empty() )
+				fDylibs[i].layout->setDyldInfoExports(&previous.sideExportTrie[0]);
+		}
+	}
+	FixupsWork work = { this, &binders, &fixups };
+	
+	// rebase each dylib in shared cache
+	parallelForEach(dylibCount, threadCount, &rebaseDylib, &work);
+	for (uint32_t i=0; i < dylibCount; ++i) {
+		if ( fixups[i].error != NULL )
+			throwf("%s in %s", fixups[i].error, fDylibs[i].layout->getID().name);
+		if ( !fixups[i].rebased ) {
+			canEmitDevelopmentCache = false;
+			fprintf(stderr, "update_dyld_shared_cache: Omitting development cache for %s, cannot rebase dylib into place for %s\n", archName(), fDylibs[i].layout->getID().name);
+		}
+	}
+	
+	if ( verbose )
+		fprintf(stderr, "update_dyld_shared_cache: for %s, updating binding information for %lu files:\n", archName(), fDylibs.size());
+	// instantiate a Binder for each image and add to map
+	typename Binder<A>::Map map;
+	for(typename std::vector<LayoutInfo>::const_iterator it = fDylibs.begin(); it != fDylibs.end(); ++it) {
+		Binder<A>* binder = new Binder<A>(*it->layout);
+		binders.push_back(binder);
+		// only add dylibs to map
+		if ( it->layout->getID().name != NULL )
+			map[it->layout->getID().name] = binder;
+	}
+	// tell each Binder about the others
+	for(typename std::vector<Binder<A>*>::iterator it = binders.begin(); it != binders.end(); ++it) {
+		(*it)->setDependentBinders(map);
+	}
+	// resolve re-exports up front, so symbol lookups while binding don't modify any Binder
+	for(typename std::vector<Binder<A>*>::iterator it = binders.begin(); it != binders.end(); ++it) {
+		try {
+			(*it)->resolveReExportedSymbols();
+		}
+		catch (const char* msg) {
+			throwf("%s in %s", msg, (*it)->getDylibID());
+		}
+	}
+	// perform binding
+	const bool recordIncremental = incremental && !fVerify;
+	std::vector<IncrementalDylib> nextIncrementalDylibs(recordIncremental ? dylibCount : 0);
+	std::map<const Binder<A>*, uint32_t> binderIndexes;
+	for (uint32_t i=0; i < dylibCount; ++i) 
+		binderIndexes[binders[i]] = i;
+	parallelForEach(dylibCount, threadCount, &bindDylib, &work);
+	for (uint32_t i=0; i < dylibCount; ++i) {
+		if ( fixups[i].reused ) {
+			for (const IncrementalResolverClient& client : fIncrementalDylibs[i].resolverClients)
+				binders[client.resolverIndex]->addResolverClient(binders[i], client.symbolName);
+			continue;
+		}
+		if ( verbose )
+			fprintf(stderr, "update_dyld_shared_cache: for %s, updating binding information in cache for %s\n", archName(), binders[i]->getDylibID());
+		if ( fixups[i].error != NULL )
+			throwf("%s in %s", fixups[i].error, binders[i]->getDylibID());
+		if ( recordIncremental ) {
+			for (const typename Binder<A>::ResolverClient& client : binders[i]->pendingResolverClients()) {
+				IncrementalResolverClient entry = { binderIndexes[client.resolverDylib], client.symbolName };
+				nextIncrementalDylibs[i].resolverClients.push_back(entry);
+			}
+		}
+		binders[i]->recordResolverClients();
+	}
+	
+	// all rebased pointers then all bound pointers, each in dylib order
+	size_t pointerCount = 0;
+	for (uint32_t i=0; i < dylibCount; ++i) 
+		pointerCount += fixups[i].rebasedPointers.size() + fixups[i].boundPointers.size();
+	pointersInData.reserve(pointerCount);
+	for (uint32_t i=0; i < dylibCount; ++i) 
+		pointersInData.insert(pointersInData.end(), fixups[i].rebasedPointers.begin(), fixups[i].rebasedPointers.end());
+	for (uint32_t i=0; i < dylibCount; ++i) 
+		pointersInData.insert(pointersInData.end(), fixups[i].boundPointers.begin(), fixups[i].boundPointers.end());
+
+	if ( recordIncremental ) {
+		const uint64_t cacheSize = fMappings.back().sfm_file_offset + fMappings.back().sfm_size;
+		for (uint32_t i=0; i < dylibCount; ++i) {
+			IncrementalDylib& state = nextIncrementalDylibs[i];
+			if ( fixups[i].reused ) {
+				std::swap(state, fIncrementalDylibs[i]);
+				continue;
+			}
+			const MachOLayoutAbstraction* layout = fDylibs[i].layout;
+			state.installName = layout->getID().name;
+			state.inode = layout->getInode();
+			state.modTime = layout->getLastModTime();
+			state.address = fDylibs[i].info.address;
+			state.rebased = fixups[i].rebased;
+			state.reused = false;
+			for (void* p : fixups[i].rebasedPointers)
+				state.rebasedPointers.push_back((uint8_t*)p - cache);
+			for (void* p : fixups[i].boundPointers)
+				state.boundPointers.push_back((uint8_t*)p - cache);
+			// export trie was either rewritten in place in LINKEDIT, or moved to a side buffer
+			state.exportsOffset = 0;
+			const uint8_t* exports = layout->getDyldInfoExports();
+			if ( (exports >= cache) && (exports < &cache[cacheSize]) ) {
+				state.exportsOffset = exports - cache;
+			}
+			else {
+				const macho_header<P>* mh = (const macho_header<P>*)layout->getSegments()[0].mappedAddress();
+				const macho_load_command<P>* cmd = (macho_load_command<P>*)((uint8_t*)mh + sizeof(macho_header<P>));
+				for (uint32_t c = 0; c < mh->ncmds(); ++c) {
+					if ( (cmd->cmd() == LC_DYLD_INFO) || (cmd->cmd() == LC_DYLD_INFO_ONLY) ) {
+						const macho_dyld_info_command<P>* dyldInfo = (macho_dyld_info_command<P>*)cmd;
+						if ( (dyldInfo->export_off() == 0) && (dyldInfo->export_size() != 0) )
+							state.sideExportTrie.assign(exports, exports+dyldInfo->export_size());
+					}
+					cmd = (const macho_load_command<P>*)(((uint8_t*)cmd)+cmd->cmdsize());
+				}
+			}
+			for (uint32_t d=0; d < binders[i]->dependentDylibCount(); ++d) {
+				bool reExport;
+				const Binder<A>* dep = binders[i]->dependentDylib(d, &reExport);
+				if ( dep != NULL ) {
+					IncrementalDependent entry = { binderIndexes[dep], reExport };
+					state.dependents.push_back(entry);
+				}
+			}
+		}
+		fIncrementalDylibs.swap(nextIncrementalDylibs);
+	}
+}
+
+
 template <typename A>
 bool SharedCache<A>::update(bool force, bool optimize, bool deleteExistingFirst, int archIndex,
 								int archCount, bool keepSignatures, bool dontMapLocalSymbols)
@@ -2917,6 +4138,11 @@ bool SharedCache<A>::update(bool force, bool optimize, bool deleteExistingFirst,
 	char fileListFilePath[strlen(fCacheFilePath)+strlen(".list")];
 	sprintf(devCacheFilePath, "%s.development", fCacheFilePath);
 	sprintf(fileListFilePath, "%s.list", fCacheFilePath);
+	char incrementalPath[strlen(fCacheFilePath)+strlen(".incremental")+1];
+	char incrementalTempPath[strlen(fCacheFilePath)+strlen(".incremental")+16];
+	sprintf(incrementalPath, "%s.incremental", fCacheFilePath);
+	sprintf(incrementalTempPath, "%s.tmp%u", incrementalPath, getpid());
+	bool savedIncrementalState = false;
 	std::vector<const char *> paths;
 	
 	// already up to date?
@@ -3000,13 +4226,58 @@ bool SharedCache<A>::update(bool force, bool optimize, bool deleteExistingFirst,
 				//fprintf(stderr, "adding alias to offset 0x%08X %s\n", it->info.pathFileOffset, it->aliases[0]);
 				++image;
 			}
+			
+			// fill in path hash table, indexes are in same order as image table
+			header->set_pathHashOffset(fPathHashOffset);
+			header->set_pathHashSize(0);
+			if ( fPathHashOffset != 0 ) {
+				dyldCachePathHashInfo<E>* hashInfo = (dyldCachePathHashInfo<E>*)&inMemoryCache[fPathHashOffset];
+				hashInfo->set_version(1);
+				hashInfo->set_bucketCount(fPathHashBucketCount);
+				dyldCachePathHashBucket<E>* buckets = (dyldCachePathHashBucket<E>*)&inMemoryCache[fPathHashOffset+sizeof(dyld_cache_path_hash_info)];
+				for (uint32_t i=0; i < fPathHashBucketCount; ++i) {
+					buckets[i].set_hash(0);
+					buckets[i].set_imageIndex(DYLD_CACHE_PATH_HASH_EMPTY);
+				}
+				uint32_t imageIndex = 0;
+				for(typename std::vector<LayoutInfo>::iterator it = fDylibs.begin(); it != fDylibs.end(); ++it)
+					addToPathHashTable(buckets, fPathHashBucketCount, it->layout->getID().name, imageIndex++);
+				for(typename std::vector<LayoutInfo>::iterator it = fDylibAliases.begin(); it != fDylibAliases.end(); ++it)
+					addToPathHashTable(buckets, fPathHashBucketCount, it->aliases[0], imageIndex++);
+				header->set_pathHashSize(sizeof(dyld_cache_path_hash_info) + fPathHashBucketCount*sizeof(dyld_cache_path_hash_bucket));
+				if ( verbose )
+					fprintf(stderr, "update_dyld_shared_cache: path hash table of %u buckets for %u images\n", fPathHashBucketCount, imageIndex);
+			}
 						
 			// copy each segment to cache buffer
 			const int dylibCount = fDylibs.size();
 			int dylibIndex = 0;
 			int progressIndex = 0;
 			bool foundLibSystem = false;
+			int incrementalFD = -1;
+			if ( fIncrementalReusedCount != 0 ) {
+				incrementalFD = ::open(incrementalPath, O_RDONLY, 0);
+				if ( incrementalFD == -1 )
+					throwf("can't open incremental state file %s, errno=%d", incrementalPath, errno);
+				(void)fcntl(incrementalFD, F_NOCACHE, 1);
+			}
 			for(typename std::vector<LayoutInfo>::const_iterator it = fDylibs.begin(); it != fDylibs.end(); ++it, ++dylibIndex) {
+				if ( this->reusedDylib(dylibIndex) ) {
+					// -incremental: copy this dylib already rebased and bound from the previous build
+					if ( strcmp(it->layout->getID().name, "/usr/lib/libSystem.B.dylib") == 0 )
+						foundLibSystem = true;
+					if ( verbose )
+						fprintf(stderr, "update_dyld_shared_cache: copying %s to cache from previous build\n", it->layout->getFilePath());
+					for (const MachOLayoutAbstraction::Segment& seg : it->layout->getSegments()) {
+						if ( seg.size() > 0 ) {
+							const uint64_t segmentOffset = cacheFileOffsetForVMAddress(seg.newAddress());
+							if ( ::pread(incrementalFD, &inMemoryCache[segmentOffset], seg.size(), fIncrementalImageOffset+segmentOffset) != (ssize_t)seg.size() ) 
+								throwf("read failure copying %s from incremental state file, errno=%d", it->layout->getID().name, errno);
+						}
+					}
+					paths.push_back(it->layout->getID().name);
+					continue;
+				}
 				const char* path = it->layout->getFilePath();
 				int src = ::open(path, O_RDONLY, 0);
 				if ( src == -1 )
@@ -3061,66 +4332,65 @@ bool SharedCache<A>::update(bool force, bool optimize, bool deleteExistingFirst,
 					progressIndex = nextProgressIndex;
 				}
 			}
+			if ( incrementalFD != -1 )
+				::close(incrementalFD);
 			if ( !foundLibSystem )
 				throw "cache would be missing required dylib /usr/lib/libSystem.B.dylib";
 
-			// set mapped address for each segment
-			for(typename std::vector<LayoutInfo>::const_iterator it = fDylibs.begin(); it != fDylibs.end(); ++it) {
-				std::vector<MachOLayoutAbstraction::Segment>& segs = ((MachOLayoutAbstraction*)(it->layout))->getSegments();
-				for (int i=0; i < segs.size(); ++i) {
-					MachOLayoutAbstraction::Segment& seg = segs[i];
-					if ( seg.size() > 0 )
-						seg.setMappedAddress(inMemoryCache + cacheFileOffsetForVMAddress(seg.newAddress()));
-					//fprintf(stderr, "%s at %p to %p for %s\n", seg.name(), seg.mappedAddress(), (char*)seg.mappedAddress()+ seg.size(), it->layout->getID().name);
-				}
-			}
-	
 			// also construct list of all pointers in cache to other things in cache
 			std::vector<void*> pointersInData;
-			pointersInData.reserve(1024);
-			
-			// rebase each dylib in shared cache
-			for(typename std::vector<LayoutInfo>::const_iterator it = fDylibs.begin(); it != fDylibs.end(); ++it) {
-				try {
-					Rebaser<A> r(*it->layout);
-					if (!r.rebase(pointersInData)) {
-						canEmitDevelopmentCache = false;
-						fprintf(stderr, "update_dyld_shared_cache: Omitting development cache for %s, cannot rebase dylib into place for %s\n", archName(), it->layout->getID().name);
-					}
-					//if ( verbose )
-					//	fprintf(stderr, "update_dyld_shared_cache: for %s, rebasing dylib into cache for %s\n", archName(), it->layout->getID().name);
+			std::vector<Binder<A>*> binders;
+			if ( verifyDeterministic ) {
+				// rebase and bind a copy of the cache on one thread, then check the multi-threaded result matches it
+				uint8_t* serialCache = NULL;
+				if ( vm_allocate(mach_task_self(), (vm_address_t*)(&serialCache), cacheFileSize, VM_FLAGS_ANYWHERE) != KERN_SUCCESS )
+					throwf("can't vm_allocate cache of size %u", cacheFileSize);
+				memcpy(serialCache, inMemoryCache, cacheFileSize);
+				// rebasing repoints each layout's export trie, so put them back before the real pass
+				std::vector<const uint8_t*> originalExports;
+				for(typename std::vector<LayoutInfo>::const_iterator it = fDylibs.begin(); it != fDylibs.end(); ++it) 
+					originalExports.push_back(it->layout->getDyldInfoExports());
+				std::vector<void*> serialPointersInData;
+				std::vector<Binder<A>*> serialBinders;
+				bool serialCanEmitDevelopmentCache = canEmitDevelopmentCache;
+				this->setSegmentMappedAddresses(serialCache);
+				this->rebaseAndBind(serialCache, 1, serialBinders, serialPointersInData, serialCanEmitDevelopmentCache);
+				for(typename std::vector<Binder<A>*>::iterator it = serialBinders.begin(); it != serialBinders.end(); ++it) 
+					delete *it;
+				for (size_t i=0; i < fDylibs.size(); ++i) 
+					fDylibs[i].layout->setDyldInfoExports(originalExports[i]);
+				
+				this->setSegmentMappedAddresses(inMemoryCache);
+				this->rebaseAndBind(inMemoryCache, workerThreadCount(), binders, pointersInData, canEmitDevelopmentCache);
+				
+				if ( memcmp(inMemoryCache, serialCache, cacheFileSize) != 0 ) {
+					uint32_t offset = 0;
+					while ( inMemoryCache[offset] == serialCache[offset] )
+						++offset;
+					throwf("-verify-deterministic: multi-threaded rebase/bind differs from single threaded at cache offset 0x%08X", offset);
 				}
-				catch (const char* msg) {
-					throwf("%s in %s", msg, it->layout->getID().name);
+				if ( pointersInData.size() != serialPointersInData.size() ) 
+					throwf("-verify-deterministic: multi-threaded rebase/bind found %lu pointers, single threaded found %lu", pointersInData.size(), serialPointersInData.size());
+				for (size_t i=0; i < pointersInData.size(); ++i) {
+					if ( ((uint8_t*)pointersInData[i] - inMemoryCache) != ((uint8_t*)serialPointersInData[i] - serialCache) ) 
+						throwf("-verify-deterministic: multi-threaded rebase/bind pointer #%lu differs from single threaded", i);
 				}
+				vm_deallocate(mach_task_self(), (vm_address_t)serialCache, cacheFileSize);
+				if ( verbose )
+					fprintf(stderr, "update_dyld_shared_cache: for %s, multi-threaded rebase/bind matches single threaded\n", archName());
 			}
-			
-			if ( verbose )
-				fprintf(stderr, "update_dyld_shared_cache: for %s, updating binding information for %lu files:\n", archName(), fDylibs.size());
-			// instantiate a Binder for each image and add to map
-			typename Binder<A>::Map map;
-			std::vector<Binder<A>*> binders;
-			for(typename std::vector<LayoutInfo>::const_iterator it = fDylibs.begin(); it != fDylibs.end(); ++it) {
-				//fprintf(stderr, "binding %s\n", it->layout->getID().name);
-				Binder<A>* binder = new Binder<A>(*it->layout);
-				binders.push_back(binder);
-				// only add dylibs to map
-				if ( it->layout->getID().name != NULL )
-					map[it->layout->getID().name] = binder;
-			}
-			// tell each Binder about the others
-			for(typename std::vector<Binder<A>*>::iterator it = binders.begin(); it != binders.end(); ++it) {
-				(*it)->setDependentBinders(map);
+			else {
+				this->setSegmentMappedAddresses(inMemoryCache);
+				this->rebaseAndBind(inMemoryCache, workerThreadCount(), binders, pointersInData, canEmitDevelopmentCache);
 			}
-			// perform binding
-			for(typename std::vector<Binder<A>*>::iterator it = binders.begin(); it != binders.end(); ++it) {
-				if ( verbose )
-					fprintf(stderr, "update_dyld_shared_cache: for %s, updating binding information in cache for %s\n", archName(), (*it)->getDylibID());
+			if ( incremental && !fVerify ) {
+				// snapshot cache before anything depends on more than one dylib, it is moved into place with the cache file
 				try {
-					(*it)->bind(pointersInData);
+					this->saveIncrementalState(incrementalTempPath, inMemoryCache, cacheFileSize);
+					savedIncrementalState = true;
 				}
 				catch (const char* msg) {
-					throwf("%s in %s", msg, (*it)->getDylibID());
+					fprintf(stderr, "update_dyld_shared_cache: warning, %s\n", msg);
 				}
 			}
 
@@ -3424,6 +4694,11 @@ bool SharedCache<A>::update(bool force, bool optimize, bool deleteExistingFirst,
 				((dyldCacheHeader<E>*)inMemoryCache)->set_cacheType(0);
 				writeCacheFile(fCacheFilePath, inMemoryCache, cacheFileSize, fCacheFileInFinalLocation);
 				didUpdate = true;
+				if ( savedIncrementalState ) {
+					if ( ::rename(incrementalTempPath, incrementalPath) != 0 )
+						fprintf(stderr, "update_dyld_shared_cache: warning, can't move incremental state into place: rename(%s,%s) returned errno=%d\n", incrementalTempPath, incrementalPath, errno);
+					savedIncrementalState = false;
+				}
 				// generate human readable "map" file that shows the layout of the cache file
 				if ( verbose )
 					fprintf(stderr, "update_dyld_shared_cache: writing .map file to disk\n");
@@ -3495,6 +4770,8 @@ bool SharedCache<A>::update(bool force, bool optimize, bool deleteExistingFirst,
 								(fSizeOfOldStringPoolInCombinedLinkedit)/(1024*1024),
 								fLinkEditsStartAddress+fOffsetOfOldStringPoolInCombinedLinkedit,
 								fLinkEditsStartAddress+fOffsetOfOldStringPoolInCombinedLinkedit+fSizeOfOldStringPoolInCombinedLinkedit);				
+					if ( fStringPoolSuffixBytesSaved != 0 )
+						fprintf(fmap, " linkedit   %4uKB saved by sharing string suffixes\n", fStringPoolSuffixBytesSaved/1024);
 					
 					dyldCacheHeader<E>* cacheHeader = (dyldCacheHeader<E>*)inMemoryCache;
 					if ( cacheHeader->slideInfoSize() != 0 ) {
@@ -3502,6 +4779,9 @@ bool SharedCache<A>::update(bool force, bool optimize, bool deleteExistingFirst,
 					}
 
 					fprintf(fmap, "unmapped -- %4uMB local symbol info\n", fUnmappedLocalSymbolsSize/(1024*1024));					
+					if ( fLaunchProfilePages != 0 )
+						fprintf(fmap, "launch     %5u pages touched (%u writable), %u pages (%u writable) without profile ordering\n", 
+									fLaunchProfilePages, fLaunchProfileWritablePages, fLaunchProfileUnorderedPages, fLaunchProfileUnorderedWritablePages);
 					
 					uint64_t endMappingAddr = fMappings[2].sfm_address + fMappings[2].sfm_size;
 					fprintf(fmap, "total map   %4lluMB\n", (endMappingAddr - sharedRegionStartAddress())/(1024*1024));	
@@ -3548,6 +4828,8 @@ bool SharedCache<A>::update(bool force, bool optimize, bool deleteExistingFirst,
 			// remove in memory cache
 			if ( inMemoryCache != NULL ) 
 				vm_deallocate(mach_task_self(), (vm_address_t)inMemoryCache, allocatedCacheSize);
+			if ( savedIncrementalState )
+				::unlink(incrementalTempPath);
 			throw;
 		}
 	}
@@ -3624,6 +4906,42 @@ static void parsePathsFile(const char* filePath, std::vector<const char*>& paths
 }
 
 
+//
+//	A launch profile lists the places touched while launching processes, one per line as:
+//		<install name> <segment name> <offset in segment>
+//	Install names may contain spaces, so the last two fields are split off the end
+//	Blank lines and lines starting with # are ignored
+//
+static void parseLaunchProfile(const char* filePath)
+{
+	std::vector<const char*> lines;
+	parsePathsFile(filePath, lines);
+	for (std::vector<const char*>::iterator it=lines.begin(); it != lines.end(); ++it) {
+		char* line = (char*)*it;
+		char* offsetStart = &line[strlen(line)];
+		while ( (offsetStart > line) && !isspace(offsetStart[-1]) )
+			--offsetStart;
+		char* segmentEnd = offsetStart;
+		while ( (segmentEnd > line) && isspace(segmentEnd[-1]) )
+			--segmentEnd;
+		char* segmentStart = segmentEnd;
+		while ( (segmentStart > line) && !isspace(segmentStart[-1]) )
+			--segmentStart;
+		char* nameEnd = segmentStart;
+		while ( (nameEnd > line) && isspace(nameEnd[-1]) )
+			--nameEnd;
+		char* offsetEnd;
+		uint64_t offset = strtoull(offsetStart, &offsetEnd, 0);
+		if ( (nameEnd == line) || (segmentStart == segmentEnd) || (offsetEnd == offsetStart) || (*offsetEnd != '\0') )
+			throwf("malformed line in launch profile %s: %s", filePath, line);
+		*segmentEnd = '\0';
+		*nameEnd = '\0';
+		LaunchProfileTouch touch = { line, segmentStart, offset };
+		launchProfile.push_back(touch);
+	}
+}
+
+
 
 static void setSharedDylibs(const char* rootPath, const std::vector<const char*>& overlayPaths, const std::set<ArchPair>& onlyArchs, std::vector<const char*> rootsPaths)
 {
@@ -3840,6 +5158,18 @@ int main(int argc, const char* argv[])
 				else if ( strcmp(arg, "-verify") == 0 ) {
 					verify = true;
 				}
+				else if ( strcmp(arg, "-verify-deterministic") == 0 ) {
+					verifyDeterministic = true;
+				}
+				else if ( strcmp(arg, "-incremental") == 0 ) {
+					incremental = true;
+				}
+				else if ( strcmp(arg, "-launch_profile") == 0 ) {
+					const char* path = argv[++i];
+					if ( path == NULL )
+						throw "-launch_profile missing path argument";
+					parseLaunchProfile(path);
+				}
 				else if ( strcmp(arg, "-sort_by_name") == 0 ) {
 					alphaSort = true;
 				}
@@ -36,6 +36,8 @@
 #include <sys/mount.h>
 #include <libkern/OSAtomic.h>
 
+#include <algorithm>
+
 #include "ImageLoader.h"
 
 
@@ -47,11 +49,19 @@ uint32_t								ImageLoader::fgTotalRebaseFixups = 0;
 uint32_t								ImageLoader::fgTotalBindFixups = 0;
 uint32_t								ImageLoader::fgTotalBindSymbolsResolved = 0;
 uint32_t								ImageLoader::fgTotalBindImageSearches = 0;
+uint32_t								ImageLoader::fgTotalBindCacheLookups = 0;
+uint32_t								ImageLoader::fgTotalBindCacheHits = 0;
+uint32_t								ImageLoader::fgTotalLaunchClosureFixups = 0;
+uint32_t								ImageLoader::fgImagesBoundFromLaunchClosure = 0;
 uint32_t								ImageLoader::fgTotalLazyBindFixups = 0;
 uint32_t								ImageLoader::fgTotalPossibleLazyBindFixups = 0;
 uint32_t								ImageLoader::fgTotalSegmentsMapped = 0;
 uint64_t								ImageLoader::fgTotalBytesMapped = 0;
 uint64_t								ImageLoader::fgTotalBytesPreFetched = 0;
+uint32_t								ImageLoader::fgTotalPreFetchRequests = 0;
+uint64_t								ImageLoader::fgImageArenaBytes = 0;
+bool									ImageLoader::fgImageArenaEnabled = false;
+uint32_t								ImageLoader::fgHiddenExportsGeneration = 0;
 uint64_t								ImageLoader::fgTotalLoadLibrariesTime;
 uint64_t								ImageLoader::fgTotalRebaseTime;
 uint64_t								ImageLoader::fgTotalBindTime;
@@ -88,12 +98,81 @@ void ImageLoader::deleteImage(ImageLoader* image)
 }
 
 
+//
+// Images loaded at launch are never unloaded, so they are allocated in load order from an
+// arena instead of by malloc(), along with their trailing segment and library arrays and
+// their path strings.  Walking all images (e.g. flat lookups) then touches a few dense
+// pages.  Arena memory is never freed, so an image deleted because its load failed leaves
+// its (small) slot unused.
+//
+struct ImageArenaChunk
+{
+	ImageArenaChunk*	next;
+	uint8_t*			current;
+	uint8_t*			end;
+};
+
+enum { kImageArenaChunkSize = 128*1024 };
+
+static ImageArenaChunk* sImageArenaChunks = NULL;
+
+void* ImageLoader::allocateInArena(size_t size)
+{
+	if ( !fgImageArenaEnabled )
+		return NULL;
+	size = (size + 15) & (-16);
+	ImageArenaChunk* chunk = sImageArenaChunks;
+	if ( (chunk == NULL) || ((chunk->current + size) > chunk->end) ) {
+		const size_t headerSize = (sizeof(ImageArenaChunk) + 15) & (-16);
+		if ( (headerSize + size) > kImageArenaChunkSize )
+			return NULL;
+		vm_address_t addr = 0;
+		if ( vm_alloc(&addr, kImageArenaChunkSize, VM_FLAGS_ANYWHERE) != KERN_SUCCESS )
+			return NULL;
+		chunk = (ImageArenaChunk*)addr;
+		chunk->current = (uint8_t*)(addr + headerSize);
+		chunk->end = (uint8_t*)(addr + kImageArenaChunkSize);
+		chunk->next = sImageArenaChunks;
+		sImageArenaChunks = chunk;
+	}
+	void* result = chunk->current;
+	chunk->current += size;
+	fgImageArenaBytes += size;
+	return result;
+}
+
+bool ImageLoader::inArena(const void* p)
+{
+	for (const ImageArenaChunk* chunk = sImageArenaChunks; chunk != NULL; chunk = chunk->next) {
+		if ( ((uint8_t*)chunk < p) && (p < chunk->end) )
+			return true;
+	}
+	return false;
+}
+
+static char* copyPathString(const char* path)
+{
+	const size_t len = strlen(path)+1;
+	char* result = (char*)ImageLoader::allocateInArena(len);
+	if ( result == NULL )
+		result = new char[len];
+	memcpy(result, path, len);
+	return result;
+}
+
+static void freePathString(const char* path)
+{
+	if ( !ImageLoader::inArena(path) )
+		delete [] path;
+}
+
+
 ImageLoader::~ImageLoader()
 {
 	if ( fRealPath != NULL ) 
-		delete [] fRealPath;
+		freePathString(fRealPath);
 	if ( fPathOwnedByImage && (fPath != NULL) ) 
-		delete [] fPath;
+		freePathString(fPath);
 }
 
 void ImageLoader::setFileInfo(dev_t device, ino_t inode, time_t modDate)
@@ -130,9 +209,8 @@ int ImageLoader::compare(const ImageLoader* right) const
 void ImageLoader::setPath(const char* path)
 {
 	if ( fPathOwnedByImage && (fPath != NULL) ) 
-		delete [] fPath;
-	fPath = new char[strlen(path)+1];
-	strcpy((char*)fPath, path);
+		freePathString(fPath);
+	fPath = copyPathString(path);
 	fPathOwnedByImage = true;  // delete fPath when this image is destructed
 	fPathHash = hash(fPath);
 	fRealPath = NULL;
@@ -141,7 +219,7 @@ void ImageLoader::setPath(const char* path)
 void ImageLoader::setPathUnowned(const char* path)
 {
 	if ( fPathOwnedByImage && (fPath != NULL) ) {
-		delete [] fPath;
+		freePathString(fPath);
 	}
 	fPath = path;
 	fPathOwnedByImage = false;  
@@ -151,8 +229,7 @@ void ImageLoader::setPathUnowned(const char* path)
 void ImageLoader::setPaths(const char* path, const char* realPath)
 {
 	this->setPath(path);
-	fRealPath = new char[strlen(realPath)+1];
-	strcpy((char*)fRealPath, realPath);
+	fRealPath = copyPathString(realPath);
 }
 
 const char* ImageLoader::getRealPath() const 
@@ -208,6 +285,8 @@ void ImageLoader::setLeaveMapped()
 
 void ImageLoader::setHideExports(bool hide)
 {
+	if ( fHideSymbols != hide )
+		++fgHiddenExportsGeneration;
 	fHideSymbols = hide;
 }
 
@@ -226,6 +305,14 @@ time_t ImageLoader::lastModified() const
 	return fLastModified;
 }
 
+void ImageLoader::findClosestSymbols(const void* const addrs[], unsigned int count, const char* names[], const void* closestAddrs[]) const
+{
+	for (unsigned int i=0; i < count; ++i) {
+		closestAddrs[i] = NULL;
+		names[i] = this->findClosestSymbol(addrs[i], &closestAddrs[i]);
+	}
+}
+
 bool ImageLoader::containsAddress(const void* addr) const
 {
 	for(unsigned int i=0, e=segmentCount(); i < e; ++i) {
@@ -412,12 +499,21 @@ void ImageLoader::link(const LinkContext& context, bool forceLazysBound, bool pr
 	context.notifyBatch(dyld_image_state_rebased);
 	
 	uint64_t t3 = mach_absolute_time();
- 	this->recursiveBind(context, forceLazysBound, neverUnload);
+	// one resolve cache for all images bound by this link, kept off the stack
+	ResolveCache* cache = newResolveCache();
+	try {
+		this->recursiveBind(context, forceLazysBound, neverUnload, cache);
+	}
+	catch (...) {
+		deleteResolveCache(cache);
+		throw;
+	}
+	deleteResolveCache(cache);
 
 	uint64_t t4 = mach_absolute_time();
+	// weakBind() records its own time in fgTotalWeakBindTime
 	if ( !context.linkingMainExecutable )
 		this->weakBind(context);
-	uint64_t t5 = mach_absolute_time();	
 
 	context.notifyBatch(dyld_image_state_bound);
 	uint64_t t6 = mach_absolute_time();	
@@ -438,7 +534,6 @@ void ImageLoader::link(const LinkContext& context, bool forceLazysBound, bool pr
 	fgTotalLoadLibrariesTime += t1 - t0;
 	fgTotalRebaseTime += t3 - t2;
 	fgTotalBindTime += t4 - t3;
-	fgTotalWeakBindTime += t5 - t4;
 	fgTotalDOF += t7 - t6;
 	
 	// done with initial dylib loads
@@ -499,6 +594,19 @@ void ImageLoader::runInitializers(const LinkContext& context, InitializerTimingL
 
 
 void ImageLoader::bindAllLazyPointers(const LinkContext& context, bool recursive)
+{
+	ResolveCache* cache = newResolveCache();
+	try {
+		this->recursiveBindAllLazyPointers(context, recursive, cache);
+	}
+	catch (...) {
+		deleteResolveCache(cache);
+		throw;
+	}
+	deleteResolveCache(cache);
+}
+
+void ImageLoader::recursiveBindAllLazyPointers(const LinkContext& context, bool recursive, ResolveCache* cache)
 {
 	if ( ! fAllLazyPointersBound ) {
 		fAllLazyPointersBound = true;
@@ -508,14 +616,26 @@ void ImageLoader::bindAllLazyPointers(const LinkContext& context, bool recursive
 			for(unsigned int i=0; i < libraryCount(); ++i) {
 				ImageLoader* dependentImage = libImage(i);
 				if ( dependentImage != NULL )
-					dependentImage->bindAllLazyPointers(context, recursive);
+					dependentImage->recursiveBindAllLazyPointers(context, recursive, cache);
 			}
 		}
 		// bind lazies in this image
-		this->doBindJustLazies(context);
+		this->doBindJustLazies(context, cache);
 	}
 }
 
+ImageLoader::ResolveCache* ImageLoader::newResolveCache()
+{
+	// calloc() so every entry starts unused
+	return (ResolveCache*)calloc(1, sizeof(ResolveCache));
+}
+
+void ImageLoader::deleteResolveCache(ResolveCache* cache)
+{
+	if ( cache != NULL )
+		free(cache);
+}
+
 
 bool ImageLoader::allDependentLibrariesAsWhenPreBound() const
 {
@@ -589,6 +709,13 @@ void ImageLoader::recursiveLoadLibraries(const LinkContext& context, bool prefli
 		this->getRPaths(context, rpathsFromThisImage);
 		const RPathChain thisRPaths(&loaderRPaths, &rpathsFromThisImage);
 		
+		// start the disk reads for all dependents before loading any, so their latencies overlap
+		// (dependents of an image in the shared cache are in the cache too, so have nothing to read)
+		if ( !preflightOnly && !context.preFetchDisabled && !this->inSharedCache() && (fLibraryCount > 1) ) {
+			for(unsigned int i=0; i < fLibraryCount; ++i)
+				context.prefetchLibrary(libraryInfos[i].name, this->getPath(), &thisRPaths);
+		}
+
 		// try to load each
 		bool canUsePrelinkingInfo = true; 
 		for(unsigned int i=0; i < fLibraryCount; ++i){
@@ -760,7 +887,7 @@ void ImageLoader::recursiveApplyInterposing(const LinkContext& context)
 
 
 
-void ImageLoader::recursiveBind(const LinkContext& context, bool forceLazysBound, bool neverUnload)
+void ImageLoader::recursiveBind(const LinkContext& context, bool forceLazysBound, bool neverUnload, ResolveCache* cache)
 {
 	// Normally just non-lazy pointers are bound immediately.
 	// The exceptions are:
@@ -775,10 +902,10 @@ void ImageLoader::recursiveBind(const LinkContext& context, bool forceLazysBound
 			for(unsigned int i=0; i < libraryCount(); ++i) {
 				ImageLoader* dependentImage = libImage(i);
 				if ( dependentImage != NULL )
-					dependentImage->recursiveBind(context, forceLazysBound, neverUnload);
+					dependentImage->recursiveBind(context, forceLazysBound, neverUnload, cache);
 			}
 			// bind this image
-			this->doBind(context, forceLazysBound);	
+			this->doBind(context, forceLazysBound, cache);	
 			// mark if lazys are also bound
 			if ( forceLazysBound || this->usablePrebinding(context) )
 				fAllLazyPointersBound = true;
@@ -797,6 +924,17 @@ void ImageLoader::recursiveBind(const LinkContext& context, bool forceLazysBound
 	}
 }
 
+// orders CoalIterators by symbol name then load order, for a min-heap of iterators
+struct CoalIteratorGreater
+{
+	bool operator()(const ImageLoader::CoalIterator* left, const ImageLoader::CoalIterator* right) const {
+		int result = strcmp(left->symbolName, right->symbolName);
+		if ( result != 0 )
+			return ( result > 0 );
+		return ( left->loadOrder > right->loadOrder );
+	}
+};
+
 void ImageLoader::weakBind(const LinkContext& context)
 {
 	if ( context.verboseWeakBind )
@@ -822,92 +960,100 @@ void ImageLoader::weakBind(const LinkContext& context)
 
 	// don't need to do any coalescing if only one image has overrides, or all have already been done
 	if ( (countOfImagesWithWeakDefinitionsNotInSharedCache > 0) && (countNotYetWeakBound > 0) ) {
-		// make symbol iterators for each
+		// make symbol iterators for each, and position each at its first symbol
 		ImageLoader::CoalIterator iterators[count];
-		ImageLoader::CoalIterator* sortedIts[count];
+		ImageLoader::CoalIterator* heap[count];
+		uint32_t nameHashes[count];
+		int heapCount = 0;
 		for(int i=0; i < count; ++i) {
 			imagesNeedingCoalescing[i]->initializeCoalIterator(iterators[i], i);
-			sortedIts[i] = &iterators[i];
 			if ( context.verboseWeakBind )
 				dyld::log("dyld: weak bind load order %d/%d for %s\n", i, count, imagesNeedingCoalescing[i]->getPath());
+			if ( ! imagesNeedingCoalescing[i]->incrementCoalIterator(iterators[i]) ) {
+				nameHashes[i] = hash(iterators[i].symbolName);
+				heap[heapCount++] = &iterators[i];
+			}
 		}
+		std::make_heap(&heap[0], &heap[heapCount], CoalIteratorGreater());
+		uint64_t t2 = mach_absolute_time();
 		
-		// walk all symbols keeping iterators in sync by 
-		// only ever incrementing the iterator with the lowest symbol 
-		int doneCount = 0;
-		while ( doneCount != count ) {
-			//for(int i=0; i < count; ++i)
-			//	dyld::log("sym[%d]=%s ", sortedIts[i]->loadOrder, sortedIts[i]->symbolName);
-			//dyld::log("\n");
-			// increment iterator with lowest symbol
-			if ( sortedIts[0]->image->incrementCoalIterator(*sortedIts[0]) )
-				++doneCount; 
-			// re-sort iterators
-			for(int i=1; i < count; ++i) {
-				int result = strcmp(sortedIts[i-1]->symbolName, sortedIts[i]->symbolName);
-				if ( result == 0 )
-					sortedIts[i-1]->symbolMatches = true;
-				if ( result > 0 ) {
-					// new one is bigger then next, so swap
-					ImageLoader::CoalIterator* temp = sortedIts[i-1];
-					sortedIts[i-1] = sortedIts[i];
-					sortedIts[i] = temp;
-				}
-				if ( result < 0 )
-					break;
+		// merge symbol streams with a min-heap, each time pulling off all
+		// iterators positioned at the lowest symbol (in load order)
+		ImageLoader::CoalIterator* matches[count];
+		uint32_t symbolsCoalesced = 0;
+		while ( heapCount != 0 ) {
+			std::pop_heap(&heap[0], &heap[heapCount], CoalIteratorGreater());
+			ImageLoader::CoalIterator* lowest = heap[--heapCount];
+			const char* nameToCoalesce = lowest->symbolName;
+			const uint32_t hashToCoalesce = nameHashes[lowest->loadOrder];
+			int matchCount = 0;
+			matches[matchCount++] = lowest;
+			while ( (heapCount != 0) && (nameHashes[heap[0]->loadOrder] == hashToCoalesce) && (strcmp(heap[0]->symbolName, nameToCoalesce) == 0) ) {
+				std::pop_heap(&heap[0], &heap[heapCount], CoalIteratorGreater());
+				matches[matchCount++] = heap[--heapCount];
 			}
-			// process all matching symbols just before incrementing the lowest one that matches
-			if ( sortedIts[0]->symbolMatches && !sortedIts[0]->done ) {
-				const char* nameToCoalesce = sortedIts[0]->symbolName;
+			// only need to coalesce if symbol is in more than one image
+			if ( matchCount > 1 ) {
 				// pick first symbol in load order (and non-weak overrides weak)
 				uintptr_t targetAddr = 0;
 				ImageLoader* targetImage = NULL;
-				for(int i=0; i < count; ++i) {
-					if ( strcmp(iterators[i].symbolName, nameToCoalesce) == 0 ) {
-						if ( context.verboseWeakBind )
-							dyld::log("dyld: weak bind, found %s weak=%d in %s \n", nameToCoalesce, iterators[i].weakSymbol, iterators[i].image->getPath());
-						if ( iterators[i].weakSymbol ) {
-							if ( targetAddr == 0 ) {
-								targetAddr = iterators[i].image->getAddressCoalIterator(iterators[i], context);
-								if ( targetAddr != 0 )
-									targetImage = iterators[i].image;
-							}
+				for(int i=0; i < matchCount; ++i) {
+					ImageLoader::CoalIterator& it = *matches[i];
+					if ( context.verboseWeakBind )
+						dyld::log("dyld: weak bind, found %s weak=%d in %s \n", nameToCoalesce, it.weakSymbol, it.image->getPath());
+					if ( it.weakSymbol ) {
+						if ( targetAddr == 0 ) {
+							targetAddr = it.image->getAddressCoalIterator(it, context);
+							if ( targetAddr != 0 )
+								targetImage = it.image;
 						}
-						else {
-							targetAddr = iterators[i].image->getAddressCoalIterator(iterators[i], context);
-							if ( targetAddr != 0 ) {
-								targetImage = iterators[i].image;
-								// strong implementation found, stop searching
-								break;
-							}
+					}
+					else {
+						targetAddr = it.image->getAddressCoalIterator(it, context);
+						if ( targetAddr != 0 ) {
+							targetImage = it.image;
+							// strong implementation found, stop searching
+							break;
 						}
 					}
 				}
 				// tell each to bind to this symbol (unless already bound)
 				if ( targetAddr != 0 ) {
+					++symbolsCoalesced;
 					if ( context.verboseWeakBind )
 						dyld::log("dyld: weak binding all uses of %s to copy from %s\n", nameToCoalesce, targetImage->getShortName());
-					for(int i=0; i < count; ++i) {
-						if ( strcmp(iterators[i].symbolName, nameToCoalesce) == 0 ) {
-							if ( context.verboseWeakBind )
-								dyld::log("dyld: weak bind, setting all uses of %s in %s to 0x%lX from %s\n", nameToCoalesce, iterators[i].image->getShortName(), targetAddr, targetImage->getShortName());
-							if ( ! iterators[i].image->fWeakSymbolsBound )
-								iterators[i].image->updateUsesCoalIterator(iterators[i], targetAddr, targetImage, context);
-							iterators[i].symbolMatches = false; 
-						}
+					for(int i=0; i < matchCount; ++i) {
+						ImageLoader::CoalIterator& it = *matches[i];
+						if ( context.verboseWeakBind )
+							dyld::log("dyld: weak bind, setting all uses of %s in %s to 0x%lX from %s\n", nameToCoalesce, it.image->getShortName(), targetAddr, targetImage->getShortName());
+						if ( ! it.image->fWeakSymbolsBound )
+							it.image->updateUsesCoalIterator(it, targetAddr, targetImage, context);
 					}
 				}
-				
+			}
+			// advance all iterators that were at this symbol and put them back in heap
+			for(int i=0; i < matchCount; ++i) {
+				ImageLoader::CoalIterator* it = matches[i];
+				if ( ! it->image->incrementCoalIterator(*it) ) {
+					nameHashes[it->loadOrder] = hash(it->symbolName);
+					heap[heapCount++] = it;
+					std::push_heap(&heap[0], &heap[heapCount], CoalIteratorGreater());
+				}
 			}
 		}
+		uint64_t t3 = mach_absolute_time();
+		if ( context.verboseWeakBind ) {
+			dyld::log("dyld: weak bind coalesced %u symbols, iterator setup %llu, merge %llu (mach time units)\n", 
+					symbolsCoalesced, t2 - t1, t3 - t2);
+		}
 		
 		// mark all as having all weak symbols bound
 		for(int i=0; i < count; ++i) {
 			imagesNeedingCoalescing[i]->fWeakSymbolsBound = true;
 		}
 	}
-	uint64_t t2 = mach_absolute_time();
-	fgTotalWeakBindTime += t2  - t1;
+	// all time spent here (setup and merge) is attributed to weak binding
+	fgTotalWeakBindTime += mach_absolute_time() - t1;
 	
 	if ( context.verboseWeakBind )
 		dyld::log("dyld: weak bind end\n");
@@ -1090,7 +1236,9 @@ void ImageLoader::printStatistics(unsigned int imageCount, const InitializerTimi
 #else
 	dyld::log("total images loaded:  %d (%u from dyld shared cache)\n", imageCount, fgImagesUsedFromSharedCache);
 #endif
-	dyld::log("total segments mapped: %u, into %llu pages with %llu pages pre-fetched\n", fgTotalSegmentsMapped, fgTotalBytesMapped/4096, fgTotalBytesPreFetched/4096);
+	dyld::log("total segments mapped: %u, into %llu pages with %llu pages pre-fetched in %u requests\n", 
+				fgTotalSegmentsMapped, fgTotalBytesMapped/4096, fgTotalBytesPreFetched/4096, fgTotalPreFetchRequests);
+	dyld::log("total image arena: %llu KB\n", fgImageArenaBytes/1024);
 	printTime("total images loading time", fgTotalLoadLibrariesTime, totalTime);
 	printTime("total dtrace DOF registration time", fgTotalDOF, totalTime);
 	dyld::log("total rebase fixups:  %s\n", commatize(fgTotalRebaseFixups, commaNum1));
@@ -1103,6 +1251,14 @@ void ImageLoader::printStatistics(unsigned int imageCount, const InitializerTimi
 		dyld::log("total binding symbol lookups: %s, average images searched per symbol: %u.%u\n", 
 				commatize(fgTotalBindSymbolsResolved, commaNum1), avgInt, avgTenths);
 	}
+	if ( fgTotalBindCacheLookups != 0 ) {
+		uint32_t hitPercent = (uint32_t)(((uint64_t)fgTotalBindCacheHits * 100) / fgTotalBindCacheLookups);
+		dyld::log("total binding symbol cache lookups: %s, hit rate: %u%%, trie walks saved: %s\n", 
+				commatize(fgTotalBindCacheLookups, commaNum1), hitPercent, commatize(fgTotalBindCacheHits, commaNum2));
+	}
+	if ( fgImagesBoundFromLaunchClosure != 0 )
+		dyld::log("total binding fixups from launch closure: %s in %u images\n", 
+				commatize(fgTotalLaunchClosureFixups, commaNum1), fgImagesBoundFromLaunchClosure);
 	printTime("total binding fixups time", fgTotalBindTime, totalTime);
 	printTime("total weak binding fixups time", fgTotalWeakBindTime, totalTime);
 	dyld::log("total bindings lazily fixed up: %s of %s\n", commatize(fgTotalLazyBindFixups, commaNum1), commatize(fgTotalPossibleLazyBindFixups, commaNum2));
@@ -244,6 +244,7 @@ public:
 	
 	struct LinkContext {
 		ImageLoader*	(*loadLibrary)(const char* libraryName, bool search, const char* origin, const RPathChain* rpaths);
+		void			(*prefetchLibrary)(const char* libraryName, const char* origin, const RPathChain* rpaths);
 		void			(*terminationRecorder)(ImageLoader* image);
 		bool			(*flatExportFinder)(const char* name, const Symbol** sym, const ImageLoader** image);
 		bool			(*coalescedExportFinder)(const char* name, const Symbol** sym, const ImageLoader** image);
@@ -264,6 +265,9 @@ public:
 										const char* errorTargetDylibPath, const char* errorSymbol);
 		ImageLoader*	(*findImageContainingAddress)(const void* addr);
 		void			(*addDynamicReference)(ImageLoader* from, ImageLoader* to);
+		void			(*recordLaunchClosureBind)(const ImageLoader* image, uintptr_t location, uintptr_t value,
+													const ImageLoader* target, uint8_t type);
+		bool			(*applyLaunchClosureBinds)(const ImageLoader* image, bool lazysBound, uint32_t* fixupCount);
 		
 #if SUPPORT_OLD_CRT_INITIALIZATION
 		void			(*setRunInitialzersOldWay)();
@@ -289,6 +293,7 @@ public:
 		bool			prebinding;
 		bool			bindFlat;
 		bool			linkingMainExecutable;
+		bool			insertedLibraries;
 		bool			startedInitializingMainExecutable;
 		bool			processIsRestricted;
 		bool			processRequiresLibraryValidation;
@@ -413,6 +418,10 @@ public:
 										// st_mtime from stat() on file
 	time_t								lastModified() const;
 
+										// st_dev and st_ino from stat() on file
+	dev_t								getDevice() const { return fDevice; }
+	ino_t								getInode() const { return fInode; }
+
 										// only valid for main executables, returns a pointer its entry point from LC_UNIXTHREAD
 	virtual void*						getThreadPC() const = 0;
 	
@@ -473,6 +482,10 @@ public:
 										// find the closest symbol before addr
 	virtual const char*					findClosestSymbol(const void* addr, const void** closestAddr) const = 0;
 	
+										// find the closest symbol before each of addrs[], which must be sorted
+	virtual void						findClosestSymbols(const void* const addrs[], unsigned int count, 
+															const char* names[], const void* closestAddrs[]) const;
+	
 										// checks if this image is a bundle and can be loaded but not linked
 	virtual bool						isBundle() const = 0;
 	
@@ -493,7 +506,8 @@ public:
 	
 										// called at runtime when a fast lazily bound function is first called
 	virtual uintptr_t					doBindFastLazySymbol(uint32_t lazyBindingInfoOffset, const LinkContext& context,
-															void (*lock)(), void (*unlock)()) = 0;
+															void (*lock)(), void (*unlock)(),
+															bool (*enterReadSection)(), void (*exitReadSection)()) = 0;
 
 										// calls termination routines (e.g. C++ static destructors for image)
 	virtual void						doTermination(const LinkContext& context) = 0;
@@ -557,6 +571,15 @@ public:
 										// if the image contains interposing functions, register them
 	virtual void						registerInterposing() = 0;
 
+										// drop any bind info decoded for binding and interposing passes
+	virtual void						releaseDecodedBindInfo() {}
+
+										// true if any image registered interposing tuples
+	static bool							hasInterposingTuples() { return (fgInterposingTuples.size() != 0); }
+
+										// drop any address index built for dladdr()
+	virtual void						releaseSymbolAddressIndex() {}
+
 										// when resolving symbols look in subImage if symbol can't be found
 	void								reExport(ImageLoader* subImage);
 	
@@ -597,6 +620,17 @@ public:
 	
 										// used instead of directly deleting image
 	static void							deleteImage(ImageLoader*);
+
+										// images instantiated at launch are allocated in load order from an arena
+	static void							setArenaEnabled(bool enabled) { fgImageArenaEnabled = enabled; }
+	static void*						allocateInArena(size_t size);
+	static bool							inArena(const void* p);
+
+										// changes whenever any image's exports are hidden or unhidden
+	static uint32_t						hiddenExportsGeneration() { return fgHiddenExportsGeneration; }
+
+										// range of this image's export trie, false if it has no trie
+	virtual bool						getExportTrie(const uint8_t** start, const uint8_t** end) const { return false; }
 		
 			bool						dependsOn(ImageLoader* image);
 			
@@ -629,7 +663,7 @@ protected:
 					ImageLoader(const char* path, unsigned int libCount); 
 					ImageLoader(const ImageLoader&);
 	void			operator=(const ImageLoader&);
-	void			operator delete(void* image) throw() { ::free(image); }
+	void			operator delete(void* image) throw() { if ( !inArena(image) ) ::free(image); }
 	
 
 	struct LibraryInfo {
@@ -654,6 +688,12 @@ protected:
 		bool				upward;
 	};
 
+	// symbol lookups done while binding, one cache is shared by all images bound by a link()
+	// or bindAllLazyPointers(), see ImageLoaderMachOCompressed::resolve()
+	enum { kResolveCacheSize = 256, kResolveCacheMaxProbe = 8 };
+	struct ResolveCacheEntry { const char* name; const ImageLoader* requestor; const ImageLoader* foundIn; uintptr_t result; long ordinal; uint8_t flags; };
+	struct ResolveCache { ResolveCacheEntry entries[kResolveCacheSize]; };
+
 
 	typedef void (*Initializer)(int argc, const char* argv[], const char* envp[], const char* apple[], const ProgramVars* vars);
 	typedef void (*Terminator)(void);
@@ -673,7 +713,8 @@ protected:
 	unsigned int		recursiveUpdateDepth(unsigned int maxDepth);
 	void				recursiveValidate(const LinkContext& context);
 	void				recursiveRebase(const LinkContext& context);
-	void				recursiveBind(const LinkContext& context, bool forceLazysBound, bool neverUnload);
+	void				recursiveBind(const LinkContext& context, bool forceLazysBound, bool neverUnload, ResolveCache* cache);
+	void				recursiveBindAllLazyPointers(const LinkContext& context, bool recursive, ResolveCache* cache);
 	void				recursiveApplyInterposing(const LinkContext& context);
 	void				recursiveGetDOFSections(const LinkContext& context, std::vector<DOFInfo>& dofs);
 	void				recursiveInitialization(const LinkContext& context, mach_port_t this_thread,
@@ -689,10 +730,10 @@ protected:
 	virtual void				doRebase(const LinkContext& context) = 0;
 	
 								// do any symbolic fix ups in this image
-	virtual void				doBind(const LinkContext& context, bool forceLazysBound) = 0;
+	virtual void				doBind(const LinkContext& context, bool forceLazysBound, ResolveCache* cache) = 0;
 	
 								// called later via API to force all lazy pointer to be bound
-	virtual void				doBindJustLazies(const LinkContext& context) = 0;
+	virtual void				doBindJustLazies(const LinkContext& context, ResolveCache* cache) = 0;
 	
 								// if image has any dtrace DOF sections, append them to list to be registered
 	virtual void				doGetDOFSections(const LinkContext& context, std::vector<DOFInfo>& dofs) = 0;
@@ -730,6 +771,10 @@ protected:
 	void						setFileInfo(dev_t device, ino_t inode, time_t modDate);
 	
 	static uintptr_t			interposedAddress(const LinkContext& context, uintptr_t address, const ImageLoader* notInImage, const ImageLoader* onlyInImage=NULL);
+
+								// returns NULL if out of memory, binding then just does not cache lookups
+	static ResolveCache*		newResolveCache();
+	static void					deleteResolveCache(ResolveCache* cache);
 	
 	static uintptr_t			fgNextPIEDylibAddress;
 	static uint32_t				fgImagesWithUsedPrebinding;
@@ -740,11 +785,19 @@ protected:
 	static uint32_t				fgTotalBindFixups;
 	static uint32_t				fgTotalBindSymbolsResolved;
 	static uint32_t				fgTotalBindImageSearches;
+	static uint32_t				fgTotalBindCacheLookups;
+	static uint32_t				fgTotalBindCacheHits;
+	static uint32_t				fgTotalLaunchClosureFixups;
+	static uint32_t				fgImagesBoundFromLaunchClosure;
 	static uint32_t				fgTotalLazyBindFixups;
 	static uint32_t				fgTotalPossibleLazyBindFixups;
 	static uint32_t				fgTotalSegmentsMapped;
 	static uint64_t				fgTotalBytesMapped;
 	static uint64_t				fgTotalBytesPreFetched;
+	static uint32_t				fgTotalPreFetchRequests;
+	static uint64_t				fgImageArenaBytes;
+	static bool					fgImageArenaEnabled;
+	static uint32_t				fgHiddenExportsGeneration;
 	static uint64_t				fgTotalLoadLibrariesTime;
 	static uint64_t				fgTotalRebaseTime;
 	static uint64_t				fgTotalBindTime;
@@ -46,6 +46,8 @@
 #include <stdint.h>
 #include <System/sys/codesign.h>
 
+#include <algorithm>
+
 #include "ImageLoaderMachO.h"
 #include "ImageLoaderMachOCompressed.h"
 #if SUPPORT_CLASSIC_MACHO
@@ -88,11 +90,13 @@ extern "C" long __stack_chk_guard;
 
 uint32_t ImageLoaderMachO::fgSymbolTableBinarySearchs = 0;
 uint32_t ImageLoaderMachO::fgSymbolTrieSearchs = 0;
+uint32_t ImageLoaderMachO::fgSymbolAddressIndexCount = 0;
+uint64_t ImageLoaderMachO::fgSymbolAddressIndexBytes = 0;
 
 
 ImageLoaderMachO::ImageLoaderMachO(const macho_header* mh, const char* path, unsigned int segCount, 
 																uint32_t segOffsets[], unsigned int libCount)
- : ImageLoader(path, libCount), fCoveredCodeLength(0), fMachOData((uint8_t*)mh), fLinkEditBase(NULL), fSlide(0),
+ : ImageLoader(path, libCount), fCoveredCodeLength(0), fMachOData((uint8_t*)mh), fLinkEditBase(NULL), fSlide(0), fSymbolAddressIndex(NULL),
 	fEHFrameSectionOffset(0), fUnwindInfoSectionOffset(0), fDylibIDOffset(0), 
 fSegmentsCount(segCount), fIsSplitSeg(false), fInSharedCache(false),
 #if TEXT_RELOC_SUPPORT
@@ -343,6 +347,9 @@ ImageLoader* ImageLoaderMachO::instantiateFromFile(const char* path, int fd, con
 	const linkedit_data_command* codeSigCmd;
 	const encryption_info_command* encryptCmd;
 	sniffLoadCommands((const macho_header*)fileData, path, false, &compressed, &segCount, &libCount, context, &codeSigCmd, &encryptCmd);
+	// start reading all of LINKEDIT that linking will use before segments are mapped
+	if ( !context.preFetchDisabled )
+		preFetchLINKEDIT((const macho_header*)fileData, compressed, fd, offsetInFat, lenInFat, context);
 	// instantiate concrete class based on content of load commands
 	if ( compressed ) 
 		return ImageLoaderMachOCompressed::instantiateFromFile(path, fd, fileData, dataSize, offsetInFat, lenInFat, info, segCount, libCount, codeSigCmd, encryptCmd, context);
@@ -577,6 +584,9 @@ void ImageLoaderMachO::destroy()
 	if ( fInSharedCache )
 		--fgImagesUsedFromSharedCache;
 		
+	// free dladdr() index, if one was built
+	releaseSymbolAddressIndex();
+
 	// unmap image when done
 	UnmapSegments();
 }
@@ -736,6 +746,101 @@ void ImageLoaderMachO::UnmapSegments()
 }
 
 
+//
+// Linking reads the dyld info opcodes and export trie (or for classic images the relocations,
+// external symbols and strings) plus the indirect symbol table, all in __LINKEDIT.  Without help
+// those pages are faulted in one at a time as binding walks them.  From the load commands, compute
+// every file range linking needs, merge ranges that are close together, and start reading them
+// all with F_RDADVISE before any segment is mapped.
+//
+struct LinkEditRange { uint64_t start; uint64_t end; };
+
+static void addLinkEditRange(LinkEditRange ranges[], unsigned int& count, unsigned int maxCount, uint64_t start, uint64_t size)
+{
+	if ( (size == 0) || (count == maxCount) )
+		return;
+	// keep sorted by start, there are only a handful
+	unsigned int i = count;
+	while ( (i > 0) && (ranges[i-1].start > start) ) {
+		ranges[i] = ranges[i-1];
+		--i;
+	}
+	ranges[i].start = start;
+	ranges[i].end   = start + size;
+	++count;
+}
+
+void ImageLoaderMachO::preFetchLINKEDIT(const macho_header* mh, bool compressed, int fd, uint64_t offsetInFat, uint64_t lenInFat,
+										const LinkContext& context)
+{
+	const unsigned int kMaxRanges = 12;
+	LinkEditRange ranges[kMaxRanges];
+	unsigned int count = 0;
+	const uint32_t cmd_count = mh->ncmds;
+	const struct load_command* const cmds = (struct load_command*)(((char*)mh) + sizeof(macho_header));
+	const struct load_command* cmd = cmds;
+	const struct symtab_command* symtab = NULL;
+	const struct dysymtab_command* dysymtab = NULL;
+	for (uint32_t i = 0; i < cmd_count; ++i) {
+		switch (cmd->cmd) {
+			case LC_DYLD_INFO:
+			case LC_DYLD_INFO_ONLY:
+				{
+					const struct dyld_info_command* dyldInfo = (struct dyld_info_command*)cmd;
+					addLinkEditRange(ranges, count, kMaxRanges, dyldInfo->rebase_off, dyldInfo->rebase_size);
+					addLinkEditRange(ranges, count, kMaxRanges, dyldInfo->bind_off, dyldInfo->bind_size);
+					addLinkEditRange(ranges, count, kMaxRanges, dyldInfo->weak_bind_off, dyldInfo->weak_bind_size);
+					addLinkEditRange(ranges, count, kMaxRanges, dyldInfo->lazy_bind_off, dyldInfo->lazy_bind_size);
+					addLinkEditRange(ranges, count, kMaxRanges, dyldInfo->export_off, dyldInfo->export_size);
+				}
+				break;
+			case LC_SYMTAB:
+				symtab = (struct symtab_command*)cmd;
+				break;
+			case LC_DYSYMTAB:
+				dysymtab = (struct dysymtab_command*)cmd;
+				break;
+		}
+		cmd = (const struct load_command*)(((char*)cmd)+cmd->cmdsize);
+	}
+	if ( dysymtab != NULL ) {
+		addLinkEditRange(ranges, count, kMaxRanges, dysymtab->indirectsymoff, dysymtab->nindirectsyms*sizeof(uint32_t));
+		// compressed images bind from dyld info, classic ones from relocations and the symbol table
+		if ( !compressed && (symtab != NULL) ) {
+			addLinkEditRange(ranges, count, kMaxRanges, dysymtab->locreloff, dysymtab->nlocrel*sizeof(struct relocation_info));
+			addLinkEditRange(ranges, count, kMaxRanges, dysymtab->extreloff, dysymtab->nextrel*sizeof(struct relocation_info));
+			addLinkEditRange(ranges, count, kMaxRanges, symtab->symoff + (uint64_t)dysymtab->iextdefsym*sizeof(macho_nlist), 
+							(uint64_t)(dysymtab->nextdefsym + dysymtab->nundefsym)*sizeof(macho_nlist));
+			addLinkEditRange(ranges, count, kMaxRanges, symtab->stroff, symtab->strsize);
+		}
+	}
+	
+	// merge ranges separated by less than a few pages, one read is cheaper than another request
+	for (unsigned int i=0; i < count; ) {
+		uint64_t start = dyld_page_trunc(ranges[i].start);
+		uint64_t end = ranges[i].end;
+		for (++i; (i < count) && (ranges[i].start <= end + 4*dyld_page_size); ++i) {
+			if ( ranges[i].end > end )
+				end = ranges[i].end;
+		}
+		end = dyld_page_round(end);
+		if ( end > lenInFat )
+			end = lenInFat;
+		if ( end <= start )
+			continue;
+		// limit each request to 1MB (256 pages) like __DATA prefetching
+		radvisory advice;
+		advice.ra_offset = offsetInFat + start;
+		advice.ra_count = (int)std::min(end - start, (uint64_t)1024*1024);
+		fcntl(fd, F_RDADVISE, &advice);
+		fgTotalBytesPreFetched += advice.ra_count;
+		++fgTotalPreFetchRequests;
+		if ( context.verboseMapping ) 
+			dyld::log("%18s prefetching file offset 0x%0llX -> 0x%0llX\n", "__LINKEDIT", advice.ra_offset, advice.ra_offset+advice.ra_count-1);
+	}
+}
+
+
 // prefetch __DATA/__OBJC pages during launch, but not for dynamically loaded code
 void ImageLoaderMachO::preFetchDATA(int fd, uint64_t offsetInFat, const LinkContext& context)
 {
@@ -751,6 +856,7 @@ void ImageLoaderMachO::preFetchDATA(int fd, uint64_t offsetInFat, const LinkCont
 					advice.ra_count = 1024*1024;
 				// don't prefetch single pages, let them fault in
 				fgTotalBytesPreFetched += advice.ra_count;
+				++fgTotalPreFetchRequests;
 				fcntl(fd, F_RDADVISE, &advice);
 				if ( context.verboseMapping ) {
 					dyld::log("%18s prefetching 0x%0lX -> 0x%0lX\n", 
@@ -1943,11 +2049,145 @@ void ImageLoaderMachO::doTermination(const LinkContext& context)
 }
 
 
+bool ImageLoaderMachO::symbolAddressLess(const SymbolAddressEntry& left, const SymbolAddressEntry& right)
+{
+	return (left.address < right.address);
+}
+
+//
+// dladdr() used to scan all global and local nlist entries on every call.  Instead, the
+// first call builds an array of (address, strx) for the symbols that scan considered, in
+// scan order (globals then locals), and stable sorts it by address.  Lookups are then a
+// binary search, and picking the first entry at the matching address gives the same
+// symbol the scan would have returned.
+//
+const ImageLoaderMachO::SymbolAddressIndex* ImageLoaderMachO::symbolAddressIndex(const macho_nlist* symbolTable, const dysymtab_command* dynSymbolTable) const
+{
+	SymbolAddressIndex* index = fSymbolAddressIndex;
+	if ( index != NULL )
+		return index;
+	
+	const struct macho_nlist* const globalsStart = &symbolTable[dynSymbolTable->iextdefsym];
+	const struct macho_nlist* const globalsEnd= &globalsStart[dynSymbolTable->nextdefsym];
+	const struct macho_nlist* const localsStart = &symbolTable[dynSymbolTable->ilocalsym];
+	const struct macho_nlist* const localsEnd= &localsStart[dynSymbolTable->nlocalsym];
+	uint32_t count = 0;
+	for (const struct macho_nlist* s = globalsStart; s < globalsEnd; ++s) {
+ 		if ( (s->n_type & N_TYPE) == N_SECT )
+			++count;
+	}
+	for (const struct macho_nlist* s = localsStart; s < localsEnd; ++s) {
+ 		if ( ((s->n_type & N_TYPE) == N_SECT) && ((s->n_type & N_STAB) == 0) )
+			++count;
+	}
+	
+	const uint32_t size = (uint32_t)(sizeof(SymbolAddressIndex) + count*sizeof(SymbolAddressEntry));
+	index = (SymbolAddressIndex*)malloc(size);
+	if ( index == NULL )
+		return NULL;
+	index->count = count;
+	index->size = size;
+	SymbolAddressEntry* entry = index->entries;
+	for (const struct macho_nlist* s = globalsStart; s < globalsEnd; ++s) {
+ 		if ( (s->n_type & N_TYPE) == N_SECT ) {
+			entry->address = s->n_value;
+			entry->strx = s->n_un.n_strx;
+#if __arm__
+			entry->isThumb = ((s->n_desc & N_ARM_THUMB_DEF) != 0);
+#else
+			entry->isThumb = 0;
+#endif
+			++entry;
+		}
+	}
+	for (const struct macho_nlist* s = localsStart; s < localsEnd; ++s) {
+ 		if ( ((s->n_type & N_TYPE) == N_SECT) && ((s->n_type & N_STAB) == 0) ) {
+			entry->address = s->n_value;
+			entry->strx = s->n_un.n_strx;
+#if __arm__
+			entry->isThumb = ((s->n_desc & N_ARM_THUMB_DEF) != 0);
+#else
+			entry->isThumb = 0;
+#endif
+			++entry;
+		}
+	}
+	std::stable_sort(&index->entries[0], &index->entries[count], &symbolAddressLess);
+	
+	// another thread may have built the index at the same time, if so use theirs
+	if ( !OSAtomicCompareAndSwapPtrBarrier(NULL, index, (void* volatile*)&fSymbolAddressIndex) ) {
+		free(index);
+		return fSymbolAddressIndex;
+	}
+	OSAtomicIncrement32((volatile int32_t*)&fgSymbolAddressIndexCount);
+	OSAtomicAdd64(size, (volatile int64_t*)&fgSymbolAddressIndexBytes);
+	return index;
+}
+
+void ImageLoaderMachO::releaseSymbolAddressIndex()
+{
+	SymbolAddressIndex* index = fSymbolAddressIndex;
+	if ( (index != NULL) && OSAtomicCompareAndSwapPtrBarrier(index, NULL, (void* volatile*)&fSymbolAddressIndex) ) {
+		OSAtomicDecrement32((volatile int32_t*)&fgSymbolAddressIndexCount);
+		OSAtomicAdd64(-(int64_t)index->size, (volatile int64_t*)&fgSymbolAddressIndexBytes);
+		free(index);
+	}
+}
+
+const char* ImageLoaderMachO::findClosestSymbolIndexed(const macho_nlist* symbolTable, const char* symbolTableStrings, 
+												const dysymtab_command* dynSymbolTable, const void* addr, const void** closestAddr) const
+{
+	const char* name;
+	const void* closest;
+	this->findClosestSymbolsIndexed(symbolTable, symbolTableStrings, dynSymbolTable, &addr, 1, &name, &closest);
+	if ( name != NULL )
+		*closestAddr = closest;
+	return name;
+}
+
+void ImageLoaderMachO::findClosestSymbolsIndexed(const macho_nlist* symbolTable, const char* symbolTableStrings, 
+												const dysymtab_command* dynSymbolTable, const void* const addrs[], unsigned int count,
+												const char* names[], const void* closestAddrs[]) const
+{
+	const SymbolAddressIndex* index = this->symbolAddressIndex(symbolTable, dynSymbolTable);
+	// addrs[] is sorted, so each search can start where the previous one ended
+	uint32_t low = 0;
+	for (unsigned int i=0; i < count; ++i) {
+		names[i] = NULL;
+		closestAddrs[i] = NULL;
+		if ( index == NULL )
+			continue;
+		// find first entry above target address, the one before it is the closest
+		uintptr_t targetAddress = (uintptr_t)addrs[i] - fSlide;
+		uint32_t high = index->count;
+		while ( low < high ) {
+			uint32_t mid = (low + high) / 2;
+			if ( index->entries[mid].address <= targetAddress )
+				low = mid + 1;
+			else
+				high = mid;
+		}
+		if ( low == 0 )
+			continue;
+		const SymbolAddressEntry* best = &index->entries[low-1];
+		while ( (best > index->entries) && (best[-1].address == best->address) )
+			--best;
+		
+		if ( best->isThumb )
+			closestAddrs[i] = (void*)((best->address | 1) + fSlide);
+		else
+			closestAddrs[i] = (void*)(best->address + fSlide);
+		names[i] = &symbolTableStrings[best->strx];
+	}
+}
+
+
 void ImageLoaderMachO::printStatistics(unsigned int imageCount, const InitializerTimingList& timingInfo)
 {
 	ImageLoader::printStatistics(imageCount, timingInfo);
 	dyld::log("total symbol trie searches:    %d\n", fgSymbolTrieSearchs);
 	dyld::log("total symbol table binary searches:    %d\n", fgSymbolTableBinarySearchs);
+	dyld::log("total symbol address index memory: %llu bytes in %u images\n", fgSymbolAddressIndexBytes, fgSymbolAddressIndexCount);
 	dyld::log("total images defining weak symbols:  %u\n", fgImagesHasWeakDefinitions);
 	dyld::log("total images using weak symbols:  %u\n", fgImagesRequiringCoalescing);
 }
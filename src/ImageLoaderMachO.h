@@ -80,7 +80,8 @@ public:
 	virtual	uintptr_t					getAddressCoalIterator(CoalIterator&, const LinkContext& contex) = 0;
 	virtual	void						updateUsesCoalIterator(CoalIterator&, uintptr_t newAddr, ImageLoader* target, const LinkContext& context) = 0;
 	virtual uintptr_t					doBindLazySymbol(uintptr_t* lazyPointer, const LinkContext& context) = 0;
-	virtual uintptr_t					doBindFastLazySymbol(uint32_t lazyBindingInfoOffset, const LinkContext& context, void (*lock)(), void (*unlock)()) = 0;
+	virtual uintptr_t					doBindFastLazySymbol(uint32_t lazyBindingInfoOffset, const LinkContext& context, void (*lock)(), void (*unlock)(),
+															bool (*enterReadSection)(), void (*exitReadSection)()) = 0;
 	virtual void						doTermination(const LinkContext& context);
 	virtual bool						needsInitialization();
 	virtual bool						getSectionContent(const char* segmentName, const char* sectionName, void** start, size_t* length);
@@ -104,6 +105,7 @@ public:
 	virtual void						registerInterposing();
 	virtual uint32_t					sdkVersion() const;
 	virtual uint32_t					minOSVersion() const;
+	virtual void						releaseSymbolAddressIndex();
 			
 	
 	static void							printStatistics(unsigned int imageCount, const InitializerTimingList&);
@@ -143,8 +145,8 @@ protected:
 	virtual	void		getRPaths(const LinkContext& context, std::vector<const char*>&) const;
 	virtual	bool		getUUID(uuid_t) const;
 	virtual void		doRebase(const LinkContext& context);
-	virtual void		doBind(const LinkContext& context, bool forceLazysBound) = 0;
-	virtual void		doBindJustLazies(const LinkContext& context) = 0;
+	virtual void		doBind(const LinkContext& context, bool forceLazysBound, ResolveCache* cache) = 0;
+	virtual void		doBindJustLazies(const LinkContext& context, ResolveCache* cache) = 0;
 	virtual bool		doInitialization(const LinkContext& context);
 	virtual void		doGetDOFSections(const LinkContext& context, std::vector<ImageLoader::DOFInfo>& dofs);
 	virtual bool		needsTermination();
@@ -163,6 +165,8 @@ protected:
 											const linkedit_data_command** codeSigCmd,
 											const encryption_info_command** encryptCmd);
 	static bool			needsAddedLibSystemDepency(unsigned int libCount, const macho_header* mh);
+	static void			preFetchLINKEDIT(const macho_header* mh, bool compressed, int fd, uint64_t offsetInFat, uint64_t lenInFat,
+											const LinkContext& context);
 			void		loadCodeSignature(const struct linkedit_data_command* codeSigCmd, int fd, uint64_t offsetInFatFile, const LinkContext& context);
 			void		validateFirstPages(const struct linkedit_data_command* codeSigCmd, int fd, const uint8_t *fileData, size_t lenFileData, off_t offsetInFat, const LinkContext& context);
 			const struct macho_segment_command* segLoadCommand(unsigned int segIndex) const;
@@ -202,11 +206,24 @@ protected:
 										const LinkContext& context, bool runResolver) const;
 			
 	static uintptr_t			bindLazySymbol(const mach_header*, uintptr_t* lazyPointer);
+
+	// defined symbols sorted by address, built on first dladdr() of this image
+	struct SymbolAddressEntry { uintptr_t address; uint32_t strx : 31, isThumb : 1; };
+	struct SymbolAddressIndex { uint32_t count; uint32_t size; SymbolAddressEntry entries[1]; };
+
+			const char*	findClosestSymbolIndexed(const macho_nlist* symbolTable, const char* symbolTableStrings, 
+										const dysymtab_command* dynSymbolTable, const void* addr, const void** closestAddr) const;
+			void		findClosestSymbolsIndexed(const macho_nlist* symbolTable, const char* symbolTableStrings, 
+										const dysymtab_command* dynSymbolTable, const void* const addrs[], unsigned int count,
+										const char* names[], const void* closestAddrs[]) const;
+			const SymbolAddressIndex* symbolAddressIndex(const macho_nlist* symbolTable, const dysymtab_command* dynSymbolTable) const;
+	static	bool		symbolAddressLess(const SymbolAddressEntry& left, const SymbolAddressEntry& right);
 protected:
 	uint64_t								fCoveredCodeLength;
 	const uint8_t*							fMachOData;
 	const uint8_t*							fLinkEditBase; // add any internal "offset" to this to get mapped address
 	uintptr_t								fSlide;
+	mutable SymbolAddressIndex* volatile	fSymbolAddressIndex;
 	uint32_t								fEHFrameSectionOffset;
 	uint32_t								fUnwindInfoSectionOffset;
 	uint32_t								fDylibIDOffset;
@@ -232,6 +249,8 @@ protected:
 											
 	static uint32_t					fgSymbolTableBinarySearchs;
 	static uint32_t					fgSymbolTrieSearchs;
+	static uint32_t					fgSymbolAddressIndexCount;
+	static uint64_t					fgSymbolAddressIndexBytes;
 };
 
 
@@ -266,7 +266,9 @@ ImageLoaderMachOClassic* ImageLoaderMachOClassic::instantiateStart(const macho_h
 																		unsigned int segCount, unsigned int libCount)
 {
 	size_t size = sizeof(ImageLoaderMachOClassic) + segCount * sizeof(uint32_t) + libCount * sizeof(ImageLoader*);
-	ImageLoaderMachOClassic* allocatedSpace = static_cast<ImageLoaderMachOClassic*>(malloc(size));
+	ImageLoaderMachOClassic* allocatedSpace = static_cast<ImageLoaderMachOClassic*>(allocateInArena(size));
+	if ( allocatedSpace == NULL )
+		allocatedSpace = static_cast<ImageLoaderMachOClassic*>(malloc(size));
 	if ( allocatedSpace == NULL )
 		throw "malloc failed";
 	uint32_t* segOffsets = ((uint32_t*)(((uint8_t*)allocatedSpace) + sizeof(ImageLoaderMachOClassic)));
@@ -366,6 +368,7 @@ void ImageLoaderMachOClassic::prefetchLINKEDIT(const LinkContext& context)
 	if ( (end-start) > dyld_page_size ) {
 		madvise((void*)start, end-start, MADV_WILLNEED);
 		fgTotalBytesPreFetched += (end-start);
+		++fgTotalPreFetchRequests;
 		if ( context.verboseMapping ) {
 			dyld::log("%18s prefetching 0x%0lX -> 0x%0lX\n", "__LINKEDIT", start, end-1);
 		}
@@ -1385,7 +1388,8 @@ uintptr_t ImageLoaderMachOClassic::bindIndirectSymbol(uintptr_t* ptrToBind, cons
 	return targetAddr;
 }
 
-uintptr_t ImageLoaderMachOClassic::doBindFastLazySymbol(uint32_t lazyBindingInfoOffset, const LinkContext& context, void (*lock)(), void (*unlock)())
+uintptr_t ImageLoaderMachOClassic::doBindFastLazySymbol(uint32_t lazyBindingInfoOffset, const LinkContext& context, void (*lock)(), void (*unlock)(),
+														bool (*enterReadSection)(), void (*exitReadSection)())
 {
 	throw "compressed LINKEDIT lazy binder called with classic LINKEDIT";
 }
@@ -1890,7 +1894,7 @@ void ImageLoaderMachOClassic::initializeLazyStubs(const LinkContext& context)
 #endif // __i386__
 
 
-void ImageLoaderMachOClassic::doBind(const LinkContext& context, bool forceLazysBound)
+void ImageLoaderMachOClassic::doBind(const LinkContext& context, bool forceLazysBound, ResolveCache*)
 {
 	CRSetCrashLogMessage2(this->getPath());
 #if __i386__
@@ -1932,7 +1936,7 @@ void ImageLoaderMachOClassic::doBind(const LinkContext& context, bool forceLazys
 	CRSetCrashLogMessage2(NULL);
 }
 
-void ImageLoaderMachOClassic::doBindJustLazies(const LinkContext& context)
+void ImageLoaderMachOClassic::doBindJustLazies(const LinkContext& context, ResolveCache*)
 {
 	// some API called requested that all lazy pointers in this image be force bound
 	this->bindIndirectSymbolPointers(context, false, true);
@@ -2083,48 +2087,12 @@ void ImageLoaderMachOClassic::dynamicInterpose(const LinkContext& context)
 
 const char* ImageLoaderMachOClassic::findClosestSymbol(const void* addr, const void** closestAddr) const
 {
-	uintptr_t targetAddress = (uintptr_t)addr - fSlide;
-	const struct macho_nlist* bestSymbol = NULL;
-	// first walk all global symbols
-	const struct macho_nlist* const globalsStart = &fSymbolTable[fDynamicInfo->iextdefsym];
-	const struct macho_nlist* const globalsEnd= &globalsStart[fDynamicInfo->nextdefsym];
-	for (const struct macho_nlist* s = globalsStart; s < globalsEnd; ++s) {
- 		if ( (s->n_type & N_TYPE) == N_SECT ) {
-			if ( bestSymbol == NULL ) {
-				if ( s->n_value <= targetAddress )
-					bestSymbol = s;
-			}
-			else if ( (s->n_value <= targetAddress) && (bestSymbol->n_value < s->n_value) ) {
-				bestSymbol = s;
-			}
-		}
-	}
-	// next walk all local symbols
-	const struct macho_nlist* const localsStart = &fSymbolTable[fDynamicInfo->ilocalsym];
-	const struct macho_nlist* const localsEnd= &localsStart[fDynamicInfo->nlocalsym];
-	for (const struct macho_nlist* s = localsStart; s < localsEnd; ++s) {
- 		if ( ((s->n_type & N_TYPE) == N_SECT) && ((s->n_type & N_STAB) == 0) ) {
-			if ( bestSymbol == NULL ) {
-				if ( s->n_value <= targetAddress )
-					bestSymbol = s;
-			}
-			else if ( (s->n_value <= targetAddress) && (bestSymbol->n_value < s->n_value) ) {
-				bestSymbol = s;
-			}
-		}
-	}
-	if ( bestSymbol != NULL ) {
-#if __arm__
-		if (bestSymbol->n_desc & N_ARM_THUMB_DEF)
-			*closestAddr = (void*)((bestSymbol->n_value | 1) + fSlide);
-		else
-			*closestAddr = (void*)(bestSymbol->n_value + fSlide);
-#else
-		*closestAddr = (void*)(bestSymbol->n_value + fSlide);
-#endif
-		return &fStrings[bestSymbol->n_un.n_strx];
-	}
-	return NULL;
+	return this->findClosestSymbolIndexed(fSymbolTable, fStrings, fDynamicInfo, addr, closestAddr);
+}
+
+void ImageLoaderMachOClassic::findClosestSymbols(const void* const addrs[], unsigned int count, const char* names[], const void* closestAddrs[]) const
+{
+	this->findClosestSymbolsIndexed(fSymbolTable, fStrings, fDynamicInfo, addrs, count, names, closestAddrs);
 }
 
 
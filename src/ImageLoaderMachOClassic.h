@@ -54,11 +54,14 @@ public:
 	virtual bool						libReExported(unsigned int) const;
 	virtual bool						libIsUpward(unsigned int) const;
 	virtual void						setLibImage(unsigned int, ImageLoader*, bool, bool);
-	virtual void						doBind(const LinkContext& context, bool forceLazysBound);
-	virtual void						doBindJustLazies(const LinkContext& context);
+	virtual void						doBind(const LinkContext& context, bool forceLazysBound, ResolveCache*);
+	virtual void						doBindJustLazies(const LinkContext& context, ResolveCache*);
 	virtual uintptr_t					doBindLazySymbol(uintptr_t* lazyPointer, const LinkContext& context);
-	virtual uintptr_t					doBindFastLazySymbol(uint32_t lazyBindingInfoOffset, const LinkContext& context, void (*lock)(), void (*unlock)());
+	virtual uintptr_t					doBindFastLazySymbol(uint32_t lazyBindingInfoOffset, const LinkContext& context, void (*lock)(), void (*unlock)(),
+															bool (*enterReadSection)(), void (*exitReadSection)());
 	virtual const char*					findClosestSymbol(const void* addr, const void** closestAddr) const;
+	virtual void						findClosestSymbols(const void* const addrs[], unsigned int count, 
+															const char* names[], const void* closestAddrs[]) const;
 	virtual	void						initializeCoalIterator(CoalIterator&, unsigned int loadOrder);
 	virtual	bool						incrementCoalIterator(CoalIterator&);
 	virtual	uintptr_t					getAddressCoalIterator(CoalIterator&, const LinkContext& contex);
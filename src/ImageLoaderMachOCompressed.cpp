@@ -38,8 +38,10 @@
 #include <mach/mach.h>
 #include <mach/thread_status.h>
 #include <mach-o/loader.h> 
+#include <libkern/OSAtomic.h>
 #include "ImageLoaderMachOCompressed.h"
 #include "mach-o/dyld_images.h"
+#include "dyld_trie_walk.h"
 
 #ifndef EXPORT_SYMBOL_FLAGS_KIND_ABSOLUTE
 	#define EXPORT_SYMBOL_FLAGS_KIND_ABSOLUTE			0x02
@@ -282,12 +284,14 @@ ImageLoaderMachOCompressed* ImageLoaderMachOCompressed::instantiateFromMemory(co
 
 ImageLoaderMachOCompressed::ImageLoaderMachOCompressed(const macho_header* mh, const char* path, unsigned int segCount, 
 																		uint32_t segOffsets[], unsigned int libCount)
- : ImageLoaderMachO(mh, path, segCount, segOffsets, libCount), fDyldInfo(NULL)
+ : ImageLoaderMachO(mh, path, segCount, segOffsets, libCount), fDyldInfo(NULL), 
+	fBindSymbols(NULL), fBindRecords(NULL), fBindSymbolCount(0), fBindRecordCount(0), fBindSymbolCapacity(0), fBindRecordCapacity(0)
 {
 }
 
 ImageLoaderMachOCompressed::~ImageLoaderMachOCompressed()
 {
+	releaseDecodedBindInfo();
 	// don't do clean up in ~ImageLoaderMachO() because virtual call to segmentCommandOffsets() won't work
 	destroy();
 }
@@ -299,7 +303,9 @@ ImageLoaderMachOCompressed* ImageLoaderMachOCompressed::instantiateStart(const m
 																			unsigned int segCount, unsigned int libCount)
 {
 	size_t size = sizeof(ImageLoaderMachOCompressed) + segCount * sizeof(uint32_t) + libCount * sizeof(ImageLoader*);
-	ImageLoaderMachOCompressed* allocatedSpace = static_cast<ImageLoaderMachOCompressed*>(malloc(size));
+	ImageLoaderMachOCompressed* allocatedSpace = static_cast<ImageLoaderMachOCompressed*>(allocateInArena(size));
+	if ( allocatedSpace == NULL )
+		allocatedSpace = static_cast<ImageLoaderMachOCompressed*>(malloc(size));
 	if ( allocatedSpace == NULL )
 		throw "malloc failed";
 	uint32_t* segOffsets = ((uint32_t*)(((uint8_t*)allocatedSpace) + sizeof(ImageLoaderMachOCompressed)));
@@ -532,64 +538,12 @@ void ImageLoaderMachOCompressed::rebase(const LinkContext& context)
 //
 const uint8_t* ImageLoaderMachOCompressed::trieWalk(const uint8_t* start, const uint8_t* end, const char* s)
 {
-	const uint8_t* p = start;
-	while ( p != NULL ) {
-		uintptr_t terminalSize = *p++;
-		if ( terminalSize > 127 ) {
-			// except for re-export-with-rename, all terminal sizes fit in one byte
-			--p;
-			terminalSize = read_uleb128(p, end);
-		}
-		if ( (*s == '\0') && (terminalSize != 0) ) {
-			//dyld::log("trieWalk(%p) returning %p\n", start, p);
-			return p;
-		}
-		const uint8_t* children = p + terminalSize;
-		//dyld::log("trieWalk(%p) sym=%s, terminalSize=%d, children=%p\n", start, s, terminalSize, children);
-		uint8_t childrenRemaining = *children++;
-		p = children;
-		uintptr_t nodeOffset = 0;
-		for (; childrenRemaining > 0; --childrenRemaining) {
-			const char* ss = s;
-			//dyld::log("trieWalk(%p) child str=%s\n", start, (char*)p);
-			bool wrongEdge = false;
-			// scan whole edge to get to next edge
-			// if edge is longer than target symbol name, don't read past end of symbol name
-			char c = *p;
-			while ( c != '\0' ) {
-				if ( !wrongEdge ) {
-					if ( c != *ss )
-						wrongEdge = true;
-					++ss;
-				}
-				++p;
-				c = *p;
-			}
-			if ( wrongEdge ) {
-				// advance to next child
-				++p; // skip over zero terminator
-				// skip over uleb128 until last byte is found
-				while ( (*p & 0x80) != 0 )
-					++p;
-				++p; // skil over last byte of uleb128
-			}
-			else {
- 				// the symbol so far matches this edge (child)
-				// so advance to the child's node
-				++p;
-				nodeOffset = read_uleb128(p, end);
-				s = ss;
-				//dyld::log("trieWalk() found matching edge advancing to node 0x%x\n", nodeOffset);
-				break;
-			}
-		}
-		if ( nodeOffset != 0 )
-			p = &start[nodeOffset];
-		else
-			p = NULL;
-	}
-	//dyld::log("trieWalk(%p) return NULL\n", start);
-	return NULL;
+	// vectorized where SSE2/NEON is available, see dyld_trie_walk.h
+	bool malformed = false;
+	const uint8_t* result = dyld_trie_walk(start, end, s, &malformed);
+	if ( malformed )
+		dyld::throwf("malformed uleb128");
+	return result;
 }
 
 
@@ -637,6 +591,14 @@ const ImageLoader::Symbol* ImageLoaderMachOCompressed::findExportedSymbol(const
 }
 
 
+bool ImageLoaderMachOCompressed::getExportTrie(const uint8_t** start, const uint8_t** end) const
+{
+	*start = &fLinkEditBase[fDyldInfo->export_off];
+	*end = &(*start)[fDyldInfo->export_size];
+	return true;
+}
+
+
 bool ImageLoaderMachOCompressed::containsSymbol(const void* addr) const
 {
 	const uint8_t* start = &fLinkEditBase[fDyldInfo->export_off];
@@ -788,20 +750,52 @@ uintptr_t ImageLoaderMachOCompressed::resolveTwolevel(const LinkContext& context
 }
 
 
+//
+// Symbol names passed to resolve() point into the bind info of the image being bound, so
+// the (ordinal, name pointer) pair identifies a lookup without comparing strings.  The cache
+// is shared by every image bound by one link() and ordinals are per image, so entries also
+// record which image looked the symbol up.
+// Returns the matching entry, or the entry to fill in after resolving.
+// When the probe sequence is full the first slot probed is reused.
+//
+ImageLoader::ResolveCacheEntry* ImageLoaderMachOCompressed::resolveCacheSlot(ResolveCache* cache, const char* symbolName, 
+																		uint8_t symboFlags, long libraryOrdinal, bool* found) const
+{
+	uintptr_t h = ((uintptr_t)symbolName ^ ((uintptr_t)libraryOrdinal << 4)) * 2654435761U;
+	h ^= (h >> 16);
+	ResolveCacheEntry* home = &cache->entries[h & (kResolveCacheSize-1)];
+	for (unsigned int i=0; i < kResolveCacheMaxProbe; ++i) {
+		ResolveCacheEntry* entry = &cache->entries[(h+i) & (kResolveCacheSize-1)];
+		if ( entry->name == NULL ) {
+			*found = false;
+			return entry;
+		}
+		if ( (entry->name == symbolName) && (entry->ordinal == libraryOrdinal) && (entry->flags == symboFlags) && (entry->requestor == this) ) {
+			*found = true;
+			return entry;
+		}
+	}
+	*found = false;
+	return home;
+}
+
 uintptr_t ImageLoaderMachOCompressed::resolve(const LinkContext& context, const char* symbolName, 
 													uint8_t symboFlags, long libraryOrdinal, const ImageLoader** targetImage,
-													LastLookup* last, bool runResolver)
+													ResolveCache* cache, bool runResolver)
 {
 	*targetImage = NULL;
 	
-	// only clients that benefit from caching last lookup pass in a LastLookup struct
-	if ( last != NULL ) {
-		if ( (last->ordinal == libraryOrdinal)
-			&& (last->flags == symboFlags)
-			&& (last->name == symbolName) ) {
-				*targetImage = last->foundIn;
-				return last->result;
-			}
+	// only clients that benefit from caching lookups pass in a ResolveCache
+	ResolveCacheEntry* cacheSlot = NULL;
+	if ( cache != NULL ) {
+		bool found;
+		cacheSlot = resolveCacheSlot(cache, symbolName, symboFlags, libraryOrdinal, &found);
+		++fgTotalBindCacheLookups;
+		if ( found ) {
+			++fgTotalBindCacheHits;
+			*targetImage = cacheSlot->foundIn;
+			return cacheSlot->result;
+		}
 	}
 	
 	bool weak_import = (symboFlags & BIND_SYMBOL_FLAGS_WEAK_IMPORT);
@@ -843,12 +837,13 @@ uintptr_t ImageLoaderMachOCompressed::resolve(const LinkContext& context, const
 	}
 	
 	// save off lookup results if client wants 
-	if ( last != NULL ) {
-		last->ordinal	= libraryOrdinal;
-		last->flags		= symboFlags;
-		last->name		= symbolName;
-		last->foundIn	= *targetImage;
-		last->result	= symbolAddress;
+	if ( cacheSlot != NULL ) {
+		cacheSlot->ordinal	= libraryOrdinal;
+		cacheSlot->flags	= symboFlags;
+		cacheSlot->name		= symbolName;
+		cacheSlot->requestor	= this;
+		cacheSlot->foundIn	= *targetImage;
+		cacheSlot->result	= symbolAddress;
 	}
 	
 	return symbolAddress;
@@ -856,16 +851,22 @@ uintptr_t ImageLoaderMachOCompressed::resolve(const LinkContext& context, const
 
 uintptr_t ImageLoaderMachOCompressed::bindAt(const LinkContext& context, uintptr_t addr, uint8_t type, const char* symbolName, 
 								uint8_t symboFlags, intptr_t addend, long libraryOrdinal, const char* msg, 
-								LastLookup* last, bool runResolver)
+								ResolveCache* cache, bool runResolver)
 {
 	const ImageLoader*	targetImage;
 	uintptr_t			symbolAddress;
 	
 	// resolve symbol
-	symbolAddress = this->resolve(context, symbolName, symboFlags, libraryOrdinal, &targetImage, last, runResolver);
+	symbolAddress = this->resolve(context, symbolName, symboFlags, libraryOrdinal, &targetImage, cache, runResolver);
 
 	// do actual update
-	return this->bindLocation(context, addr, symbolAddress, targetImage, type, symbolName, addend, msg);
+	uintptr_t newValue = this->bindLocation(context, addr, symbolAddress, targetImage, type, symbolName, addend, msg);
+
+	// remember final value if a launch closure is being recorded
+	if ( context.linkingMainExecutable && (context.recordLaunchClosureBind != NULL) )
+		(*context.recordLaunchClosureBind)(this, addr, newValue, targetImage, type);
+
+	return newValue;
 }
 
 void ImageLoaderMachOCompressed::throwBadBindingAddress(uintptr_t address, uintptr_t segmentEndAddress, int segmentIndex, 
@@ -877,7 +878,7 @@ void ImageLoaderMachOCompressed::throwBadBindingAddress(uintptr_t address, uintp
 }
 
 
-void ImageLoaderMachOCompressed::doBind(const LinkContext& context, bool forceLazysBound)
+void ImageLoaderMachOCompressed::doBind(const LinkContext& context, bool forceLazysBound, ResolveCache* cache)
 {
 	CRSetCrashLogMessage2(this->getPath());
 
@@ -887,26 +888,50 @@ void ImageLoaderMachOCompressed::doBind(const LinkContext& context, bool forceLa
 		// don't need to bind
 	}
 	else {
-	
-	#if TEXT_RELOC_SUPPORT
-		// if there are __TEXT fixups, temporarily make __TEXT writable
-		if ( fTextSegmentBinds ) 
-			this->makeTextSegmentWritable(context, true);
-	#endif
-	
-		// run through all binding opcodes
-		eachBind(context, &ImageLoaderMachOCompressed::bindAt);
-			
-	#if TEXT_RELOC_SUPPORT
-		// if there were __TEXT fixups, restore write protection
-		if ( fTextSegmentBinds ) 
-			this->makeTextSegmentWritable(context, false);
-	#endif	
-	
 		// if this image is in the shared cache, but depends on something no longer in the shared cache,
 		// there is no way to reset the lazy pointers, so force bind them now
-		if ( forceLazysBound || fInSharedCache ) 
-			this->doBindJustLazies(context);
+		const bool bindLazys = ( forceLazysBound || fInSharedCache );
+		
+		// at launch, a launch closure that still matches the loaded images has the final value of every pointer
+		// (__TEXT binds are not recorded, so those images are always bound normally)
+	#if TEXT_RELOC_SUPPORT
+		const bool textBinds = fTextSegmentBinds;
+	#else
+		const bool textBinds = false;
+	#endif
+		uint32_t closureFixups = 0;
+		if ( context.linkingMainExecutable && !textBinds && (context.applyLaunchClosureBinds != NULL) 
+				&& (*context.applyLaunchClosureBinds)(this, bindLazys, &closureFixups) ) {
+			fgTotalBindFixups += closureFixups;
+			fgTotalLaunchClosureFixups += closureFixups;
+			++fgImagesBoundFromLaunchClosure;
+		}
+		else {
+		#if TEXT_RELOC_SUPPORT
+			// if there are __TEXT fixups, temporarily make __TEXT writable
+			if ( fTextSegmentBinds ) 
+				this->makeTextSegmentWritable(context, true);
+		#endif
+		
+			// decode bind info only if an interposing pass will follow and reuse it
+			if ( (fgInterposingTuples.size() != 0) || (context.linkingMainExecutable && context.insertedLibraries) )
+				this->decodeBindInfo(context);
+
+			// bind each decoded symbol once, or run through all binding opcodes
+			if ( fBindRecords != NULL )
+				this->bindDecoded(context);
+			else
+				eachBind(context, &ImageLoaderMachOCompressed::bindAt, cache);
+				
+		#if TEXT_RELOC_SUPPORT
+			// if there were __TEXT fixups, restore write protection
+			if ( fTextSegmentBinds ) 
+				this->makeTextSegmentWritable(context, false);
+		#endif	
+		
+			if ( bindLazys ) 
+				this->doBindJustLazies(context, cache);
+		}
             
 		// this image is in cache, but something below it is not.  If
         // this image has lazy pointer to a resolver function, then
@@ -926,12 +951,207 @@ void ImageLoaderMachOCompressed::doBind(const LinkContext& context, bool forceLa
 }
 
 
-void ImageLoaderMachOCompressed::doBindJustLazies(const LinkContext& context)
+void ImageLoaderMachOCompressed::doBindJustLazies(const LinkContext& context, ResolveCache* cache)
+{
+	eachLazyBind(context, &ImageLoaderMachOCompressed::bindAt, cache);
+}
+
+//
+// When an interposing pass will follow binding, the (non-lazy) bind opcodes are
+// decoded once into BindRecords grouped by BindSymbol.  Binding then resolves each 
+// unique symbol once and stores to all of its locations, and the interposing passes
+// (including any later dyld_dynamic_interpose()) walk the table instead of re-parsing 
+// LINKEDIT.  The table lives until the image is destroyed.  Otherwise eachBind() just 
+// streams the opcodes.
+//
+void ImageLoaderMachOCompressed::decodeBindInfo(const LinkContext& context)
+{
+	if ( fBindRecords != NULL )
+		return;
+	try {
+		eachBindOpcode(context, &ImageLoaderMachOCompressed::recordBindAt, NULL);
+		this->groupDecodedBindInfo();
+	}
+	catch (...) {
+		this->releaseDecodedBindInfo();
+		throw;
+	}
+}
+
+uintptr_t ImageLoaderMachOCompressed::recordBindAt(const LinkContext& context, uintptr_t addr, uint8_t type, const char* symbolName, 
+								uint8_t symboFlags, intptr_t addend, long libraryOrdinal, const char* msg, 
+								ResolveCache* cache, bool runResolver)
+{
+	// binds of one symbol are usually adjacent in the opcodes, so only start a new symbol when it changes
+	// (repeats elsewhere in the opcodes are merged by groupDecodedBindInfo())
+	const BindSymbol* last = (fBindSymbolCount != 0) ? &fBindSymbols[fBindSymbolCount-1] : NULL;
+	if ( (last == NULL) || (last->name != symbolName) || (last->libraryOrdinal != libraryOrdinal) || (last->flags != symboFlags) ) {
+		if ( fBindSymbolCount == fBindSymbolCapacity ) {
+			uint32_t newCapacity = (fBindSymbolCapacity == 0) ? 32 : 2*fBindSymbolCapacity;
+			BindSymbol* newSymbols = (BindSymbol*)realloc(fBindSymbols, newCapacity*sizeof(BindSymbol));
+			if ( newSymbols == NULL )
+				throw "malloc failure decoding bind info";
+			fBindSymbols = newSymbols;
+			fBindSymbolCapacity = newCapacity;
+		}
+		BindSymbol& sym = fBindSymbols[fBindSymbolCount++];
+		sym.name			= symbolName;
+		sym.libraryOrdinal	= libraryOrdinal;
+		sym.firstRecord		= 0;
+		sym.recordCount		= 0;
+		sym.flags			= symboFlags;
+	}
+	if ( fBindRecordCount == fBindRecordCapacity ) {
+		uint32_t newCapacity = (fBindRecordCapacity == 0) ? 64 : 2*fBindRecordCapacity;
+		BindRecord* newRecords = (BindRecord*)realloc(fBindRecords, newCapacity*sizeof(BindRecord));
+		if ( newRecords == NULL )
+			throw "malloc failure decoding bind info";
+		fBindRecords = newRecords;
+		fBindRecordCapacity = newCapacity;
+	}
+	BindRecord& rec = fBindRecords[fBindRecordCount++];
+	rec.address			= addr;
+	rec.addend			= addend;
+	rec.symbolIndex		= fBindSymbolCount-1;
+	rec.type			= type;
+	return 0;
+}
+
+//
+// Merges BindSymbols with the same name, ordinal and flags, then reorders the BindRecords 
+// so each symbol's records are contiguous.  Symbols stay in the order they first appear 
+// in the opcodes and records stay in opcode order within a symbol, so binding reports 
+// the same missing symbol first as streaming the opcodes does.
+//
+void ImageLoaderMachOCompressed::groupDecodedBindInfo()
+{
+	if ( fBindRecordCount == 0 )
+		return;
+	uint32_t hashSize = 64;
+	while ( hashSize < 2*fBindSymbolCount )
+		hashSize *= 2;
+	uint32_t* hashTable = (uint32_t*)calloc(hashSize, sizeof(uint32_t));	// unique symbol index + 1, 0 is empty
+	uint32_t* remap = (uint32_t*)malloc(fBindSymbolCount*sizeof(uint32_t));
+	BindRecord* grouped = (BindRecord*)malloc(fBindRecordCount*sizeof(BindRecord));
+	if ( (hashTable == NULL) || (remap == NULL) || (grouped == NULL) ) {
+		free(hashTable);
+		free(remap);
+		free(grouped);
+		throw "malloc failure decoding bind info";
+	}
+	
+	// compact unique symbols to the front of fBindSymbols
+	uint32_t uniqueCount = 0;
+	for (uint32_t i=0; i < fBindSymbolCount; ++i) {
+		const BindSymbol sym = fBindSymbols[i];
+		uint32_t h = (uint32_t)sym.libraryOrdinal * 31 + sym.flags;
+		for (const char* s=sym.name; *s != '\0'; ++s)
+			h = h*33 + (uint8_t)*s;
+		for (uint32_t slot=(h & (hashSize-1)); ; slot = ((slot+1) & (hashSize-1))) {
+			if ( hashTable[slot] == 0 ) {
+				fBindSymbols[uniqueCount] = sym;
+				remap[i] = uniqueCount++;
+				hashTable[slot] = uniqueCount;
+				break;
+			}
+			const BindSymbol& other = fBindSymbols[hashTable[slot]-1];
+			if ( (other.libraryOrdinal == sym.libraryOrdinal) && (other.flags == sym.flags) 
+					&& ((other.name == sym.name) || (strcmp(other.name, sym.name) == 0)) ) {
+				remap[i] = hashTable[slot]-1;
+				break;
+			}
+		}
+	}
+	fBindSymbolCount = uniqueCount;
+	
+	// counting sort of records by unique symbol
+	for (uint32_t i=0; i < fBindRecordCount; ++i) {
+		fBindRecords[i].symbolIndex = remap[fBindRecords[i].symbolIndex];
+		++fBindSymbols[fBindRecords[i].symbolIndex].recordCount;
+	}
+	uint32_t next = 0;
+	for (uint32_t i=0; i < fBindSymbolCount; ++i) {
+		fBindSymbols[i].firstRecord = next;
+		next += fBindSymbols[i].recordCount;
+		fBindSymbols[i].recordCount = 0;
+	}
+	for (uint32_t i=0; i < fBindRecordCount; ++i) {
+		BindSymbol& sym = fBindSymbols[fBindRecords[i].symbolIndex];
+		grouped[sym.firstRecord + sym.recordCount++] = fBindRecords[i];
+	}
+	free(hashTable);
+	free(remap);
+	free(fBindRecords);
+	fBindRecords = grouped;
+	fBindRecordCapacity = fBindRecordCount;
+}
+
+void ImageLoaderMachOCompressed::bindDecoded(const LinkContext& context)
+{
+	const BindRecord* rec = NULL;
+	try {
+		for (uint32_t i=0; i < fBindSymbolCount; ++i) {
+			const BindSymbol& sym = fBindSymbols[i];
+			rec = &fBindRecords[sym.firstRecord];
+			// symbols are already unique, so resolve without a ResolveCache
+			const ImageLoader* targetImage;
+			uintptr_t symbolAddress = this->resolve(context, sym.name, sym.flags, sym.libraryOrdinal, &targetImage, NULL, false);
+			// then store to all locations bound to it
+			const BindRecord* const end = &fBindRecords[sym.firstRecord + sym.recordCount];
+			for ( ; rec < end; ++rec) {
+				uintptr_t newValue = this->bindLocation(context, rec->address, symbolAddress, targetImage, rec->type, sym.name, rec->addend, "");
+				// remember final value if a launch closure is being recorded
+				if ( context.linkingMainExecutable && (context.recordLaunchClosureBind != NULL) )
+					(*context.recordLaunchClosureBind)(this, rec->address, newValue, targetImage, rec->type);
+			}
+		}
+	}
+	catch (const char* msg) {
+		const char* newMsg = dyld::mkstringf("%s (binding 0x%08lX) in %s", msg, (rec != NULL) ? rec->address : 0, this->getPath());
+		free((void*)msg);
+		throw newMsg;
+	}
+}
+
+void ImageLoaderMachOCompressed::releaseDecodedBindInfo()
+{
+	if ( fBindSymbols != NULL ) {
+		free(fBindSymbols);
+		fBindSymbols = NULL;
+	}
+	if ( fBindRecords != NULL ) {
+		free(fBindRecords);
+		fBindRecords = NULL;
+	}
+	fBindSymbolCount = 0;
+	fBindRecordCount = 0;
+	fBindSymbolCapacity = 0;
+	fBindRecordCapacity = 0;
+}
+
+void ImageLoaderMachOCompressed::eachBind(const LinkContext& context, bind_handler handler, ResolveCache* cache)
 {
-	eachLazyBind(context, &ImageLoaderMachOCompressed::bindAt);
+	if ( fBindRecords == NULL ) {
+		eachBindOpcode(context, handler, cache);
+		return;
+	}
+	const BindRecord* rec = NULL;
+	try {
+		for (uint32_t i=0; i < fBindSymbolCount; ++i) {
+			const BindSymbol& sym = fBindSymbols[i];
+			const BindRecord* const end = &fBindRecords[sym.firstRecord + sym.recordCount];
+			for (rec=&fBindRecords[sym.firstRecord]; rec < end; ++rec)
+				(this->*handler)(context, rec->address, rec->type, sym.name, sym.flags, rec->addend, sym.libraryOrdinal, "", cache, false);
+		}
+	}
+	catch (const char* msg) {
+		const char* newMsg = dyld::mkstringf("%s (binding 0x%08lX) in %s", msg, (rec != NULL) ? rec->address : 0, this->getPath());
+		free((void*)msg);
+		throw newMsg;
+	}
 }
 
-void ImageLoaderMachOCompressed::eachBind(const LinkContext& context, bind_handler handler)
+void ImageLoaderMachOCompressed::eachBindOpcode(const LinkContext& context, bind_handler handler, ResolveCache* cache)
 {
 	try {
 		uint8_t type = 0;
@@ -944,7 +1164,6 @@ void ImageLoaderMachOCompressed::eachBind(const LinkContext& context, bind_handl
 		intptr_t addend = 0;
 		uintptr_t count;
 		uintptr_t skip;
-		LastLookup last = { 0, 0, NULL, 0, NULL };
 		const uint8_t* const start = fLinkEditBase + fDyldInfo->bind_off;
 		const uint8_t* const end = &start[fDyldInfo->bind_size];
 		const uint8_t* p = start;
@@ -999,19 +1218,19 @@ void ImageLoaderMachOCompressed::eachBind(const LinkContext& context, bind_handl
 				case BIND_OPCODE_DO_BIND:
 					if ( address >= segmentEndAddress ) 
 						throwBadBindingAddress(address, segmentEndAddress, segmentIndex, start, end, p);
-					(this->*handler)(context, address, type, symbolName, symboFlags, addend, libraryOrdinal, "", &last, false);
+					(this->*handler)(context, address, type, symbolName, symboFlags, addend, libraryOrdinal, "", cache, false);
 					address += sizeof(intptr_t);
 					break;
 				case BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB:
 					if ( address >= segmentEndAddress ) 
 						throwBadBindingAddress(address, segmentEndAddress, segmentIndex, start, end, p);
-					(this->*handler)(context, address, type, symbolName, symboFlags, addend, libraryOrdinal, "", &last, false);
+					(this->*handler)(context, address, type, symbolName, symboFlags, addend, libraryOrdinal, "", cache, false);
 					address += read_uleb128(p, end) + sizeof(intptr_t);
 					break;
 				case BIND_OPCODE_DO_BIND_ADD_ADDR_IMM_SCALED:
 					if ( address >= segmentEndAddress ) 
 						throwBadBindingAddress(address, segmentEndAddress, segmentIndex, start, end, p);
-					(this->*handler)(context, address, type, symbolName, symboFlags, addend, libraryOrdinal, "", &last, false);
+					(this->*handler)(context, address, type, symbolName, symboFlags, addend, libraryOrdinal, "", cache, false);
 					address += immediate*sizeof(intptr_t) + sizeof(intptr_t);
 					break;
 				case BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB:
@@ -1020,7 +1239,7 @@ void ImageLoaderMachOCompressed::eachBind(const LinkContext& context, bind_handl
 					for (uint32_t i=0; i < count; ++i) {
 						if ( address >= segmentEndAddress ) 
 							throwBadBindingAddress(address, segmentEndAddress, segmentIndex, start, end, p);
-						(this->*handler)(context, address, type, symbolName, symboFlags, addend, libraryOrdinal, "", &last, false);
+						(this->*handler)(context, address, type, symbolName, symboFlags, addend, libraryOrdinal, "", cache, false);
 						address += skip + sizeof(intptr_t);
 					}
 					break;
@@ -1036,7 +1255,7 @@ void ImageLoaderMachOCompressed::eachBind(const LinkContext& context, bind_handl
 	}
 }
 
-void ImageLoaderMachOCompressed::eachLazyBind(const LinkContext& context, bind_handler handler)
+void ImageLoaderMachOCompressed::eachLazyBind(const LinkContext& context, bind_handler handler, ResolveCache* cache)
 {
 	try {
 		uint8_t type = BIND_TYPE_POINTER;
@@ -1101,7 +1320,7 @@ void ImageLoaderMachOCompressed::eachLazyBind(const LinkContext& context, bind_h
 				case BIND_OPCODE_DO_BIND:
 					if ( address >= segmentEndAddress ) 
 						throwBadBindingAddress(address, segmentEndAddress, segmentIndex, start, end, p);
-					(this->*handler)(context, address, type, symbolName, symboFlags, addend, libraryOrdinal, "forced lazy ", NULL, false);
+					(this->*handler)(context, address, type, symbolName, symboFlags, addend, libraryOrdinal, "forced lazy ", cache, false);
 					address += sizeof(intptr_t);
 					break;
 				case BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB:
@@ -1194,17 +1413,59 @@ uintptr_t ImageLoaderMachOCompressed::doBindLazySymbol(uintptr_t* lazyPointer, c
 }
 
 
+//
+// Lazy pointers are bound without the global lock, so several threads can bind the same
+// one at once.  Each resolves the target, then swaps it in only if the lazy pointer still
+// holds the value it saw on entry.  The loser returns the winner's value, so every thread
+// jumps to the same definition and the lazy pointer is written at most once.
+//
+uintptr_t ImageLoaderMachOCompressed::bindLazyPointer(const LinkContext& context, uintptr_t addr, uint8_t type, const char* symbolName, 
+														uint8_t symboFlags, long libraryOrdinal)
+{
+	if ( (type != BIND_TYPE_POINTER) || context.linkingMainExecutable )
+		return this->bindAt(context, addr, type, symbolName, symboFlags, 0, libraryOrdinal, "lazy ", NULL, true);
+
+	uintptr_t* lazyPointer = (uintptr_t*)addr;
+	uintptr_t unboundValue = *lazyPointer;
+	const ImageLoader* targetImage;
+	uintptr_t symbolAddress = this->resolve(context, symbolName, symboFlags, libraryOrdinal, &targetImage, NULL, true);
+	if ( (unboundValue != symbolAddress)
+		&& !OSAtomicCompareAndSwapPtrBarrier((void*)unboundValue, (void*)symbolAddress, (void* volatile*)lazyPointer) ) {
+		// another thread bound (or interposed) this lazy pointer first
+		return *lazyPointer;
+	}
+	if ( context.verboseBind ) {
+		dyld::log("dyld: lazy bind: %s:0x%08lX = %s:%s, *0x%08lX = 0x%08lX\n",
+					this->getShortName(), addr,
+					((targetImage != NULL) ? targetImage->getShortName() : "<weak_import-missing>"),
+					symbolName, addr, symbolAddress);
+	}
+	++fgTotalBindFixups;
+	return symbolAddress;
+}
+
+
 uintptr_t ImageLoaderMachOCompressed::doBindFastLazySymbol(uint32_t lazyBindingInfoOffset, const LinkContext& context,
-															void (*lock)(), void (*unlock)())
+															void (*lock)(), void (*unlock)(),
+															bool (*enterReadSection)(), void (*exitReadSection)())
 {
 	// <rdar://problem/8663923> race condition with flat-namespace lazy binding
+	bool inReadSection = false;
+	bool locked = false;
 	if ( this->usesTwoLevelNameSpace() ) {
 		// two-level namespace lookup does not require lock because dependents can't be unloaded before this image
 	}
 	else {
-		// acquire dyld global lock
-		if ( lock != NULL )
+		// flat lookups walk all images, so the image list must not change during the lookup.
+		// A read section guarantees that without serializing binders.  If a load or unload
+		// is in progress, wait for it on the dyld global lock instead.
+		if ( (enterReadSection != NULL) && (*enterReadSection)() ) {
+			inReadSection = true;
+		}
+		else if ( lock != NULL ) {
 			lock();
+			locked = true;
+		}
 	}
 	
 	const uint8_t* const start = fLinkEditBase + fDyldInfo->lazy_bind_off;
@@ -1264,7 +1525,7 @@ uintptr_t ImageLoaderMachOCompressed::doBindFastLazySymbol(uint32_t lazyBindingI
 			case BIND_OPCODE_DO_BIND:
 				
 			
-				result = this->bindAt(context, address, type, symbolName, 0, 0, libraryOrdinal, "lazy ", NULL, true);
+				result = this->bindLazyPointer(context, address, type, symbolName, 0, libraryOrdinal);
 				break;
 			case BIND_OPCODE_SET_ADDEND_SLEB:
 			case BIND_OPCODE_ADD_ADDR_ULEB:
@@ -1276,11 +1537,10 @@ uintptr_t ImageLoaderMachOCompressed::doBindFastLazySymbol(uint32_t lazyBindingI
 		}
 	}	
 	
-	if ( !this->usesTwoLevelNameSpace() ) {
-		// release dyld global lock
-		if ( unlock != NULL )
-			unlock();
-	}
+	if ( inReadSection )
+		(*exitReadSection)();
+	else if ( locked )
+		unlock();
 	return result;
 }
 
@@ -1468,7 +1728,7 @@ void ImageLoaderMachOCompressed::updateUsesCoalIterator(CoalIterator& it, uintpt
 }
 
 uintptr_t ImageLoaderMachOCompressed::interposeAt(const LinkContext& context, uintptr_t addr, uint8_t type, const char*, 
-												uint8_t, intptr_t, long, const char*, LastLookup*, bool runResolver)
+												uint8_t, intptr_t, long, const char*, ResolveCache*, bool runResolver)
 {
 	if ( type == BIND_TYPE_POINTER ) {
 		uintptr_t* fixupLocation = (uintptr_t*)addr;
@@ -1492,7 +1752,7 @@ void ImageLoaderMachOCompressed::doInterpose(const LinkContext& context)
 
 
 uintptr_t ImageLoaderMachOCompressed::dynamicInterposeAt(const LinkContext& context, uintptr_t addr, uint8_t type, const char* symbolName, 
-												uint8_t, intptr_t, long, const char*, LastLookup*, bool runResolver)
+												uint8_t, intptr_t, long, const char*, ResolveCache*, bool runResolver)
 {
 	if ( type == BIND_TYPE_POINTER ) {
 		uintptr_t* fixupLocation = (uintptr_t*)addr;
@@ -1524,13 +1784,13 @@ void ImageLoaderMachOCompressed::dynamicInterpose(const LinkContext& context)
 }
 
 
-const char* ImageLoaderMachOCompressed::findClosestSymbol(const void* addr, const void** closestAddr) const
+bool ImageLoaderMachOCompressed::getSymbolTable(const macho_nlist** symbolTable, const char** symbolTableStrings, 
+												const dysymtab_command** dynSymbolTable) const
 {
-	// called by dladdr()
 	// only works with compressed LINKEDIT if classic symbol table is also present
-	const macho_nlist* symbolTable = NULL;
-	const char* symbolTableStrings = NULL;
-	const dysymtab_command* dynSymbolTable = NULL;
+	*symbolTable = NULL;
+	*symbolTableStrings = NULL;
+	*dynSymbolTable = NULL;
 	const uint32_t cmd_count = ((macho_header*)fMachOData)->ncmds;
 	const struct load_command* const cmds = (struct load_command*)&fMachOData[sizeof(macho_header)];
 	const struct load_command* cmd = cmds;
@@ -1539,62 +1799,47 @@ const char* ImageLoaderMachOCompressed::findClosestSymbol(const void* addr, cons
 			case LC_SYMTAB:
 				{
 					const struct symtab_command* symtab = (struct symtab_command*)cmd;
-					symbolTableStrings = (const char*)&fLinkEditBase[symtab->stroff];
-					symbolTable = (macho_nlist*)(&fLinkEditBase[symtab->symoff]);
+					*symbolTableStrings = (const char*)&fLinkEditBase[symtab->stroff];
+					*symbolTable = (macho_nlist*)(&fLinkEditBase[symtab->symoff]);
 				}
 				break;
 			case LC_DYSYMTAB:
-				dynSymbolTable = (struct dysymtab_command*)cmd;
+				*dynSymbolTable = (struct dysymtab_command*)cmd;
 				break;
 		}
 		cmd = (const struct load_command*)(((char*)cmd)+cmd->cmdsize);
 	}
+	return ( (*symbolTable != NULL) && (*dynSymbolTable != NULL) );
+}
+
+const char* ImageLoaderMachOCompressed::findClosestSymbol(const void* addr, const void** closestAddr) const
+{
+	// called by dladdr()
+	const macho_nlist* symbolTable;
+	const char* symbolTableStrings;
+	const dysymtab_command* dynSymbolTable;
 	// no symbol table => no lookup by address
-	if ( (symbolTable == NULL) || (dynSymbolTable == NULL) )
+	if ( !this->getSymbolTable(&symbolTable, &symbolTableStrings, &dynSymbolTable) )
 		return NULL;
 
-	uintptr_t targetAddress = (uintptr_t)addr - fSlide;
-	const struct macho_nlist* bestSymbol = NULL;
-	// first walk all global symbols
-	const struct macho_nlist* const globalsStart = &symbolTable[dynSymbolTable->iextdefsym];
-	const struct macho_nlist* const globalsEnd= &globalsStart[dynSymbolTable->nextdefsym];
-	for (const struct macho_nlist* s = globalsStart; s < globalsEnd; ++s) {
- 		if ( (s->n_type & N_TYPE) == N_SECT ) {
-			if ( bestSymbol == NULL ) {
-				if ( s->n_value <= targetAddress )
-					bestSymbol = s;
-			}
-			else if ( (s->n_value <= targetAddress) && (bestSymbol->n_value < s->n_value) ) {
-				bestSymbol = s;
-			}
-		}
-	}
-	// next walk all local symbols
-	const struct macho_nlist* const localsStart = &symbolTable[dynSymbolTable->ilocalsym];
-	const struct macho_nlist* const localsEnd= &localsStart[dynSymbolTable->nlocalsym];
-	for (const struct macho_nlist* s = localsStart; s < localsEnd; ++s) {
- 		if ( ((s->n_type & N_TYPE) == N_SECT) && ((s->n_type & N_STAB) == 0) ) {
-			if ( bestSymbol == NULL ) {
-				if ( s->n_value <= targetAddress )
-					bestSymbol = s;
-			}
-			else if ( (s->n_value <= targetAddress) && (bestSymbol->n_value < s->n_value) ) {
-				bestSymbol = s;
-			}
+	return this->findClosestSymbolIndexed(symbolTable, symbolTableStrings, dynSymbolTable, addr, closestAddr);
+}
+
+void ImageLoaderMachOCompressed::findClosestSymbols(const void* const addrs[], unsigned int count, const char* names[], const void* closestAddrs[]) const
+{
+	// called by dladdr_batch()
+	const macho_nlist* symbolTable;
+	const char* symbolTableStrings;
+	const dysymtab_command* dynSymbolTable;
+	if ( !this->getSymbolTable(&symbolTable, &symbolTableStrings, &dynSymbolTable) ) {
+		for (unsigned int i=0; i < count; ++i) {
+			names[i] = NULL;
+			closestAddrs[i] = NULL;
 		}
+		return;
 	}
-	if ( bestSymbol != NULL ) {
-#if __arm__
-		if (bestSymbol->n_desc & N_ARM_THUMB_DEF)
-			*closestAddr = (void*)((bestSymbol->n_value | 1) + fSlide);
-		else
-			*closestAddr = (void*)(bestSymbol->n_value + fSlide);
-#else
-		*closestAddr = (void*)(bestSymbol->n_value + fSlide);
-#endif
-		return &symbolTableStrings[bestSymbol->n_un.n_strx];
-	}
-	return NULL;
+
+	this->findClosestSymbolsIndexed(symbolTable, symbolTableStrings, dynSymbolTable, addrs, count, names, closestAddrs);
 }
 
 
@@ -57,15 +57,19 @@ public:
 	virtual bool						libReExported(unsigned int) const;
 	virtual bool						libIsUpward(unsigned int) const;
 	virtual void						setLibImage(unsigned int, ImageLoader*, bool, bool);
-	virtual void						doBind(const LinkContext& context, bool forceLazysBound);
-	virtual void						doBindJustLazies(const LinkContext& context);
+	virtual void						doBind(const LinkContext& context, bool forceLazysBound, ResolveCache* cache);
+	virtual void						doBindJustLazies(const LinkContext& context, ResolveCache* cache);
 	virtual uintptr_t					doBindLazySymbol(uintptr_t* lazyPointer, const LinkContext& context);
-	virtual uintptr_t					doBindFastLazySymbol(uint32_t lazyBindingInfoOffset, const LinkContext& context, void (*lock)(), void (*unlock)());
+	virtual uintptr_t					doBindFastLazySymbol(uint32_t lazyBindingInfoOffset, const LinkContext& context, void (*lock)(), void (*unlock)(),
+															bool (*enterReadSection)(), void (*exitReadSection)());
 	virtual const char*					findClosestSymbol(const void* addr, const void** closestAddr) const;
+	virtual void						findClosestSymbols(const void* const addrs[], unsigned int count, 
+															const char* names[], const void* closestAddrs[]) const;
 	virtual	void						initializeCoalIterator(CoalIterator&, unsigned int loadOrder);
 	virtual	bool						incrementCoalIterator(CoalIterator&);
 	virtual	uintptr_t					getAddressCoalIterator(CoalIterator&, const LinkContext& contex);
 	virtual	void						updateUsesCoalIterator(CoalIterator&, uintptr_t newAddr, ImageLoader* target, const LinkContext& context);
+	virtual void						releaseDecodedBindInfo();
 
 	
 protected:
@@ -79,6 +83,7 @@ protected:
 	virtual	void						rebase(const LinkContext& context);
 	virtual const ImageLoader::Symbol*	findExportedSymbol(const char* name, const ImageLoader** foundIn) const;
 	virtual bool						containsSymbol(const void* addr) const;
+	virtual bool						getExportTrie(const uint8_t** start, const uint8_t** end) const;
 	virtual uintptr_t					exportedSymbolAddress(const LinkContext& context, const Symbol* symbol, const ImageLoader* requestor, bool runResolver) const;
 	virtual bool						exportedSymbolIsWeakDefintion(const Symbol* symbol) const;
 	virtual const char*					exportedSymbolName(const Symbol* symbol) const;
@@ -93,15 +98,24 @@ protected:
 
 		
 private:
-	struct LastLookup { long ordinal; uint8_t flags; const char* name; uintptr_t result; const ImageLoader* foundIn; };
+	// one unique symbol in the (non-lazy) bind opcodes and the range of its BindRecords, see decodeBindInfo()
+	struct BindSymbol { const char* name; long libraryOrdinal; uint32_t firstRecord; uint32_t recordCount; uint8_t flags; };
+	// one DO_BIND from the (non-lazy) bind opcodes
+	struct BindRecord { uintptr_t address; intptr_t addend; uint32_t symbolIndex; uint8_t type; };
 
 
 	typedef uintptr_t (ImageLoaderMachOCompressed::*bind_handler)(const LinkContext& context, uintptr_t addr, uint8_t type, 
 											const char* symbolName, uint8_t symboFlags, intptr_t addend, long libraryOrdinal, 
-											const char* msg, LastLookup* last, bool runResolver);
+											const char* msg, ResolveCache* cache, bool runResolver);
 
-	void								eachLazyBind(const LinkContext& context, bind_handler);
-	void								eachBind(const LinkContext& context, bind_handler);
+	void								eachLazyBind(const LinkContext& context, bind_handler, ResolveCache* cache=NULL);
+	void								eachBind(const LinkContext& context, bind_handler, ResolveCache* cache=NULL);
+	void								eachBindOpcode(const LinkContext& context, bind_handler, ResolveCache* cache);
+	void								decodeBindInfo(const LinkContext& context);
+	void								groupDecodedBindInfo();
+	void								bindDecoded(const LinkContext& context);
+	bool								getSymbolTable(const macho_nlist** symbolTable, const char** symbolTableStrings, 
+														const dysymtab_command** dynSymbolTable) const;
 
 
 										ImageLoaderMachOCompressed(const macho_header* mh, const char* path, unsigned int segCount,
@@ -117,28 +131,40 @@ private:
 												const uint8_t* startOpcodes, const uint8_t* endOpcodes, const uint8_t* pos);
 	uintptr_t							bindAt(const LinkContext& context, uintptr_t addr, uint8_t type, const char* symbolName, 
 												uint8_t symboFlags, intptr_t addend, long libraryOrdinal, const char* msg,
-												LastLookup* last, bool runResolver=false);
+												ResolveCache* cache, bool runResolver=false);
+	uintptr_t							recordBindAt(const LinkContext& context, uintptr_t addr, uint8_t type, const char* symbolName, 
+												uint8_t symboFlags, intptr_t addend, long libraryOrdinal, const char* msg,
+												ResolveCache* cache, bool runResolver);
+	uintptr_t							bindLazyPointer(const LinkContext& context, uintptr_t addr, uint8_t type, const char* symbolName, 
+												uint8_t symboFlags, long libraryOrdinal);
 	void								bindCompressed(const LinkContext& context);
 	void								throwBadBindingAddress(uintptr_t address, uintptr_t segmentEndAddress, int segmentIndex, 
 												const uint8_t* startOpcodes, const uint8_t* endOpcodes, const uint8_t* pos);
 	uintptr_t							resolve(const LinkContext& context, const char* symbolName, 
 												uint8_t symboFlags, long libraryOrdinal, const ImageLoader** targetImage, 
-												LastLookup* last = NULL, bool runResolver=false);
+												ResolveCache* cache = NULL, bool runResolver=false);
+	ResolveCacheEntry*					resolveCacheSlot(ResolveCache* cache, const char* symbolName, uint8_t symboFlags, long libraryOrdinal, bool* found) const;
 	uintptr_t							resolveFlat(const LinkContext& context, const char* symbolName, bool weak_import, bool runResolver,
 													const ImageLoader** foundIn);
 	uintptr_t							resolveCoalesced(const LinkContext& context, const char* symbolName, const ImageLoader** foundIn);
 	uintptr_t							resolveTwolevel(const LinkContext& context, const ImageLoader* targetImage, bool weak_import, 
 														const char* symbolName, bool runResolver, const ImageLoader** foundIn);
 	uintptr_t							interposeAt(const LinkContext& context, uintptr_t addr, uint8_t type, const char*, 
-												uint8_t, intptr_t, long, const char*, LastLookup*, bool runResolver);
+												uint8_t, intptr_t, long, const char*, ResolveCache*, bool runResolver);
 	uintptr_t							dynamicInterposeAt(const LinkContext& context, uintptr_t addr, uint8_t type, const char*, 
-												uint8_t, intptr_t, long, const char*, LastLookup*, bool runResolver);
+												uint8_t, intptr_t, long, const char*, ResolveCache*, bool runResolver);
 	static const uint8_t*				trieWalk(const uint8_t* start, const uint8_t* end, const  char* s);
     void                                updateOptimizedLazyPointers(const LinkContext& context);
     void                                updateAlternateLazyPointer(uint8_t* stub, void** originalLazyPointerAddr, const LinkContext& context);
 	void								registerEncryption(const struct encryption_info_command* encryptCmd, const LinkContext& context);
 	
 	const struct dyld_info_command*			fDyldInfo;
+	BindSymbol*								fBindSymbols;
+	BindRecord*								fBindRecords;
+	uint32_t								fBindSymbolCount;
+	uint32_t								fBindRecordCount;
+	uint32_t								fBindSymbolCapacity;
+	uint32_t								fBindRecordCapacity;
 };
 
 
@@ -23,6 +23,7 @@
  */
 
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
@@ -97,6 +98,7 @@
 #include "dyldSyscallInterface.h"
 #if DYLD_SHARED_CACHE_SUPPORT
 #include "dyld_cache_format.h"
+#include "dyld_trie_walk.h"
 #endif
 #include <coreSymbolicationDyldSupport.h>
 #if TARGET_IPHONE_SIMULATOR
@@ -239,6 +241,7 @@ static size_t						sInsertedDylibCount = 0;
 static std::vector<ImageLoader*>	sAllImages;
 static std::vector<ImageLoader*>	sImageRoots;
 static std::vector<ImageLoader*>	sImageFilesNeedingTermination;
+static std::vector<ImageLoader*>	sStateBuckets[4];
 static std::vector<RegisteredDOF>	sImageFilesNeedingDOFUnregistration;
 static std::vector<ImageCallback>   sAddImageCallbacks;
 static std::vector<ImageCallback>   sRemoveImageCallbacks;
@@ -286,84 +289,188 @@ static bool							sHaswell = false;
 static std::vector<ImageLoader::DynamicReference> sDynamicReferences;
 static OSSpinLock					sDynamicReferencesLock = 0;
 static bool							sLogToFile = false;
+static const char*					sLaunchClosurePath = NULL;
 static char							sLoadingCrashMessage[1024] = "dyld: launch, loading dependent libraries";
 
 //
-// The MappedRanges structure is used for fast address->image lookups.
-// The table is only updated when the dyld lock is held, so we don't
+// The MappedRanges structures are used for fast address->image lookups.
+// The tables are only updated when the dyld lock is held, so we don't
 // need to worry about multiple writers.  But readers may look at this
 // data without holding the lock. Therefore, all updates must be done
 // in an order that will never cause readers to see inconsistent data.
 // The general rule is that if the image field is non-NULL then
 // the other fields are valid.
 //
-struct MappedRanges
-{
-	enum { count=400 };
-	struct {
-		ImageLoader*	image;
-		uintptr_t		start;
-		uintptr_t		end;
-	} array[count];
-	MappedRanges*		next;
+// Ranges are kept in an immutable array sorted by start address, which
+// is searched with a binary search.  New ranges first go into a small
+// unsorted pending table.  When the pending table fills up, a new sorted
+// array is built from the live ranges of both, and published with a
+// single atomic pointer swap.  Removed ranges are just marked by clearing
+// their image field.  Readers bump sMappedRangesReaders while looking, so
+// that replaced sorted arrays are only freed when no reader can be using them.
+//
+struct MappedRange
+{
+	ImageLoader*	image;
+	uintptr_t		start;
+	uintptr_t		end;
+};
+
+struct SortedMappedRanges
+{
+	SortedMappedRanges*		nextRetired;
+	uint32_t				count;
+	uint32_t				removedCount;
+	MappedRange				array[1];
 };
 
-static MappedRanges			sMappedRangesStart;
+enum { kPendingMappedRangesCount = 32 };
+
+static MappedRange						sPendingMappedRanges[kPendingMappedRangesCount];
+static SortedMappedRanges* volatile		sSortedMappedRanges = NULL;
+static SortedMappedRanges*				sRetiredMappedRanges = NULL;
+static volatile int32_t					sMappedRangesReaders = 0;
+
+static bool mappedRangeSorter(const MappedRange& left, const MappedRange& right)
+{
+	return ( left.start < right.start );
+}
+
+static void rebuildSortedMappedRanges()
+{
+	SortedMappedRanges* oldRanges = sSortedMappedRanges;
+	uint32_t liveCount = 0;
+	if ( oldRanges != NULL )
+		liveCount = oldRanges->count - oldRanges->removedCount;
+	for (int i=0; i < kPendingMappedRangesCount; ++i) {
+		if ( sPendingMappedRanges[i].image != NULL )
+			++liveCount;
+	}
+	SortedMappedRanges* newRanges = (SortedMappedRanges*)malloc(sizeof(SortedMappedRanges) + liveCount*sizeof(MappedRange));
+	if ( newRanges == NULL )
+		throw "malloc failure building mapped ranges";
+	newRanges->nextRetired = NULL;
+	newRanges->removedCount = 0;
+	uint32_t count = 0;
+	if ( oldRanges != NULL ) {
+		for (uint32_t i=0; i < oldRanges->count; ++i) {
+			if ( oldRanges->array[i].image != NULL )
+				newRanges->array[count++] = oldRanges->array[i];
+		}
+	}
+	const uint32_t sortedCount = count;
+	for (int i=0; i < kPendingMappedRangesCount; ++i) {
+		if ( sPendingMappedRanges[i].image != NULL )
+			newRanges->array[count++] = sPendingMappedRanges[i];
+	}
+	newRanges->count = count;
+	// only the pending ranges are unsorted
+	std::sort(&newRanges->array[sortedCount], &newRanges->array[count], mappedRangeSorter);
+	std::inplace_merge(&newRanges->array[0], &newRanges->array[sortedCount], &newRanges->array[count], mappedRangeSorter);
+
+	// publish new table, then clear pending table.  Readers check the pending table before
+	// loading the sorted table, so a range is always visible in one or the other
+	OSAtomicCompareAndSwapPtrBarrier(oldRanges, newRanges, (void* volatile*)&sSortedMappedRanges);
+	for (int i=0; i < kPendingMappedRangesCount; ++i)
+		sPendingMappedRanges[i].image = NULL;
+	OSMemoryBarrier();
+
+	// old table can only be freed once no reader is looking at it
+	if ( oldRanges != NULL ) {
+		oldRanges->nextRetired = sRetiredMappedRanges;
+		sRetiredMappedRanges = oldRanges;
+	}
+	if ( sMappedRangesReaders == 0 ) {
+		while ( sRetiredMappedRanges != NULL ) {
+			SortedMappedRanges* next = sRetiredMappedRanges->nextRetired;
+			free(sRetiredMappedRanges);
+			sRetiredMappedRanges = next;
+		}
+	}
+}
 
 void addMappedRange(ImageLoader* image, uintptr_t start, uintptr_t end)
 {
 	//dyld::log("addMappedRange(0x%lX->0x%lX) for %s\n", start, end, image->getShortName());
-	for (MappedRanges* p = &sMappedRangesStart; p != NULL; p = p->next) {
-		for (int i=0; i < MappedRanges::count; ++i) {
-			if ( p->array[i].image == NULL ) {
-				p->array[i].start = start;
-				p->array[i].end = end;
+	for (int pass=0; pass < 2; ++pass) {
+		for (int i=0; i < kPendingMappedRangesCount; ++i) {
+			if ( sPendingMappedRanges[i].image == NULL ) {
+				sPendingMappedRanges[i].start = start;
+				sPendingMappedRanges[i].end = end;
 				// add image field last with a barrier so that any reader will see consistent records
 				OSMemoryBarrier();
-				p->array[i].image = image;
+				sPendingMappedRanges[i].image = image;
 				return;
 			}
 		}
-	}
-	// table must be full, chain another
-	MappedRanges* newRanges = (MappedRanges*)malloc(sizeof(MappedRanges));
-	bzero(newRanges, sizeof(MappedRanges));
-	newRanges->array[0].start = start;
-	newRanges->array[0].end = end;
-	newRanges->array[0].image = image;
-	for (MappedRanges* p = &sMappedRangesStart; p != NULL; p = p->next) {
-		if ( p->next == NULL ) {
-			OSMemoryBarrier();
-			p->next = newRanges;
-			break;
-		}
+		// pending table is full, move everything into sorted table
+		rebuildSortedMappedRanges();
 	}
 }
 
 void removedMappedRanges(ImageLoader* image)
 {
-	for (MappedRanges* p = &sMappedRangesStart; p != NULL; p = p->next) {
-		for (int i=0; i < MappedRanges::count; ++i) {
-			if ( p->array[i].image == image ) {
+	for (int i=0; i < kPendingMappedRangesCount; ++i) {
+		if ( sPendingMappedRanges[i].image == image ) {
+			// clear with a barrier so that any reader will see consistent records
+			OSMemoryBarrier();
+			sPendingMappedRanges[i].image = NULL;
+		}
+	}
+	SortedMappedRanges* sortedRanges = sSortedMappedRanges;
+	if ( sortedRanges != NULL ) {
+		for (uint32_t i=0; i < sortedRanges->count; ++i) {
+			if ( sortedRanges->array[i].image == image ) {
 				// clear with a barrier so that any reader will see consistent records
 				OSMemoryBarrier();
-				p->array[i].image = NULL;
+				sortedRanges->array[i].image = NULL;
+				++sortedRanges->removedCount;
 			}
 		}
+		// compact once half the sorted table is dead
+		if ( sortedRanges->removedCount*2 > sortedRanges->count )
+			rebuildSortedMappedRanges();
 	}
 }
 
 ImageLoader* findMappedRange(uintptr_t target)
 {
-	for (MappedRanges* p = &sMappedRangesStart; p != NULL; p = p->next) {
-		for (int i=0; i < MappedRanges::count; ++i) {
-			if ( p->array[i].image != NULL ) {
-				if ( (p->array[i].start <= target) && (target < p->array[i].end) )
-					return p->array[i].image;
+	ImageLoader* result = NULL;
+	OSAtomicIncrement32Barrier(&sMappedRangesReaders);
+	// check pending table before sorted table, see rebuildSortedMappedRanges()
+	for (int i=0; i < kPendingMappedRangesCount; ++i) {
+		ImageLoader* image = sPendingMappedRanges[i].image;
+		if ( image != NULL ) {
+			if ( (sPendingMappedRanges[i].start <= target) && (target < sPendingMappedRanges[i].end) ) {
+				result = image;
+				break;
 			}
 		}
 	}
-	return NULL;
+	if ( result == NULL ) {
+		OSMemoryBarrier();
+		const SortedMappedRanges* sortedRanges = sSortedMappedRanges;
+		if ( sortedRanges != NULL ) {
+			// binary search for last range starting at or below target
+			uint32_t low = 0;
+			uint32_t high = sortedRanges->count;
+			while ( low < high ) {
+				uint32_t mid = (low + high)/2;
+				if ( sortedRanges->array[mid].start <= target )
+					low = mid + 1;
+				else
+					high = mid;
+			}
+			if ( low > 0 ) {
+				const MappedRange& range = sortedRanges->array[low-1];
+				ImageLoader* image = range.image;
+				if ( (image != NULL) && (target < range.end) )
+					result = image;
+			}
+		}
+	}
+	OSAtomicDecrement32Barrier(&sMappedRangesReaders);
+	return result;
 }
 
 
@@ -674,6 +781,50 @@ static StateHandlers* stateToHandlers(dyld_image_states state, void* handlersArr
 	return NULL;
 }
 
+//
+// Batch notifications report the images that reached a state during the last link or
+// initialization pass.  Rather than scan all images and sort those in the state, each
+// image is appended to its state's bucket when it reaches the state, and a batch
+// notification drains the bucket.  An image is put in the dependents_mapped bucket when
+// it is mapped, which is top down, so drained images are sorted bottom up (dependents
+// first) like a scan of all images would be.
+//
+static std::vector<ImageLoader*>* stateToBucket(dyld_image_states state)
+{
+	switch ( state ) {
+		case dyld_image_state_dependents_mapped:
+			return &sStateBuckets[0];
+		case dyld_image_state_rebased:
+			return &sStateBuckets[1];
+		case dyld_image_state_bound:
+			return &sStateBuckets[2];
+		case dyld_image_state_initialized:
+			return &sStateBuckets[3];
+		default:
+			break;
+	}
+	return NULL;
+}
+
+static void addImageToStateBucket(dyld_image_states state, const ImageLoader* image)
+{
+	std::vector<ImageLoader*>* bucket = stateToBucket((state == dyld_image_state_mapped) ? dyld_image_state_dependents_mapped : state);
+	if ( bucket == NULL )
+		return;
+	// a failed pass may be retried, don't add the same image twice in a row
+	if ( !bucket->empty() && (bucket->back() == image) )
+		return;
+	bucket->push_back(const_cast<ImageLoader*>(image));
+}
+
+void removeImageFromStateBuckets(const ImageLoader* image)
+{
+	for (unsigned int i=0; i < sizeof(sStateBuckets)/sizeof(sStateBuckets[0]); ++i) {
+		std::vector<ImageLoader*>& bucket = sStateBuckets[i];
+		bucket.erase(std::remove(bucket.begin(), bucket.end(), image), bucket.end());
+	}
+}
+
 static void notifySingle(dyld_image_states state, const ImageLoader* image)
 {
 	//dyld::log("notifySingle(state=%d, image=%s)\n", state, image->getPath());
@@ -693,6 +844,8 @@ static void notifySingle(dyld_image_states state, const ImageLoader* image)
 			}
 		}
 	}
+	// remember image for the next batch notification (not reached if a handler rejected the image)
+	addImageToStateBucket(state, image);
 	if ( state == dyld_image_state_mapped ) {
 		// <rdar://problem/7008875> Save load addr + UUID for images from outside the shared cache
 		if ( !image->inSharedCache() ) {
@@ -768,25 +921,41 @@ static void notifyBatchPartial(dyld_image_states state, bool orLater, dyld_image
 {
 	std::vector<dyld_image_state_change_handler>* handlers = stateToHandlers(state, sBatchHandlers);
 	if ( handlers != NULL ) {
-		// don't use a vector because it will use malloc/free and we want notifcation to be low cost
         allImagesLock();
-        ImageLoader* images[sAllImages.size()+1];
+		std::vector<ImageLoader*>* bucket = stateToBucket(state);
+        ImageLoader* images[sAllImages.size()+(bucket != NULL ? bucket->size() : 0)+1];
         ImageLoader** end = images;
-        for (std::vector<ImageLoader*>::iterator it=sAllImages.begin(); it != sAllImages.end(); it++) {
-            dyld_image_states imageState = (*it)->getState();
-            if ( (imageState == state) || (orLater && (imageState > state)) )
-                *end++ = *it;
-        }
-		if ( sBundleBeingLoaded != NULL ) {
-			dyld_image_states imageState = sBundleBeingLoaded->getState();
-			if ( (imageState == state) || (orLater && (imageState > state)) )
-				*end++ = sBundleBeingLoaded;
+		if ( orLater || (bucket == NULL) ) {
+			// new handler gets all existing images in the state or later
+			for (std::vector<ImageLoader*>::iterator it=sAllImages.begin(); it != sAllImages.end(); it++) {
+				dyld_image_states imageState = (*it)->getState();
+				if ( (imageState == state) || (orLater && (imageState > state)) )
+					*end++ = *it;
+			}
+			if ( sBundleBeingLoaded != NULL ) {
+				dyld_image_states imageState = sBundleBeingLoaded->getState();
+				if ( (imageState == state) || (orLater && (imageState > state)) )
+					*end++ = sBundleBeingLoaded;
+			}
 		}
+		else {
+			// drain bucket, images that failed back to an earlier state stay for the next pass
+			size_t kept = 0;
+			for (std::vector<ImageLoader*>::iterator it=bucket->begin(); it != bucket->end(); it++) {
+				dyld_image_states imageState = (*it)->getState();
+				if ( imageState == state )
+					*end++ = *it;
+				else if ( imageState < state )
+					(*bucket)[kept++] = *it;
+			}
+			bucket->resize(kept);
+		}
+		// sort bottom up
+		if ( end != images )
+			qsort(images, end-images, sizeof(ImageLoader*), &imageSorter);
         const char* dontLoadReason = NULL;
 		uint32_t count = (uint32_t)(end-images);
 		if ( end != images ) {
-			// sort bottom up
-			qsort(images, count, sizeof(ImageLoader*), &imageSorter);
 			// build info array
 			dyld_image_info	infos[count];
 			for (unsigned int i=0; i < count; ++i) {
@@ -924,12 +1093,452 @@ static void addDynamicReference(ImageLoader* from, ImageLoader* to) {
 	OSSpinLockUnlock(&sDynamicReferencesLock);
 }
 
+
+//
+// Flat namespace lookups (dlsym(RTLD_DEFAULT) and flat binding) must search every image in
+// load order, which is a trie walk per image.  The flat symbol index remembers the result of
+// each lookup by name.  Each entry records how many images (in search order) have been
+// searched, so when images are added only the new ones need to be searched, and an entry
+// with a non-weak definition is never affected by later images.  Entries are purged or
+// adjusted when an image is removed.  Lookups are not serialized by the global dyld lock:
+// fast lazy binding runs in read sections, and classic lazy binding (bindLazySymbol) takes
+// no lock at all, so several threads may update the index at once.  Every access to the
+// table, including purging and flushing, is guarded by sFlatSymbolIndexLock, which is never
+// held while images are searched.
+//
+struct FlatSymbolIndexEntry
+{
+	const char*					name;			// malloc()ed copy, NULL means slot unused
+	uint32_t					hash;
+	uint32_t					searchedCount;	// images in search order that have been searched
+	uint32_t					foundIndex;		// search order index of image that provided definition
+	bool						weak;
+	const ImageLoader*			searchedImage;	// image in sAllImages that provided definition (may re-export foundImage)
+	const ImageLoader*			foundImage;		// NULL if no definition found
+	const ImageLoader::Symbol*	foundSym;
+};
+
+enum { kFlatSymbolIndexInitialCapacity = 256, kFlatSymbolIndexMaxCapacity = 4096 };
+
+static FlatSymbolIndexEntry*		sFlatSymbolIndex = NULL;
+static uint32_t						sFlatSymbolIndexCapacity = 0;
+static uint32_t						sFlatSymbolIndexCount = 0;
+static uint32_t						sFlatSymbolIndexHits = 0;
+static uint32_t						sFlatSymbolIndexMisses = 0;
+static OSSpinLock					sFlatSymbolIndexLock = 0;
+
+//
+// Flat searches walk every image in search order.  The flat search order keeps what that walk
+// needs from each image (its export trie and flags) in one dense array, so images that do not
+// export the symbol are skipped without touching their ImageLoader.  It is invalidated when
+// the image list or any image's hidden exports change, which only happens under the global
+// dyld lock, and rebuilt by the next search.  Searches walk the order without holding
+// sFlatSymbolIndexLock, so a rebuilt order is published as a new array.  Each search counts
+// itself as a reader of the array it walks, and the last reader frees an array that has been
+// replaced.  The current array is rebuilt in place only when it has no readers.
+//
+struct FlatSearchEntry
+{
+	const uint8_t*		trieStart;		// NULL if image has no export trie
+	const uint8_t*		trieEnd;
+	ImageLoader*		image;
+	bool				hidden;
+	bool				coalesced;
+};
+
+struct FlatSearchOrder
+{
+	uint32_t			readers;		// searches walking this order, guarded by sFlatSymbolIndexLock
+	uint32_t			capacity;
+	uint32_t			count;
+	FlatSearchEntry		entries[1];
+};
+
+static FlatSearchOrder*				sFlatSearchOrder = NULL;
+static bool							sFlatSearchOrderValid = false;
+static uint32_t						sFlatSearchOrderHiddenGeneration = 0;
+
+
+// the use of inserted libraries alters search order
+// so that inserted libraries are found before the main executable
+static ImageLoader* imageInSearchOrder(size_t index)
+{
+	if ( sInsertedDylibCount > 0 ) {
+		if ( index < sInsertedDylibCount )
+			return sAllImages[index+1];
+		else if ( index == sInsertedDylibCount )
+			return sAllImages[0];
+	}
+	return sAllImages[index];
+}
+
+static FlatSymbolIndexEntry* flatSymbolIndexSlot(FlatSymbolIndexEntry* table, uint32_t capacity, const char* name, uint32_t hash)
+{
+	// open addressing with linear probing, capacity is always a power of two and never full
+	const uint32_t mask = capacity - 1;
+	for (uint32_t i = hash & mask; ; i = (i+1) & mask) {
+		FlatSymbolIndexEntry* entry = &table[i];
+		if ( entry->name == NULL )
+			return entry;
+		if ( (entry->hash == hash) && (strcmp(entry->name, name) == 0) )
+			return entry;
+	}
+}
+
+// caller must hold sFlatSymbolIndexLock, returns false (table unchanged) if out of memory
+static bool rehashFlatSymbolIndex(uint32_t newCapacity)
+{
+	FlatSymbolIndexEntry* newTable = (FlatSymbolIndexEntry*)calloc(newCapacity, sizeof(FlatSymbolIndexEntry));
+	if ( newTable == NULL )
+		return false;
+	for (uint32_t i=0; i < sFlatSymbolIndexCapacity; ++i) {
+		FlatSymbolIndexEntry* entry = &sFlatSymbolIndex[i];
+		if ( entry->name != NULL )
+			*flatSymbolIndexSlot(newTable, newCapacity, entry->name, entry->hash) = *entry;
+	}
+	if ( sFlatSymbolIndex != NULL )
+		free(sFlatSymbolIndex);
+	sFlatSymbolIndex = newTable;
+	sFlatSymbolIndexCapacity = newCapacity;
+	return true;
+}
+
+// caller must hold sFlatSymbolIndexLock
+static void clearFlatSymbolIndex()
+{
+	for (uint32_t i=0; i < sFlatSymbolIndexCapacity; ++i) {
+		FlatSymbolIndexEntry* entry = &sFlatSymbolIndex[i];
+		if ( entry->name != NULL ) {
+			free((void*)entry->name);
+			entry->name = NULL;
+		}
+	}
+	sFlatSymbolIndexCount = 0;
+}
+
+static void invalidateFlatSearchOrder()
+{
+	OSSpinLockLock(&sFlatSymbolIndexLock);
+	sFlatSearchOrderValid = false;
+	OSSpinLockUnlock(&sFlatSymbolIndexLock);
+}
+
+void flushFlatSymbolIndex()
+{
+	OSSpinLockLock(&sFlatSymbolIndexLock);
+	sFlatSearchOrderValid = false;
+	clearFlatSymbolIndex();
+	OSSpinLockUnlock(&sFlatSymbolIndexLock);
+}
+
+static void removeImageFromFlatSymbolIndex(const ImageLoader* image)
+{
+	OSSpinLockLock(&sFlatSymbolIndexLock);
+	sFlatSearchOrderValid = false;
+	if ( sFlatSymbolIndexCount == 0 ) {
+		OSSpinLockUnlock(&sFlatSymbolIndexLock);
+		return;
+	}
+	// find where image is in search order
+	uint32_t removedIndex = UINT32_MAX;
+	const size_t imageCount = sAllImages.size();
+	for(size_t i=0; i < imageCount; ++i) {
+		if ( imageInSearchOrder(i) == image ) {
+			removedIndex = (uint32_t)i;
+			break;
+		}
+	}
+	// drop entries that came from image, shift search order indexes of the rest
+	bool dropped = false;
+	for (uint32_t i=0; i < sFlatSymbolIndexCapacity; ++i) {
+		FlatSymbolIndexEntry* entry = &sFlatSymbolIndex[i];
+		if ( entry->name == NULL )
+			continue;
+		if ( (entry->foundImage != NULL) && ((entry->foundImage == image) || (entry->foundIndex == removedIndex)) ) {
+			free((void*)entry->name);
+			entry->name = NULL;
+			--sFlatSymbolIndexCount;
+			dropped = true;
+			continue;
+		}
+		if ( (entry->foundImage != NULL) && (entry->foundIndex > removedIndex) )
+			--entry->foundIndex;
+		if ( entry->searchedCount > removedIndex )
+			--entry->searchedCount;
+	}
+	// removing entries breaks linear probe chains, so re-insert survivors
+	// (if that can't be done, a lookup could miss a survivor, so start over with an empty index)
+	if ( dropped && !rehashFlatSymbolIndex(sFlatSymbolIndexCapacity) )
+		clearFlatSymbolIndex();
+	OSSpinLockUnlock(&sFlatSymbolIndexLock);
+}
+
+
+//
+// The load phases expand DYLD_LIBRARY_PATH, DYLD_FALLBACK_*, @rpath and image suffix
+// combinations into candidate paths and stat() each one, so the same missing paths are
+// probed for every dependent library and every dlopen().  The path probe cache only records
+// expanded candidates whose stat() failed with ENOENT or ENOTDIR, and a hit just repeats that
+// error.  Nothing is recorded for a path that exists, or for the path exactly as the client
+// named it, so those are stat()ed every time.  Entries are never removed individually, a
+// file created at a cached path is found after dlopen() with RTLD_NOCACHE flushes the cache.
+// Only the load phases use it.  They run while launching, or from dlopen() and friends with
+// the global dyld lock held, but never from lazy binding, which takes no lock or only a
+// read section.
+//
+struct PathProbeCacheEntry
+{
+	const char*			path;			// malloc()ed copy, NULL means slot unused
+	uint32_t			hash;
+	int					error;			// errno from stat()
+};
+
+enum { kPathProbeCacheInitialCapacity = 256, kPathProbeCacheMaxCapacity = 2048 };
+
+static PathProbeCacheEntry*			sPathProbeCache = NULL;
+static uint32_t						sPathProbeCacheCapacity = 0;
+static uint32_t						sPathProbeCacheCount = 0;
+static uint32_t						sPathProbeCacheHits = 0;
+static uint32_t						sPathProbeStats = 0;
+
+
+static PathProbeCacheEntry* pathProbeCacheSlot(PathProbeCacheEntry* table, uint32_t capacity, const char* path, uint32_t hash)
+{
+	// open addressing with linear probing, capacity is always a power of two and never full
+	const uint32_t mask = capacity - 1;
+	for (uint32_t i = hash & mask; ; i = (i+1) & mask) {
+		PathProbeCacheEntry* entry = &table[i];
+		if ( entry->path == NULL )
+			return entry;
+		if ( (entry->hash == hash) && (strcmp(entry->path, path) == 0) )
+			return entry;
+	}
+}
+
+static void rehashPathProbeCache(uint32_t newCapacity)
+{
+	PathProbeCacheEntry* newTable = (PathProbeCacheEntry*)calloc(newCapacity, sizeof(PathProbeCacheEntry));
+	if ( newTable == NULL )
+		return;
+	for (uint32_t i=0; i < sPathProbeCacheCapacity; ++i) {
+		PathProbeCacheEntry* entry = &sPathProbeCache[i];
+		if ( entry->path != NULL )
+			*pathProbeCacheSlot(newTable, newCapacity, entry->path, entry->hash) = *entry;
+	}
+	if ( sPathProbeCache != NULL )
+		free(sPathProbeCache);
+	sPathProbeCache = newTable;
+	sPathProbeCacheCapacity = newCapacity;
+}
+
+void flushPathProbeCache()
+{
+	for (uint32_t i=0; i < sPathProbeCacheCapacity; ++i) {
+		PathProbeCacheEntry* entry = &sPathProbeCache[i];
+		if ( entry->path != NULL ) {
+			free((void*)entry->path);
+			entry->path = NULL;
+		}
+	}
+	sPathProbeCacheCount = 0;
+}
+
+// stat() a candidate path produced by the load phases, orgPath is the path the client asked for
+static int statPathProbe(const char* path, const char* orgPath, struct stat* stat_buf)
+{
+	// only expansions are cached, so a file created at a path named explicitly is always found
+	if ( strcmp(path, orgPath) == 0 ) {
+		++sPathProbeStats;
+		return my_stat(path, stat_buf);
+	}
+	
+	if ( sPathProbeCache == NULL )
+		rehashPathProbeCache(kPathProbeCacheInitialCapacity);
+	const uint32_t hash = ImageLoader::hash(path);
+	PathProbeCacheEntry* entry = (sPathProbeCache != NULL) ? pathProbeCacheSlot(sPathProbeCache, sPathProbeCacheCapacity, path, hash) : NULL;
+	if ( (entry != NULL) && (entry->path != NULL) ) {
+		++sPathProbeCacheHits;
+		errno = entry->error;
+		return -1;
+	}
+	
+	++sPathProbeStats;
+	int result = my_stat(path, stat_buf);
+	int err = (result == 0) ? 0 : errno;
+	// other errors (e.g. EACCES) are reported to the client, so they are not cached
+	if ( (err == ENOENT) || (err == ENOTDIR) ) {
+		// add to cache, growing table to keep load factor under 3/4
+		if ( (entry != NULL) && ((sPathProbeCacheCount+1)*4 > sPathProbeCacheCapacity*3) ) {
+			if ( sPathProbeCacheCapacity < kPathProbeCacheMaxCapacity ) {
+				rehashPathProbeCache(sPathProbeCacheCapacity*2);
+				entry = pathProbeCacheSlot(sPathProbeCache, sPathProbeCacheCapacity, path, hash);
+			}
+			else {
+				entry = NULL;
+			}
+		}
+		if ( entry != NULL ) {
+			char* pathCopy = (char*)malloc(strlen(path)+1);
+			if ( pathCopy != NULL ) {
+				strcpy(pathCopy, path);
+				entry->path		= pathCopy;
+				entry->hash		= hash;
+				entry->error	= err;
+				++sPathProbeCacheCount;
+			}
+		}
+	}
+	errno = err;
+	return result;
+}
+
+
+//
+// Before an image's dependents are loaded one by one, libraryPrefetcher() runs the load phases
+// for each of them with sPrefetchOnly set.  The first file found for a dependent is not loaded,
+// just opened so the kernel starts reading its first pages.  Those reads proceed in parallel
+// while the dependents are then loaded in the usual order.
+//
+enum { kDependentPrefetchSize = 32*1024 };
+
+static bool							sPrefetchOnly = false;
+static bool							sPrefetchFound = false;
+static uint32_t						sPrefetchFileCount = 0;
+static uint64_t						sPrefetchBytes = 0;
+
+static void prefetchImageFile(const char* path, const struct stat& stat_buf)
+{
+	int fd = my_open(path, O_RDONLY, 0);
+	if ( fd == -1 )
+		return;
+	radvisory advice;
+	advice.ra_offset = 0;
+	advice.ra_count = (int)std::min((off_t)kDependentPrefetchSize, stat_buf.st_size);
+	if ( fcntl(fd, F_RDADVISE, &advice) != -1 ) {
+		++sPrefetchFileCount;
+		sPrefetchBytes += advice.ra_count;
+		if ( gLinkContext.verboseMapping )
+			dyld::log("dyld: prefetching first %d bytes of %s\n", advice.ra_count, path);
+	}
+	close(fd);
+}
+
+
+//
+// Choosing a slice of a fat file means reading the fat header and matching its archs against
+// the cpu subtype preference list.  Processes that dlopen() many universal bundles, and the
+// override checks for versioned paths, make that choice again for files already chosen from.
+// The fat slice memo remembers the slice chosen from each file, keyed by the file's identity
+// (device, inode, mtime, size), so readFirstPage() and loadPhase6() share one decision and
+// a memo hit reads the slice's first page directly.  A replaced file has a new identity, so
+// entries never go stale.  Like the path probe cache, it is only used by the load phases,
+// never from lazy binding, which takes no lock or only a read section.
+//
+struct FatSliceMemoEntry
+{
+	dev_t				device;
+	ino_t				inode;			// zero means slot unused
+	time_t				mtime;
+	off_t				size;
+	uint64_t			sliceOffset;
+	uint64_t			sliceLength;
+	cpu_subtype_t		sliceSubtype;
+};
+
+enum { kFatSliceMemoInitialCapacity = 64, kFatSliceMemoMaxCapacity = 1024 };
+
+static FatSliceMemoEntry*			sFatSliceMemo = NULL;
+static uint32_t						sFatSliceMemoCapacity = 0;
+static uint32_t						sFatSliceMemoCount = 0;
+static uint32_t						sFatSliceMemoHits = 0;
+
+
+static uint32_t fatSliceMemoHash(dev_t device, ino_t inode)
+{
+	return (uint32_t)(inode * 2654435761U) ^ (uint32_t)device;
+}
+
+static FatSliceMemoEntry* fatSliceMemoSlot(FatSliceMemoEntry* table, uint32_t capacity, dev_t device, ino_t inode, uint32_t hash)
+{
+	// open addressing with linear probing, capacity is always a power of two and never full
+	const uint32_t mask = capacity - 1;
+	for (uint32_t i = hash & mask; ; i = (i+1) & mask) {
+		FatSliceMemoEntry* entry = &table[i];
+		if ( entry->inode == 0 )
+			return entry;
+		if ( (entry->inode == inode) && (entry->device == device) )
+			return entry;
+	}
+}
+
+static void rehashFatSliceMemo(uint32_t newCapacity)
+{
+	FatSliceMemoEntry* newTable = (FatSliceMemoEntry*)calloc(newCapacity, sizeof(FatSliceMemoEntry));
+	if ( newTable == NULL )
+		return;
+	for (uint32_t i=0; i < sFatSliceMemoCapacity; ++i) {
+		FatSliceMemoEntry* entry = &sFatSliceMemo[i];
+		if ( entry->inode != 0 )
+			*fatSliceMemoSlot(newTable, newCapacity, entry->device, entry->inode, fatSliceMemoHash(entry->device, entry->inode)) = *entry;
+	}
+	if ( sFatSliceMemo != NULL )
+		free(sFatSliceMemo);
+	sFatSliceMemo = newTable;
+	sFatSliceMemoCapacity = newCapacity;
+}
+
+// returns true and the previously chosen slice if the file has not changed since
+static bool fatSliceMemoLookup(const struct stat& stat_buf, uint64_t* offset, uint64_t* len)
+{
+	if ( (sFatSliceMemo == NULL) || (stat_buf.st_ino == 0) )
+		return false;
+	FatSliceMemoEntry* entry = fatSliceMemoSlot(sFatSliceMemo, sFatSliceMemoCapacity, stat_buf.st_dev, stat_buf.st_ino, fatSliceMemoHash(stat_buf.st_dev, stat_buf.st_ino));
+	if ( (entry->inode == 0) || (entry->mtime != stat_buf.st_mtime) || (entry->size != stat_buf.st_size) )
+		return false;
+	++sFatSliceMemoHits;
+	*offset = entry->sliceOffset;
+	*len = entry->sliceLength;
+	return true;
+}
+
+static void fatSliceMemoRecord(const struct stat& stat_buf, uint64_t offset, uint64_t len, cpu_subtype_t subtype)
+{
+	if ( stat_buf.st_ino == 0 )
+		return;
+	if ( sFatSliceMemo == NULL )
+		rehashFatSliceMemo(kFatSliceMemoInitialCapacity);
+	if ( sFatSliceMemo == NULL )
+		return;
+	const uint32_t hash = fatSliceMemoHash(stat_buf.st_dev, stat_buf.st_ino);
+	FatSliceMemoEntry* entry = fatSliceMemoSlot(sFatSliceMemo, sFatSliceMemoCapacity, stat_buf.st_dev, stat_buf.st_ino, hash);
+	if ( entry->inode == 0 ) {
+		// new file, grow table to keep load factor under 3/4
+		if ( (sFatSliceMemoCount+1)*4 > sFatSliceMemoCapacity*3 ) {
+			if ( sFatSliceMemoCapacity >= kFatSliceMemoMaxCapacity )
+				return;
+			rehashFatSliceMemo(sFatSliceMemoCapacity*2);
+			entry = fatSliceMemoSlot(sFatSliceMemo, sFatSliceMemoCapacity, stat_buf.st_dev, stat_buf.st_ino, hash);
+		}
+		++sFatSliceMemoCount;
+	}
+	// a file rewritten in place keeps its inode, so this may update an entry
+	entry->device		= stat_buf.st_dev;
+	entry->inode		= stat_buf.st_ino;
+	entry->mtime		= stat_buf.st_mtime;
+	entry->size			= stat_buf.st_size;
+	entry->sliceOffset	= offset;
+	entry->sliceLength	= len;
+	entry->sliceSubtype	= subtype;
+}
+
+
 static void addImage(ImageLoader* image)
 {
 	// add to master list
     allImagesLock();
         sAllImages.push_back(image);
     allImagesUnlock();
+	invalidateFlatSearchOrder();
 	
 	// update mapped ranges
 	uintptr_t lastSegStart = 0;
@@ -1002,10 +1611,14 @@ void removeImage(ImageLoader* image)
 	
 	// notify 
 	notifySingle(dyld_image_state_terminated, image);
+	removeImageFromStateBuckets(image);
 	
 	// remove from mapped images table
 	removedMappedRanges(image);
 
+	// remove from flat symbol index (must be done before search order changes)
+	removeImageFromFlatSymbolIndex(image);
+
 	// remove from master list
     allImagesLock();
         for (std::vector<ImageLoader*>::iterator it=sAllImages.begin(); it != sAllImages.end(); it++) {
@@ -1025,6 +1638,9 @@ void removeImage(ImageLoader* image)
 	if ( sLastImageByAddressCache == image )
 		sLastImageByAddressCache = NULL;
 
+	// no longer findable by address, so dladdr() can't be using its symbol index
+	image->releaseSymbolAddressIndex();
+
 	// if in root list, pull it out 
 	for (std::vector<ImageLoader*>::iterator it=sImageRoots.begin(); it != sImageRoots.end(); it++) {
 		if ( *it == image ) {
@@ -1110,8 +1726,18 @@ void initializeMainExecutable()
 		(*gLibSystemHelpers->cxa_atexit)(&runAllStaticTerminators, NULL, NULL);
 
 	// dump info if requested
-	if ( sEnv.DYLD_PRINT_STATISTICS )
+	if ( sEnv.DYLD_PRINT_STATISTICS ) {
 		ImageLoaderMachO::printStatistics((unsigned int)sAllImages.size(), initializerTimes[0]);
+		dyld::log("total flat symbol index lookups: %u hits, %u misses (%u symbols indexed)\n", sFlatSymbolIndexHits, sFlatSymbolIndexMisses, sFlatSymbolIndexCount);
+		dyld::log("total path probe cache: %u stat() calls saved, %u made (%u paths cached)\n", sPathProbeCacheHits, sPathProbeStats, sPathProbeCacheCount);
+		dyld::log("total dependents prefetched: %u files, %llu KB\n", sPrefetchFileCount, sPrefetchBytes/1024);
+		dyld::log("total fat slice memo: %u hits (%u slices remembered)\n", sFatSliceMemoHits, sFatSliceMemoCount);
+		uint64_t poolLive, poolPeak, poolWasted;
+		uint32_t poolLargeCount;
+		getPoolStatistics(&poolLive, &poolPeak, &poolWasted, &poolLargeCount);
+		dyld::log("total dyld pool memory: %llu KB live, %llu KB peak, %llu KB wasted (%u large allocations)\n", 
+				poolLive/1024, poolPeak/1024, poolWasted/1024, poolLargeCount);
+	}
 }
 
 bool mainExecutablePrebound()
@@ -1576,6 +2202,9 @@ void processDyldEnvironmentVariable(const char* key, const char* value, const ch
 	}
 #endif
 #if !TARGET_IPHONE_SIMULATOR
+	else if ( (strcmp(key, "DYLD_LAUNCH_CLOSURE_PATH") == 0) && (mainExecutableDir == NULL) ) {
+		sLaunchClosurePath = value;
+	}
 	else if ( (strcmp(key, "DYLD_PRINT_TO_FILE") == 0) && (mainExecutableDir == NULL) ) {
 		int fd = open(value, O_WRONLY | O_CREAT | O_APPEND, 0644);
 		if ( fd != -1 ) {
@@ -1874,92 +2503,663 @@ static void getHostInfo(const macho_header* mainExecutableMH, uintptr_t mainExec
 #endif
 }
 
-static void checkSharedRegionDisable()
+static void checkSharedRegionDisable()
+{
+#if __MAC_OS_X_VERSION_MIN_REQUIRED
+	// if main executable has segments that overlap the shared region, 
+	// then disable using the shared region
+	if ( sMainExecutable->overlapsWithAddressRange((void*)(uintptr_t)SHARED_REGION_BASE, (void*)(uintptr_t)(SHARED_REGION_BASE + SHARED_REGION_SIZE)) ) {
+		gLinkContext.sharedRegionMode = ImageLoader::kDontUseSharedRegion;
+		if ( gLinkContext.verboseMapping )
+			dyld::warn("disabling shared region because main executable overlaps\n");
+	}
+#if __i386__
+	if ( sProcessIsRestricted ) {
+		// <rdar://problem/15280847> use private or no shared region for suid processes
+		gLinkContext.sharedRegionMode = ImageLoader::kUsePrivateSharedRegion;
+	}
+#endif
+#endif
+	// iPhoneOS cannot run without shared region
+}
+
+bool validImage(const ImageLoader* possibleImage)
+{
+    const size_t imageCount = sAllImages.size();
+    for(size_t i=0; i < imageCount; ++i) {
+        if ( possibleImage == sAllImages[i] ) {
+            return true;
+        }
+    }
+	return false;
+}
+
+uint32_t getImageCount()
+{
+	return (uint32_t)sAllImages.size();
+}
+
+ImageLoader* getIndexedImage(unsigned int index)
+{
+	if ( index < sAllImages.size() )
+		return sAllImages[index];
+	return NULL;
+}
+
+ImageLoader* findImageByMachHeader(const struct mach_header* target)
+{
+	return findMappedRange((uintptr_t)target);
+}
+
+
+ImageLoader* findImageContainingAddress(const void* addr)
+{
+	return findMappedRange((uintptr_t)addr);
+}
+
+
+ImageLoader* findImageContainingSymbol(const void* symbol)
+{
+	for (std::vector<ImageLoader*>::iterator it=sAllImages.begin(); it != sAllImages.end(); it++) {
+		ImageLoader* anImage = *it;
+		if ( anImage->containsSymbol(symbol) )
+			return anImage;
+	}
+	return NULL;
+}
+
+
+
+void forEachImageDo( void (*callback)(ImageLoader*, void* userData), void* userData)
+{
+	const size_t imageCount = sAllImages.size();
+	for(size_t i=0; i < imageCount; ++i) {
+		ImageLoader* anImage = sAllImages[i];
+		(*callback)(anImage, userData);
+	}
+}
+
+ImageLoader* findLoadedImage(const struct stat& stat_buf)
+{
+	const size_t imageCount = sAllImages.size();
+	for(size_t i=0; i < imageCount; ++i){
+		ImageLoader* anImage = sAllImages[i];
+		if ( anImage->statMatch(stat_buf) )
+			return anImage;
+	}
+	return NULL;
+}
+
+#if !TARGET_IPHONE_SIMULATOR
+//
+// A launch closure (DYLD_LAUNCH_CLOSURE_PATH) records the outcome of binding at launch:
+// the shared cache in use, the load order, the path and identity of each image (its stat
+// info, or its LC_UUID if it is in the shared cache, because dyld never stat()s those), and
+// the final value of every non-lazy pointer as an (image index, offset) pair.  On the next
+// launch, each compressed image is bound by storing the recorded values, as long as the
+// shared cache is the same and every image up to the ones it binds to still matches the
+// closure.  On the first mismatch, the remaining images are
+// bound normally and the closure is rewritten at the end of launch.  Images that cannot
+// be replayed (e.g. __TEXT or non-pointer binds) are marked as such once, so binding them
+// normally does not cause a rewrite on every launch.
+//
+#define LAUNCH_CLOSURE_MAGIC		0x636C6F73	// 'clos'
+#define LAUNCH_CLOSURE_VERSION		3
+#define LAUNCH_CLOSURE_ABSOLUTE		0xFFFFFFFF
+
+struct LaunchClosureHeader {
+	uint32_t	magic;
+	uint32_t	version;
+	cpu_type_t	cputype;
+	uint32_t	flags;
+	uint32_t	imageCount;
+	uint32_t	bindCount;
+	uint32_t	stringsSize;
+	uint32_t	checksum;		// adler32 of whole closure computed with this field zero
+	uint8_t		sharedCacheUUID[16];	// all zeros if no shared cache
+	uint64_t	sharedCacheBase;		// unslid address of shared cache, or zero
+	// followed by LaunchClosureImage[imageCount], LaunchClosureBind[bindCount] and the path strings
+};
+
+struct LaunchClosureImage {
+	uint64_t	inode;			// inode, mtime and device are zero for images in the shared cache
+	int64_t		mtime;
+	uint8_t		uuid[16];		// LC_UUID of images in the shared cache, otherwise all zeros
+	uint32_t	device;
+	uint32_t	pathOffset;
+	uint32_t	firstBind;
+	uint32_t	bindCount;
+	uint32_t	flags;
+	uint32_t	reserved;
+};
+
+struct LaunchClosureBind {
+	uint64_t	locationOffset;		// from mach_header of image being bound
+	uint64_t	targetOffset;		// from mach_header of target image
+	uint32_t	targetImage;		// LAUNCH_CLOSURE_ABSOLUTE if target is no longer loaded, image is then not replayed
+	uint32_t	reserved;
+};
+
+enum { kLaunchClosureBindFlat = 1 };
+enum { kLaunchClosureImageBound = 1, kLaunchClosureImageLazysBound = 2, kLaunchClosureImageNoReplay = 4 };
+
+// binds seen during this launch, kept out of the dyld malloc pool because there can be tens of thousands
+struct LaunchClosurePendingBind {
+	const ImageLoader*	image;
+	const ImageLoader*	target;
+	uintptr_t			locationOffset;
+	uintptr_t			targetOffset;
+	uint32_t			imageIndex;		// set when closure is written
+	uint32_t			targetIndex;	// set when closure is written
+};
+
+struct LaunchClosurePendingBindSorter {
+	bool operator()(const LaunchClosurePendingBind& left, const LaunchClosurePendingBind& right) const {
+		if ( left.imageIndex != right.imageIndex )
+			return ( left.imageIndex < right.imageIndex );
+		return ( left.locationOffset < right.locationOffset );
+	}
+};
+
+struct LaunchClosureRecord {
+	const ImageLoader*	image;
+	uint32_t			flags;
+	bool				replayed;
+};
+
+struct LaunchClosureIndexSorter {
+	bool operator()(const std::pair<const ImageLoader*, uint32_t>& left, const std::pair<const ImageLoader*, uint32_t>& right) const {
+		return ( left.first < right.first );
+	}
+};
+
+static const LaunchClosureHeader*			sLaunchClosure = NULL;
+static size_t								sLaunchClosureSize = 0;
+static bool									sLaunchClosureValid = false;
+static bool									sLaunchClosureChanged = false;
+static uint32_t								sLaunchClosureFlags = 0;
+static unsigned int							sLaunchClosureImagesValidated = 0;
+static struct stat							sMainExecutableStatInfo;
+static std::vector<LaunchClosureRecord>		sLaunchClosureRecords;
+static LaunchClosurePendingBind*			sLaunchClosurePending = NULL;
+static size_t								sLaunchClosurePendingCount = 0;
+static size_t								sLaunchClosurePendingCapacity = 0;
+
+
+static const LaunchClosureImage* launchClosureImages()
+{
+	return (LaunchClosureImage*)&sLaunchClosure[1];
+}
+
+static const LaunchClosureBind* launchClosureBinds()
+{
+	return (LaunchClosureBind*)&launchClosureImages()[sLaunchClosure->imageCount];
+}
+
+static const char* launchClosureStrings()
+{
+	return (char*)&launchClosureBinds()[sLaunchClosure->bindCount];
+}
+
+static void launchClosureIdentity(const ImageLoader* image, LaunchClosureImage& info)
+{
+	bzero(info.uuid, sizeof(info.uuid));
+	// main executable was mapped by the kernel, so dyld has no stat info for it
+	if ( image == sMainExecutable ) {
+		info.device = (uint32_t)sMainExecutableStatInfo.st_dev;
+		info.inode	= sMainExecutableStatInfo.st_ino;
+		info.mtime	= sMainExecutableStatInfo.st_mtime;
+	}
+	else if ( image->inSharedCache() ) {
+		// stat info of a cached image is all zeros, the file it was built from may since have changed
+		info.device = 0;
+		info.inode	= 0;
+		info.mtime	= 0;
+		image->getUUID(info.uuid);
+	}
+	else {
+		info.device = (uint32_t)image->getDevice();
+		info.inode	= image->getInode();
+		info.mtime	= image->lastModified();
+	}
+}
+
+// binds into the shared cache are offsets from mach_headers, which are only valid for the same cache
+static void launchClosureSharedCache(uint8_t uuid[16], uint64_t* base)
+{
+	memcpy(uuid, dyld::gProcessInfo->sharedCacheUUID, 16);
+	*base = 0;
+#if DYLD_SHARED_CACHE_SUPPORT
+	if ( sSharedCache != NULL )
+		*base = (uintptr_t)sSharedCache - sSharedCacheSlide;
+#endif
+}
+
+static bool launchClosureImageIndex(const ImageLoader* image, unsigned int* index)
+{
+	const size_t imageCount = sAllImages.size();
+	for(size_t i=0; i < imageCount; ++i) {
+		if ( sAllImages[i] == image ) {
+			*index = (unsigned int)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+static LaunchClosureRecord& launchClosureRecord(const ImageLoader* image)
+{
+	// binds for an image arrive together, so usually this is the last record
+	if ( !sLaunchClosureRecords.empty() && (sLaunchClosureRecords.back().image == image) )
+		return sLaunchClosureRecords.back();
+	for (std::vector<LaunchClosureRecord>::iterator it=sLaunchClosureRecords.begin(); it != sLaunchClosureRecords.end(); it++) {
+		if ( it->image == image ) 
+			return *it;
+	}
+	LaunchClosureRecord record = { image, 0, false };
+	sLaunchClosureRecords.push_back(record);
+	return sLaunchClosureRecords.back();
+}
+
+static const LaunchClosureRecord* findLaunchClosureRecord(const ImageLoader* image)
+{
+	for (std::vector<LaunchClosureRecord>::iterator it=sLaunchClosureRecords.begin(); it != sLaunchClosureRecords.end(); it++) {
+		if ( it->image == image ) 
+			return &(*it);
+	}
+	return NULL;
+}
+
+static void freeLaunchClosurePending()
+{
+	if ( sLaunchClosurePending != NULL )
+		vm_deallocate(mach_task_self(), (vm_address_t)sLaunchClosurePending, sLaunchClosurePendingCapacity*sizeof(LaunchClosurePendingBind));
+	sLaunchClosurePending = NULL;
+	sLaunchClosurePendingCount = 0;
+	sLaunchClosurePendingCapacity = 0;
+}
+
+static bool growLaunchClosurePending()
+{
+	size_t newCapacity = (sLaunchClosurePendingCapacity == 0) ? 4096 : 2*sLaunchClosurePendingCapacity;
+	vm_address_t addr = 0;
+	if ( vm_allocate(mach_task_self(), &addr, newCapacity*sizeof(LaunchClosurePendingBind), VM_FLAGS_ANYWHERE) != KERN_SUCCESS )
+		return false;
+	if ( sLaunchClosurePending != NULL ) {
+		memcpy((void*)addr, sLaunchClosurePending, sLaunchClosurePendingCount*sizeof(LaunchClosurePendingBind));
+		vm_deallocate(mach_task_self(), (vm_address_t)sLaunchClosurePending, sLaunchClosurePendingCapacity*sizeof(LaunchClosurePendingBind));
+	}
+	sLaunchClosurePending = (LaunchClosurePendingBind*)addr;
+	sLaunchClosurePendingCapacity = newCapacity;
+	return true;
+}
+
+// check any images loaded since the last call against the closure
+static void validateLaunchClosureImages()
 {
-#if __MAC_OS_X_VERSION_MIN_REQUIRED
-	// if main executable has segments that overlap the shared region, 
-	// then disable using the shared region
-	if ( sMainExecutable->overlapsWithAddressRange((void*)(uintptr_t)SHARED_REGION_BASE, (void*)(uintptr_t)(SHARED_REGION_BASE + SHARED_REGION_SIZE)) ) {
-		gLinkContext.sharedRegionMode = ImageLoader::kDontUseSharedRegion;
-		if ( gLinkContext.verboseMapping )
-			dyld::warn("disabling shared region because main executable overlaps\n");
+	if ( !sLaunchClosureValid )
+		return;
+	// all images are loaded before any is bound, so the image list must match exactly
+	if ( sAllImages.size() != sLaunchClosure->imageCount ) {
+		if ( gLinkContext.verboseBind )
+			dyld::log("dyld: launch closure has %u images but %lu are loaded, binding remaining images normally\n", 
+					sLaunchClosure->imageCount, (unsigned long)sAllImages.size());
+		sLaunchClosureValid = false;
+		return;
 	}
-#if __i386__
-	if ( sProcessIsRestricted ) {
-		// <rdar://problem/15280847> use private or no shared region for suid processes
-		gLinkContext.sharedRegionMode = ImageLoader::kUsePrivateSharedRegion;
+	const LaunchClosureImage* images = launchClosureImages();
+	const char* strings = launchClosureStrings();
+	const size_t count = sAllImages.size();
+	for (size_t i=sLaunchClosureImagesValidated; i < count; ++i) {
+		const ImageLoader* image = sAllImages[i];
+		LaunchClosureImage info;
+		launchClosureIdentity(image, info);
+		if ( (info.device != images[i].device) || (info.inode != images[i].inode) || (info.mtime != images[i].mtime) 
+				|| (memcmp(info.uuid, images[i].uuid, sizeof(info.uuid)) != 0) || (strcmp(image->getPath(), &strings[images[i].pathOffset]) != 0) ) {
+			if ( gLinkContext.verboseBind )
+				dyld::log("dyld: launch closure does not match %s, binding remaining images normally\n", image->getPath());
+			sLaunchClosureValid = false;
+			return;
+		}
+		sLaunchClosureImagesValidated = (unsigned int)(i+1);
 	}
-#endif
-#endif
-	// iPhoneOS cannot run without shared region
 }
 
-bool validImage(const ImageLoader* possibleImage)
+// called once an image is known to be bound normally this launch
+static LaunchClosureRecord& beginLaunchClosureRecord(const ImageLoader* image, uint32_t flags)
 {
-    const size_t imageCount = sAllImages.size();
-    for(size_t i=0; i < imageCount; ++i) {
-        if ( possibleImage == sAllImages[i] ) {
-            return true;
-        }
-    }
-	return false;
+	LaunchClosureRecord& record = launchClosureRecord(image);
+	if ( (record.flags & kLaunchClosureImageBound) == 0 ) {
+		record.flags = flags;
+		// an unchanged image the closure already marks as not replayable does not need the closure rewritten
+		validateLaunchClosureImages();
+		unsigned int index;
+		if ( sLaunchClosureValid && launchClosureImageIndex(image, &index) && (index < sLaunchClosureImagesValidated) 
+				&& ((launchClosureImages()[index].flags & kLaunchClosureImageNoReplay) != 0) )
+			record.flags |= kLaunchClosureImageNoReplay;
+		else
+			sLaunchClosureChanged = true;
+	}
+	return record;
 }
 
-uint32_t getImageCount()
+static void recordLaunchClosureBind(const ImageLoader* image, uintptr_t location, uintptr_t value, const ImageLoader* target, uint8_t type)
 {
-	return (uint32_t)sAllImages.size();
+	LaunchClosureRecord& record = beginLaunchClosureRecord(image, kLaunchClosureImageBound);
+	if ( record.flags & kLaunchClosureImageNoReplay )
+		return;
+	if ( type != BIND_TYPE_POINTER ) {
+		record.flags |= kLaunchClosureImageNoReplay;
+		return;
+	}
+	if ( (sLaunchClosurePendingCount == sLaunchClosurePendingCapacity) && !growLaunchClosurePending() ) {
+		record.flags |= kLaunchClosureImageNoReplay;
+		return;
+	}
+	// value may be past the end of target (e.g. resolver or addend), it is still recorded relative to target
+	if ( target == NULL ) {
+		target = findImageContainingAddress((void*)value);
+		// e.g. missing weak import, an absolute value would not survive ASLR
+		if ( target == NULL ) {
+			record.flags |= kLaunchClosureImageNoReplay;
+			return;
+		}
+	}
+	LaunchClosurePendingBind& bind = sLaunchClosurePending[sLaunchClosurePendingCount++];
+	bind.image			= image;
+	bind.target			= target;
+	bind.locationOffset = location - (uintptr_t)image->machHeader();
+	bind.targetOffset	= value - (uintptr_t)target->machHeader();
+	bind.imageIndex		= 0;
+	bind.targetIndex	= LAUNCH_CLOSURE_ABSOLUTE;
 }
 
-ImageLoader* getIndexedImage(unsigned int index)
+// returns the closure info for image if its recorded binds can be stored as is
+static const LaunchClosureImage* replayableLaunchClosureImage(const ImageLoader* image, uint32_t flags)
 {
-	if ( index < sAllImages.size() )
-		return sAllImages[index];
-	return NULL;
+	validateLaunchClosureImages();
+	unsigned int index;
+	if ( !sLaunchClosureValid || !launchClosureImageIndex(image, &index) || (index >= sLaunchClosureImagesValidated) )
+		return NULL;
+	const LaunchClosureImage* info = &launchClosureImages()[index];
+	if ( info->flags != flags )
+		return NULL;
+	
+	// every target must already be validated and every location must be in this image before anything is stored
+	const LaunchClosureBind* const binds = &launchClosureBinds()[info->firstBind];
+	const uintptr_t base = (uintptr_t)image->machHeader();
+	for (uint32_t i=0; i < info->bindCount; ++i) {
+		if ( binds[i].targetImage >= sLaunchClosureImagesValidated )
+			return NULL;
+		if ( !image->containsAddress((void*)(base + (uintptr_t)binds[i].locationOffset)) )
+			return NULL;
+	}
+	return info;
 }
 
-ImageLoader* findImageByMachHeader(const struct mach_header* target)
+static bool applyLaunchClosureBinds(const ImageLoader* image, bool lazysBound, uint32_t* fixupCount)
 {
-	return findMappedRange((uintptr_t)target);
+	const uint32_t flags = kLaunchClosureImageBound | (lazysBound ? kLaunchClosureImageLazysBound : 0);
+	const LaunchClosureImage* info = replayableLaunchClosureImage(image, flags);
+	if ( info == NULL ) {
+		// image is bound normally, and its binds recorded
+		beginLaunchClosureRecord(image, flags);
+		return false;
+	}
+	const LaunchClosureBind* const binds = &launchClosureBinds()[info->firstBind];
+	const uintptr_t base = (uintptr_t)image->machHeader();
+	for (uint32_t i=0; i < info->bindCount; ++i) {
+		uintptr_t value = (uintptr_t)binds[i].targetOffset + (uintptr_t)sAllImages[binds[i].targetImage]->machHeader();
+		uintptr_t* location = (uintptr_t*)(base + (uintptr_t)binds[i].locationOffset);
+		// test first so we don't needless dirty pages
+		if ( *location != value )
+			*location = value;
+	}
+	
+	// validated images keep their index, so these binds are copied as is when the closure is rewritten
+	LaunchClosureRecord& record = launchClosureRecord(image);
+	record.flags	= flags;
+	record.replayed = true;
+	if ( gLinkContext.verboseBind )
+		dyld::log("dyld: bound %s from launch closure, %u fixups\n", image->getShortName(), info->bindCount);
+	*fixupCount = info->bindCount;
+	return true;
 }
 
-
-ImageLoader* findImageContainingAddress(const void* addr)
+static uint32_t adler32(uint32_t adler, const uint8_t* p, size_t size)
 {
-	return findMappedRange((uintptr_t)addr);
+	uint32_t a = adler & 0xFFFF;
+	uint32_t b = adler >> 16;
+	while ( size != 0 ) {
+		// largest run that cannot overflow b before the modulo
+		size_t run = (size < 5552) ? size : 5552;
+		size -= run;
+		for (size_t i=0; i < run; ++i) {
+			a += *p++;
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+	return (b << 16) | a;
 }
 
+static uint32_t launchClosureChecksum(const LaunchClosureHeader* header, size_t size)
+{
+	LaunchClosureHeader copy = *header;
+	copy.checksum = 0;
+	uint32_t sum = adler32(1, (uint8_t*)&copy, sizeof(LaunchClosureHeader));
+	return adler32(sum, (uint8_t*)&header[1], size - sizeof(LaunchClosureHeader));
+}
 
-ImageLoader* findImageContainingSymbol(const void* symbol)
+static bool launchClosureWellFormed(const LaunchClosureHeader* header, size_t size)
 {
-	for (std::vector<ImageLoader*>::iterator it=sAllImages.begin(); it != sAllImages.end(); it++) {
-		ImageLoader* anImage = *it;
-		if ( anImage->containsSymbol(symbol) )
-			return anImage;
+	if ( (header->magic != LAUNCH_CLOSURE_MAGIC) || (header->version != LAUNCH_CLOSURE_VERSION) )
+		return false;
+	if ( header->cputype != sMainExecutableMachHeader->cputype )
+		return false;
+	const uint64_t expectedSize = sizeof(LaunchClosureHeader) + (uint64_t)header->imageCount * sizeof(LaunchClosureImage)
+								+ (uint64_t)header->bindCount * sizeof(LaunchClosureBind) + header->stringsSize;
+	if ( (expectedSize != size) || (header->stringsSize == 0) )
+		return false;
+	// nothing in a torn or corrupted closure may be replayed
+	if ( launchClosureChecksum(header, size) != header->checksum )
+		return false;
+	const LaunchClosureImage* images = (LaunchClosureImage*)&header[1];
+	const LaunchClosureBind* binds = (LaunchClosureBind*)&images[header->imageCount];
+	const char* strings = (char*)&binds[header->bindCount];
+	if ( strings[header->stringsSize-1] != '\0' )
+		return false;
+	for (uint32_t i=0; i < header->imageCount; ++i) {
+		if ( images[i].pathOffset >= header->stringsSize )
+			return false;
+		if ( (images[i].firstBind > header->bindCount) || (images[i].bindCount > (header->bindCount - images[i].firstBind)) )
+			return false;
 	}
-	return NULL;
+	return true;
 }
 
+static void loadLaunchClosure()
+{
+	// without the identity of the main executable nothing can be validated or recorded
+	if ( stat(sExecPath, &sMainExecutableStatInfo) != 0 )
+		return;
+#if DYLD_SHARED_CACHE_SUPPORT
+	// a shared cache without a uuid cannot be told apart from the one it replaced
+	static const uint8_t zeroUUID[16] = { 0 };
+	if ( (sSharedCache != NULL) && (memcmp(dyld::gProcessInfo->sharedCacheUUID, zeroUUID, 16) == 0) ) {
+		if ( gLinkContext.verboseBind )
+			dyld::log("dyld: shared cache has no uuid, not using launch closure %s\n", sLaunchClosurePath);
+		return;
+	}
+#endif
+	sLaunchClosureFlags = (gLinkContext.bindFlat ? kLaunchClosureBindFlat : 0);
+	gLinkContext.recordLaunchClosureBind = &recordLaunchClosureBind;
+	gLinkContext.applyLaunchClosureBinds = &applyLaunchClosureBinds;
+	
+	// no closure yet is the normal first launch, it is written once launch linking is done
+	int fd = my_open(sLaunchClosurePath, O_RDONLY, 0);
+	if ( fd == -1 )
+		return;
+	struct stat statBuf;
+	if ( (fstat(fd, &statBuf) == 0) && (statBuf.st_size >= (off_t)sizeof(LaunchClosureHeader)) ) {
+		size_t size = (size_t)statBuf.st_size;
+		void* p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if ( p != MAP_FAILED ) {
+			const LaunchClosureHeader* header = (LaunchClosureHeader*)p;
+			uint8_t sharedCacheUUID[16];
+			uint64_t sharedCacheBase;
+			launchClosureSharedCache(sharedCacheUUID, &sharedCacheBase);
+			if ( launchClosureWellFormed(header, size) && (header->flags == sLaunchClosureFlags) 
+					&& (memcmp(header->sharedCacheUUID, sharedCacheUUID, 16) == 0) && (header->sharedCacheBase == sharedCacheBase) ) {
+				sLaunchClosure = header;
+				sLaunchClosureSize = size;
+				sLaunchClosureValid = true;
+			}
+			else {
+				if ( gLinkContext.verboseBind )
+					dyld::log("dyld: ignoring unusable launch closure %s\n", sLaunchClosurePath);
+				munmap(p, size);
+			}
+		}
+	}
+	close(fd);
+}
 
-
-void forEachImageDo( void (*callback)(ImageLoader*, void* userData), void* userData)
+static void writeLaunchClosure()
 {
 	const size_t imageCount = sAllImages.size();
-	for(size_t i=0; i < imageCount; ++i) {
-		ImageLoader* anImage = sAllImages[i];
-		(*callback)(anImage, userData);
+	std::vector<std::pair<const ImageLoader*, uint32_t> > indexes;
+	indexes.reserve(imageCount);
+	size_t stringsSize = 0;
+	for (size_t i=0; i < imageCount; ++i) {
+		indexes.push_back(std::make_pair((const ImageLoader*)sAllImages[i], (uint32_t)i));
+		stringsSize += strlen(sAllImages[i]->getPath()) + 1;
+	}
+	std::sort(indexes.begin(), indexes.end(), LaunchClosureIndexSorter());
+	
+	// convert pending binds to image indexes and group them by image
+	for (size_t i=0; i < sLaunchClosurePendingCount; ++i) {
+		LaunchClosurePendingBind& bind = sLaunchClosurePending[i];
+		std::vector<std::pair<const ImageLoader*, uint32_t> >::iterator pos = std::lower_bound(indexes.begin(), indexes.end(), 
+														std::make_pair(bind.image, (uint32_t)0), LaunchClosureIndexSorter());
+		bind.imageIndex = ( (pos != indexes.end()) && (pos->first == bind.image) ) ? pos->second : LAUNCH_CLOSURE_ABSOLUTE;
+		if ( bind.target != NULL ) {
+			pos = std::lower_bound(indexes.begin(), indexes.end(), std::make_pair(bind.target, (uint32_t)0), LaunchClosureIndexSorter());
+			if ( (pos != indexes.end()) && (pos->first == bind.target) )
+				bind.targetIndex = pos->second;
+		}
+	}
+	std::sort(&sLaunchClosurePending[0], &sLaunchClosurePending[sLaunchClosurePendingCount], LaunchClosurePendingBindSorter());
+	
+	size_t bindCount = sLaunchClosurePendingCount;
+	for (size_t i=0; i < imageCount; ++i) {
+		const LaunchClosureRecord* record = findLaunchClosureRecord(sAllImages[i]);
+		if ( (record != NULL) && record->replayed )
+			bindCount += launchClosureImages()[i].bindCount;
+	}
+	
+	const size_t size = sizeof(LaunchClosureHeader) + imageCount*sizeof(LaunchClosureImage) + bindCount*sizeof(LaunchClosureBind) + stringsSize;
+	vm_address_t addr = 0;
+	if ( vm_allocate(mach_task_self(), &addr, size, VM_FLAGS_ANYWHERE) != KERN_SUCCESS ) 
+		return;
+	LaunchClosureHeader* header = (LaunchClosureHeader*)addr;
+	LaunchClosureImage* images = (LaunchClosureImage*)&header[1];
+	LaunchClosureBind* binds = (LaunchClosureBind*)&images[imageCount];
+	char* strings = (char*)&binds[bindCount];
+	header->magic		= LAUNCH_CLOSURE_MAGIC;
+	header->version		= LAUNCH_CLOSURE_VERSION;
+	header->cputype		= sMainExecutableMachHeader->cputype;
+	header->flags		= sLaunchClosureFlags;
+	header->imageCount	= (uint32_t)imageCount;
+	header->bindCount	= (uint32_t)bindCount;
+	header->stringsSize = (uint32_t)stringsSize;
+	launchClosureSharedCache(header->sharedCacheUUID, &header->sharedCacheBase);
+	uint32_t stringOffset = 0;
+	uint32_t bindIndex = 0;
+	size_t pendingIndex = 0;
+	for (uint32_t i=0; i < imageCount; ++i) {
+		LaunchClosureImage& info = images[i];
+		launchClosureIdentity(sAllImages[i], info);
+		info.pathOffset = stringOffset;
+		strcpy(&strings[stringOffset], sAllImages[i]->getPath());
+		stringOffset += strlen(sAllImages[i]->getPath()) + 1;
+		info.firstBind = bindIndex;
+		const LaunchClosureRecord* record = findLaunchClosureRecord(sAllImages[i]);
+		if ( record != NULL ) {
+			info.flags = record->flags;
+			if ( record->replayed ) {
+				const LaunchClosureImage& oldInfo = launchClosureImages()[i];
+				memcpy(&binds[bindIndex], &launchClosureBinds()[oldInfo.firstBind], oldInfo.bindCount*sizeof(LaunchClosureBind));
+				bindIndex += oldInfo.bindCount;
+			}
+		}
+		for (; (pendingIndex < sLaunchClosurePendingCount) && (sLaunchClosurePending[pendingIndex].imageIndex == i); ++pendingIndex) {
+			const LaunchClosurePendingBind& pending = sLaunchClosurePending[pendingIndex];
+			// binds of an image that is not replayed are never read
+			if ( info.flags & kLaunchClosureImageNoReplay )
+				continue;
+			LaunchClosureBind& bind = binds[bindIndex++];
+			bind.locationOffset = pending.locationOffset;
+			bind.targetOffset	= pending.targetOffset;
+			bind.targetImage	= pending.targetIndex;
+			// target was found but is no longer loaded
+			if ( (pending.target != NULL) && (pending.targetIndex == LAUNCH_CLOSURE_ABSOLUTE) )
+				info.flags |= kLaunchClosureImageNoReplay;
+		}
+		info.bindCount = bindIndex - info.firstBind;
+	}
+	// any binds left belong to images no longer loaded
+	header->bindCount = bindIndex;
+	const size_t usedSize = size - (bindCount - bindIndex)*sizeof(LaunchClosureBind);
+	if ( bindIndex != bindCount )
+		memmove(&binds[bindIndex], strings, stringsSize);
+	header->checksum = launchClosureChecksum(header, usedSize);
+
+	// write to a temp file unique to this process and rename, so a concurrent launch never sees a partial closure
+	const char* tempPath = mkstringf("%s.%d.tmp", sLaunchClosurePath, getpid());
+	// a stale file can only be left by an earlier process with the same pid
+	unlink(tempPath);
+	int fd = open(tempPath, O_WRONLY | O_CREAT | O_EXCL, 0644);
+	if ( fd != -1 ) {
+		bool written = ( write(fd, header, usedSize) == (ssize_t)usedSize );
+		close(fd);
+		if ( written && (rename(tempPath, sLaunchClosurePath) == 0) ) {
+			if ( gLinkContext.verboseBind )
+				dyld::log("dyld: wrote launch closure %s, %lu images, %u binds\n", sLaunchClosurePath, (unsigned long)imageCount, bindIndex);
+		}
+		else {
+			unlink(tempPath);
+		}
+	}
+	else {
+		dyld::warn("could not write DYLD_LAUNCH_CLOSURE_PATH='%s', errno=%d\n", sLaunchClosurePath, errno);
 	}
+	free((void*)tempPath);
+	vm_deallocate(mach_task_self(), addr, size);
 }
 
-ImageLoader* findLoadedImage(const struct stat& stat_buf)
+static void saveLaunchClosure()
 {
-	const size_t imageCount = sAllImages.size();
-	for(size_t i=0; i < imageCount; ++i){
-		ImageLoader* anImage = sAllImages[i];
-		if ( anImage->statMatch(stat_buf) )
-			return anImage;
+	if ( gLinkContext.recordLaunchClosureBind == NULL )
+		return;
+	gLinkContext.recordLaunchClosureBind = NULL;
+	gLinkContext.applyLaunchClosureBinds = NULL;
+	
+	// closure is rewritten only if some replayable image was bound the slow way or the set of images changed
+	validateLaunchClosureImages();
+	if ( sLaunchClosureChanged || (sLaunchClosure == NULL) || !sLaunchClosureValid || (sLaunchClosureImagesValidated != sAllImages.size()) )
+		writeLaunchClosure();
+	
+	freeLaunchClosurePending();
+	sLaunchClosureRecords.clear();
+	if ( sLaunchClosure != NULL ) {
+		munmap((void*)sLaunchClosure, sLaunchClosureSize);
+		sLaunchClosure = NULL;
 	}
-	return NULL;
+	sLaunchClosureValid = false;
 }
+#endif // !TARGET_IPHONE_SIMULATOR
 
 // based on ANSI-C strstr()
 static const char* strrstr(const char* str, const char* sub) 
@@ -2303,6 +3503,29 @@ static ImageLoader* instantiateFromLoadedImage(const macho_header* mh, uintptr_t
 
 
 #if DYLD_SHARED_CACHE_SUPPORT
+static bool sharedCacheHasPathHash()
+{
+	return ( (sSharedCache->mappingOffset >= 0x80) && (sSharedCache->pathHashOffset != 0) );
+}
+
+// returns index of image in shared cache image table, or DYLD_CACHE_PATH_HASH_EMPTY if path is not in cache 
+static uint32_t findInSharedCachePathHash(const char* path)
+{
+	const dyld_cache_path_hash_info* info = (dyld_cache_path_hash_info*)((uint8_t*)sSharedCache + sSharedCache->pathHashOffset);
+	const dyld_cache_path_hash_bucket* buckets = (dyld_cache_path_hash_bucket*)&info[1];
+	const dyld_cache_image_info* const images = (dyld_cache_image_info*)((uint8_t*)sSharedCache + sSharedCache->imagesOffset);
+	const uint32_t hash = dyld_cache_path_hash(path);
+	const uint32_t mask = info->bucketCount - 1;
+	for (uint32_t i = hash & mask; buckets[i].imageIndex != DYLD_CACHE_PATH_HASH_EMPTY; i = (i+1) & mask) {
+		if ( buckets[i].hash == hash ) {
+			const char* aPath = (char*)sSharedCache + images[buckets[i].imageIndex].pathFileOffset;
+			if ( strcmp(path, aPath) == 0 )
+				return buckets[i].imageIndex;
+		}
+	}
+	return DYLD_CACHE_PATH_HASH_EMPTY;
+}
+
 static bool findInSharedCacheImage(const char* path, bool searchByPath, const struct stat* stat_buf, const macho_header** mh, const char** pathInCache, long* slide)
 {
 	if ( sSharedCache != NULL ) {
@@ -2316,6 +3539,37 @@ static bool findInSharedCacheImage(const char* path, bool searchByPath, const st
 			stat_buf = &statb;
 		}
 #endif
+		const dyld_cache_image_info* const start = (dyld_cache_image_info*)((uint8_t*)sSharedCache + sSharedCache->imagesOffset);
+		const dyld_cache_image_info* const end = &start[sSharedCache->imagesCount];
+
+		// newer caches have a hash table of all image paths 
+		if ( sharedCacheHasPathHash() ) {
+			const uint32_t index = findInSharedCachePathHash(path);
+			if ( index != DYLD_CACHE_PATH_HASH_EMPTY ) {
+				const dyld_cache_image_info* p = &start[index];
+#if __MAC_OS_X_VERSION_MIN_REQUIRED
+				bool inodeMatch = ( ((time_t)p->modTime == stat_buf->st_mtime) && ((ino_t)p->inode == stat_buf->st_ino) );
+				if ( searchByPath || sSharedCacheIgnoreInodeAndTimeStamp || inodeMatch )
+#endif
+				{
+					// found image in cache, return info
+					*mh = (macho_header*)(p->address+sSharedCacheSlide);
+					*pathInCache = (char*)sSharedCache + p->pathFileOffset;
+					*slide = sSharedCacheSlide;
+					return true;
+				}
+			}
+#if __IPHONE_OS_VERSION_MIN_REQUIRED
+			// the walk below only compares paths, so it cannot find what the hash table did not
+			return false;
+#elif __MAC_OS_X_VERSION_MIN_REQUIRED
+			// only a symlink or alternate path to a cached dylib, matched by inode/mtime, can still
+			// be found by the walk below, and only when inode/mtime are being checked
+			if ( (index == DYLD_CACHE_PATH_HASH_EMPTY) && (searchByPath || sSharedCacheIgnoreInodeAndTimeStamp) )
+				return false;
+#endif
+		}
+
 #if __IPHONE_OS_VERSION_MIN_REQUIRED	
 		uint64_t hash = 0;
 		for (const char* s=path; *s != '\0'; ++s)
@@ -2323,8 +3577,6 @@ static bool findInSharedCacheImage(const char* path, bool searchByPath, const st
 #endif
 
 		// walk shared cache to see if there is a cached image that matches the inode/mtime/path desired
-		const dyld_cache_image_info* const start = (dyld_cache_image_info*)((uint8_t*)sSharedCache + sSharedCache->imagesOffset);
-		const dyld_cache_image_info* const end = &start[sSharedCache->imagesCount];
 #if __IPHONE_OS_VERSION_MIN_REQUIRED	
 		const bool cacheHasHashInfo = (start->modTime == 0);
 #endif
@@ -2461,8 +3713,13 @@ static ImageLoader* loadPhase6(int fd, const struct stat& stat_buf, const char*
 	uint8_t firstPage[4096];
 	bool shortPage = false;
 	
+	// if slice of this fat file was already chosen, read its first page directly
+	if ( fatSliceMemoLookup(stat_buf, &fileOffset, &fileLength) ) {
+		if ( pread(fd, firstPage, 4096, fileOffset) != 4096 )
+			throwf("pread of fat file failed: %d", errno);
+	}
 	// min mach-o file is 4K
-	if ( fileLength < 4096 ) {
+	else if ( fileLength < 4096 ) {
 		if ( pread(fd, firstPage, fileLength, 0) != (ssize_t)fileLength )
 			throwf("pread of short file failed: %d", errno);
 		shortPage = true;
@@ -2480,6 +3737,7 @@ static ImageLoader* loadPhase6(int fd, const struct stat& stat_buf, const char*
 				throwf("truncated fat file.  file length=%llu, but needed slice goes to %llu", stat_buf.st_size, fileOffset+fileLength);
 			if (pread(fd, firstPage, 4096, fileOffset) != 4096)
 				throwf("pread of fat file failed: %d", errno);
+			fatSliceMemoRecord(stat_buf, fileOffset, fileLength, ((mach_header*)firstPage)->cpusubtype);
 		}
 		else {
 			throw "no matching architecture in universal wrapper";
@@ -2573,7 +3831,7 @@ static ImageLoader* loadPhase5load(const char* path, const char* orgPath, const
 
 	// just return NULL if file not found, but record any other errors
 	struct stat stat_buf;
-	if ( my_stat(path, &stat_buf) == -1 ) {
+	if ( statPathProbe(path, orgPath, &stat_buf) == -1 ) {
 		int err = errno;
 		if ( err != ENOENT ) {
 			exceptions->push_back(dyld::mkstringf("%s: stat() failed with errno=%d", path, err));
@@ -2586,6 +3844,20 @@ static ImageLoader* loadPhase5load(const char* path, const char* orgPath, const
 	if ( image != NULL )
 		return image;
 	
+	// just start reading file if prefetching, nothing to read if image is in dyld shared cache
+	if ( sPrefetchOnly ) {
+		sPrefetchFound = true;
+	#if DYLD_SHARED_CACHE_SUPPORT
+		const macho_header* mhInCache;
+		const char*			pathInCache;
+		long				slideInCache;
+		if ( findInSharedCacheImage(path, false, &stat_buf, &mhInCache, &pathInCache, &slideInCache) )
+			return NULL;
+	#endif
+		prefetchImageFile(path, stat_buf);
+		return NULL;
+	}
+	
 	// do nothing if not already loaded and if RTLD_NOLOAD or NSADDIMAGE_OPTION_RETURN_ONLY_IF_LOADED
 	if ( context.dontLoad )
 		return NULL;
@@ -2608,19 +3880,26 @@ static ImageLoader* loadPhase5load(const char* path, const char* orgPath, const
 
 
 #if __IPHONE_OS_VERSION_MIN_REQUIRED 
-static ImageLoader* loadPhase5stat(const char* path, const LoadContext& context, struct stat* stat_buf, 
+static ImageLoader* loadPhase5stat(const char* path, const char* orgPath, const LoadContext& context, struct stat* stat_buf, 
 									int* statErrNo, bool* imageFound, std::vector<const char*>* exceptions)
 {
 	ImageLoader* image = NULL;
 	*imageFound = false;
 	*statErrNo = 0;
-	if ( my_stat(path, stat_buf) == 0 ) {
+	if ( statPathProbe(path, orgPath, stat_buf) == 0 ) {
 		// in case image was renamed or found via symlinks, check for inode match
 		image = findLoadedImage(*stat_buf);
 		if ( image != NULL ) {
 			*imageFound = true;
 			return image;
 		}
+		// just start reading file if prefetching
+		if ( sPrefetchOnly ) {
+			sPrefetchFound = true;
+			prefetchImageFile(path, *stat_buf);
+			*imageFound = true;
+			return NULL;
+		}
 		// do nothing if not already loaded and if RTLD_NOLOAD 
 		if ( context.dontLoad ) {
 			*imageFound = true;
@@ -2649,7 +3928,7 @@ static ImageLoader* loadPhase5load(const char* path, const char* orgPath, const
 #if DYLD_SHARED_CACHE_SUPPORT
 	if ( sDylibsOverrideCache ) {
 		// flag is set that allows installed framework roots to override dyld shared cache
-		image = loadPhase5stat(path, context, &stat_buf, &statErrNo, &imageFound, exceptions);
+		image = loadPhase5stat(path, orgPath, context, &stat_buf, &statErrNo, &imageFound, exceptions);
 		if ( imageFound )
 			return image;
 	}
@@ -2664,6 +3943,11 @@ static ImageLoader* loadPhase5load(const char* path, const char* orgPath, const
 			if ( (const macho_header*)anImage->machHeader() == mhInCache )
 				return anImage;
 		}
+		// nothing to read ahead for an image in the shared cache
+		if ( sPrefetchOnly ) {
+			sPrefetchFound = true;
+			return NULL;
+		}
 		// do nothing if not already loaded and if RTLD_NOLOAD 
 		if ( context.dontLoad )
 			return NULL;
@@ -2676,12 +3960,12 @@ static ImageLoader* loadPhase5load(const char* path, const char* orgPath, const
 	
 	if ( !sDylibsOverrideCache ) {
 		// flag is not set, and not in cache to try opening it
-		image = loadPhase5stat(path, context, &stat_buf, &statErrNo, &imageFound, exceptions);
+		image = loadPhase5stat(path, orgPath, context, &stat_buf, &statErrNo, &imageFound, exceptions);
 		if ( imageFound )
 			return image;
 	}
 #else
-	image = loadPhase5stat(path, context, &stat_buf, &statErrNo, &imageFound, exceptions);
+	image = loadPhase5stat(path, orgPath, context, &stat_buf, &statErrNo, &imageFound, exceptions);
 	if ( imageFound )
 		return image;
 #endif
@@ -2744,6 +4028,10 @@ static ImageLoader* loadPhase5(const char* path, const char* orgPath, const Load
 {
 	//dyld::log("%s(%s, %p)\n", __func__ , path, exceptions);
 	
+	// once a prefetch has found the file, skip remaining path permutations
+	if ( sPrefetchOnly && sPrefetchFound )
+		return NULL;
+	
 	// check for specific dylib overrides
 	for (std::vector<DylibOverride>::iterator it = sDylibOverrides.begin(); it != sDylibOverrides.end(); ++it) {
 		if ( strcmp(it->installName, path) == 0 ) {
@@ -3832,9 +5120,14 @@ uintptr_t fastBindLazySymbol(ImageLoader** imageLoaderCache, uintptr_t lazyBindi
 	
 	// bind lazy pointer and return it
 	try {
+		// <rdar://problem/8663923> flat lazy binding runs in a read section, falling back to the global lock
+		// only if a load or unload is in progress.  Older libdyld has no read sections, so always locks.
+		const bool haveReadSections = (dyld::gLibSystemHelpers != NULL) && (dyld::gLibSystemHelpers->version >= 14);
 		result = (*imageLoaderCache)->doBindFastLazySymbol((uint32_t)lazyBindingInfoOffset, gLinkContext, 
 								(dyld::gLibSystemHelpers != NULL) ? dyld::gLibSystemHelpers->acquireGlobalDyldLock : NULL,
-								(dyld::gLibSystemHelpers != NULL) ? dyld::gLibSystemHelpers->releaseGlobalDyldLock : NULL);
+								(dyld::gLibSystemHelpers != NULL) ? dyld::gLibSystemHelpers->releaseGlobalDyldLock : NULL,
+								haveReadSections ? dyld::gLibSystemHelpers->enterReadSection : NULL,
+								haveReadSections ? dyld::gLibSystemHelpers->exitReadSection : NULL);
 	}
 	catch (const char* message) {
 		dyld::log("dyld: lazy symbol binding failed: %s\n", message);
@@ -3859,46 +5152,224 @@ static void undefinedHandler(const char* symboName)
 	}
 }
 
+// caller must hold sFlatSymbolIndexLock
+static void updateFlatSearchOrder()
+{
+	if ( sFlatSearchOrderValid && (sFlatSearchOrderHiddenGeneration == ImageLoader::hiddenExportsGeneration()) )
+		return;
+	const uint32_t imageCount = (uint32_t)sAllImages.size();
+	FlatSearchOrder* order = sFlatSearchOrder;
+	if ( (order == NULL) || (order->readers != 0) || (order->capacity < imageCount) ) {
+		// other threads may still be walking the current order, so build a new one
+		const uint32_t capacity = imageCount + 32;
+		order = (FlatSearchOrder*)malloc(sizeof(FlatSearchOrder) + capacity*sizeof(FlatSearchEntry));
+		if ( order == NULL )
+			return;		// keep searching the stale order, sFlatSearchOrderValid stays false so next search retries
+		order->readers = 0;
+		order->capacity = capacity;
+		if ( (sFlatSearchOrder != NULL) && (sFlatSearchOrder->readers == 0) )
+			free(sFlatSearchOrder);
+		sFlatSearchOrder = order;
+	}
+	order->count = imageCount;
+	for(uint32_t i=0; i < imageCount; ++i) {
+		ImageLoader* anImage = imageInSearchOrder(i);
+		FlatSearchEntry& entry = order->entries[i];
+		entry.image = anImage;
+		entry.hidden = anImage->hasHiddenExports();
+		entry.coalesced = anImage->hasCoalescedExports();
+		if ( !anImage->getExportTrie(&entry.trieStart, &entry.trieEnd) ) {
+			entry.trieStart = NULL;
+			entry.trieEnd = NULL;
+		}
+	}
+	sFlatSearchOrderHiddenGeneration = ImageLoader::hiddenExportsGeneration();
+	sFlatSearchOrderValid = true;
+}
+
+// caller must hold sFlatSymbolIndexLock, returns NULL if no image has been added yet
+static FlatSearchOrder* acquireFlatSearchOrder()
+{
+	updateFlatSearchOrder();
+	FlatSearchOrder* order = sFlatSearchOrder;
+	if ( order != NULL )
+		++order->readers;
+	return order;
+}
+
+// caller must hold sFlatSymbolIndexLock
+static void releaseFlatSearchOrderLocked(FlatSearchOrder* order)
+{
+	if ( order == NULL )
+		return;
+	// an order replaced while being walked is freed by its last reader
+	if ( (--order->readers == 0) && (order != sFlatSearchOrder) )
+		free(order);
+}
+
+static void releaseFlatSearchOrder(FlatSearchOrder* order)
+{
+	OSSpinLockLock(&sFlatSymbolIndexLock);
+	releaseFlatSearchOrderLocked(order);
+	OSSpinLockUnlock(&sFlatSymbolIndexLock);
+}
+
+//
+// Searches images in search order starting at startIndex.  On entry, the entry's found fields
+// hold any weak definition from images before startIndex.  On return they hold the first non-weak
+// definition, or else the first weak definition, or foundImage is NULL if not found at all.
+//
+// caller must have acquired order, which is not changed while it is walked
+static void searchImagesForExportedSymbol(const FlatSearchOrder* order, const char* name, bool onlyInCoalesced, size_t startIndex, FlatSymbolIndexEntry& entry)
+{
+	const size_t imageCount = (order != NULL) ? order->count : 0;
+	for(size_t i=startIndex; i < imageCount; ++i) {
+		const FlatSearchEntry& candidate = order->entries[i];
+		if ( candidate.hidden || (onlyInCoalesced && !candidate.coalesced) )
+			continue;
+		if ( candidate.trieStart != NULL ) {
+			// most images don't export name, rule them out from the trie alone
+			// (a malformed trie falls through, so findExportedSymbol() reports it)
+			bool malformed = false;
+			if ( candidate.trieStart == candidate.trieEnd )
+				continue;
+			if ( (dyld_trie_walk(candidate.trieStart, candidate.trieEnd, name, &malformed) == NULL) && !malformed )
+				continue;
+		}
+		ImageLoader* anImage = candidate.image;
+		const ImageLoader* foundIn;
+		const ImageLoader::Symbol* sym = anImage->findExportedSymbol(name, false, &foundIn);
+		if ( sym != NULL ) {
+			// if weak definition found, record first one found
+			if ( (foundIn->getExportedSymbolInfo(sym) & ImageLoader::kWeakDefinition) != 0 ) {
+				if ( entry.foundImage == NULL ) {
+					entry.foundImage = foundIn;
+					entry.foundSym = sym;
+					entry.searchedImage = anImage;
+					entry.foundIndex = (uint32_t)i;
+					entry.weak = true;
+				}
+			}
+			else {
+				// found non-weak, so immediately return with it
+				entry.foundImage = foundIn;
+				entry.foundSym = sym;
+				entry.searchedImage = anImage;
+				entry.foundIndex = (uint32_t)i;
+				entry.weak = false;
+				entry.searchedCount = (uint32_t)(i+1);
+				return;
+			}
+		}
+	}
+	entry.searchedCount = (uint32_t)imageCount;
+}
+
 static bool findExportedSymbol(const char* name, bool onlyInCoalesced, const ImageLoader::Symbol** sym, const ImageLoader** image)
 {
-	// search all images in order
-	const ImageLoader* firstWeakImage = NULL;
-	const ImageLoader::Symbol* firstWeakSym = NULL;
-	const size_t imageCount = sAllImages.size();
-	for(size_t i=0; i < imageCount; ++i) {
-		ImageLoader* anImage = sAllImages[i];
-		// the use of inserted libraries alters search order
-		// so that inserted libraries are found before the main executable
-		if ( sInsertedDylibCount > 0 ) {
-			if ( i < sInsertedDylibCount )
-				anImage = sAllImages[i+1];
-			else if ( i == sInsertedDylibCount )
-				anImage = sAllImages[0];
+	FlatSymbolIndexEntry result;
+	result.foundImage = NULL;
+	result.foundSym = NULL;
+	result.weak = false;
+
+	// coalesced lookups use a different image filter, so are not indexed
+	if ( onlyInCoalesced ) {
+		OSSpinLockLock(&sFlatSymbolIndexLock);
+		FlatSearchOrder* order = acquireFlatSearchOrder();
+		OSSpinLockUnlock(&sFlatSymbolIndexLock);
+		try {
+			searchImagesForExportedSymbol(order, name, true, 0, result);
 		}
-		if ( ! anImage->hasHiddenExports() && (!onlyInCoalesced || anImage->hasCoalescedExports()) ) {
-			*sym = anImage->findExportedSymbol(name, false, image);
-			if ( *sym != NULL ) {
-				// if weak definition found, record first one found
-				if ( ((*image)->getExportedSymbolInfo(*sym) & ImageLoader::kWeakDefinition) != 0 ) {
-					if ( firstWeakImage == NULL ) {
-						firstWeakImage = *image;
-						firstWeakSym = *sym;
-					}
+		catch (...) {
+			// malformed export info
+			releaseFlatSearchOrder(order);
+			throw;
+		}
+		releaseFlatSearchOrder(order);
+	}
+	else {
+		const uint32_t hash = ImageLoader::hash(name);
+		bool needSearch = true;
+		OSSpinLockLock(&sFlatSymbolIndexLock);
+		FlatSearchOrder* order = acquireFlatSearchOrder();
+		if ( sFlatSymbolIndex == NULL )
+			rehashFlatSymbolIndex(kFlatSymbolIndexInitialCapacity);
+		FlatSymbolIndexEntry* entry = (sFlatSymbolIndex != NULL) ? flatSymbolIndexSlot(sFlatSymbolIndex, sFlatSymbolIndexCapacity, name, hash) : NULL;
+		if ( (entry != NULL) && (entry->name != NULL) ) {
+			if ( (entry->foundImage != NULL) && entry->searchedImage->hasHiddenExports() ) {
+				// image that provided definition has since been made private, search again
+				entry->foundImage = NULL;
+				entry->searchedCount = 0;
+			}
+			if ( ((entry->foundImage != NULL) && !entry->weak) || (entry->searchedCount == sAllImages.size()) ) {
+				++sFlatSymbolIndexHits;
+				needSearch = false;
+			}
+			else {
+				++sFlatSymbolIndexMisses;
+			}
+			result = *entry;
+		}
+		else {
+			++sFlatSymbolIndexMisses;
+			result.searchedCount = 0;
+		}
+		if ( !needSearch )
+			releaseFlatSearchOrderLocked(order);
+		OSSpinLockUnlock(&sFlatSymbolIndexLock);
+
+		if ( needSearch ) {
+			// only search images not already searched for this entry
+			try {
+				searchImagesForExportedSymbol(order, name, false, result.searchedCount, result);
+			}
+			catch (...) {
+				// malformed export info
+				releaseFlatSearchOrder(order);
+				throw;
+			}
+			OSSpinLockLock(&sFlatSymbolIndexLock);
+			releaseFlatSearchOrderLocked(order);
+			// table may have been updated or grown by another thread while searching
+			entry = (sFlatSymbolIndex != NULL) ? flatSymbolIndexSlot(sFlatSymbolIndex, sFlatSymbolIndexCapacity, name, hash) : NULL;
+			if ( (entry != NULL) && (entry->name != NULL) ) {
+				if ( entry->searchedCount < result.searchedCount ) {
+					const char* entryName = entry->name;
+					*entry = result;
+					entry->name = entryName;
+					entry->hash = hash;
 				}
-				else {
-					// found non-weak, so immediately return with it
-					return true;
+			}
+			else if ( entry != NULL ) {
+				// add to index, growing table to keep load factor under 3/4
+				if ( (sFlatSymbolIndexCount+1)*4 > sFlatSymbolIndexCapacity*3 ) {
+					if ( (sFlatSymbolIndexCapacity < kFlatSymbolIndexMaxCapacity) && rehashFlatSymbolIndex(sFlatSymbolIndexCapacity*2) ) 
+						entry = flatSymbolIndexSlot(sFlatSymbolIndex, sFlatSymbolIndexCapacity, name, hash);
+					else 
+						entry = NULL;
+				}
+				if ( entry != NULL ) {
+					char* nameCopy = (char*)malloc(strlen(name)+1);
+					if ( nameCopy != NULL ) {
+						strcpy(nameCopy, name);
+						*entry = result;
+						entry->name = nameCopy;
+						entry->hash = hash;
+						++sFlatSymbolIndexCount;
+					}
 				}
 			}
+			OSSpinLockUnlock(&sFlatSymbolIndexLock);
 		}
 	}
-	if ( firstWeakSym != NULL ) {
-		// found a weak definition, but no non-weak, so return first weak found
-		*sym = firstWeakSym;
-		*image = firstWeakImage;
+
+	if ( result.foundImage != NULL ) {
+		// return non-weak, or if none, the first weak found
+		*sym = result.foundSym;
+		*image = result.foundImage;
 		return true;
 	}
-	
+
 	return false;
 }
 
@@ -4025,6 +5496,40 @@ static ImageLoader* libraryLocator(const char* libraryName, bool search, const c
 	return load(libraryName, context);
 }
 
+static void libraryPrefetcher(const char* libraryName, const char* origin, const ImageLoader::RPathChain* rpaths)
+{
+	dyld::LoadContext context;
+	context.useSearchPaths		= true;
+	context.useFallbackPaths	= true;
+	context.useLdLibraryPath	= false;
+	context.implicitRPath		= false;
+	context.matchByInstallName	= false;
+	context.dontLoad			= true;
+	context.mustBeBundle		= false;
+	context.mustBeDylib			= true;
+	context.canBePIE			= false;
+	context.origin				= origin;
+	context.rpath				= rpaths;
+	
+	// nothing to do if already loaded
+	if ( loadPhase0(libraryName, libraryName, context, NULL) != NULL )
+		return;
+	
+	std::vector<const char*> exceptions;
+	sPrefetchOnly = true;
+	sPrefetchFound = false;
+	try {
+		loadPhase0(libraryName, libraryName, context, &exceptions);
+	}
+	catch (const char* msg) {
+		// prefetching is only a hint, the real load will report any problem
+		free((void*)msg);
+	}
+	sPrefetchOnly = false;
+	for (std::vector<const char*>::iterator it = exceptions.begin(); it != exceptions.end(); ++it) 
+		free((void*)(*it));
+}
+
 static const char* basename(const char* path)
 {
     const char* last = path;
@@ -4038,6 +5543,7 @@ static const char* basename(const char* path)
 static void setContext(const macho_header* mainExecutableMH, int argc, const char* argv[], const char* envp[], const char* apple[])
 {
 	gLinkContext.loadLibrary			= &libraryLocator;
+	gLinkContext.prefetchLibrary		= &libraryPrefetcher;
 	gLinkContext.terminationRecorder	= &terminationRecorder;
 	gLinkContext.flatExportFinder		= &flatFindExportedSymbol;
 	gLinkContext.coalescedExportFinder	= &findCoalescedExportedSymbol;
@@ -4062,6 +5568,8 @@ static void setContext(const macho_header* mainExecutableMH, int argc, const cha
 #endif
 	gLinkContext.findImageContainingAddress	= &findImageContainingAddress;
 	gLinkContext.addDynamicReference	= &addDynamicReference;
+	gLinkContext.recordLaunchClosureBind = NULL;
+	gLinkContext.applyLaunchClosureBinds = NULL;
 	gLinkContext.bindingOptions			= ImageLoader::kBindingNone;
 	gLinkContext.argc					= argc;
 	gLinkContext.argv					= argv;
@@ -4141,9 +5649,18 @@ static bool readFirstPage(const char* dylibPath, uint8_t firstPage[4096])
 	if ( fileStartAsFat->magic == OSSwapBigToHostInt32(FAT_MAGIC) ) {
 		uint64_t fileOffset;
 		uint64_t fileLength;
-		if ( fatFindBest(fileStartAsFat, &fileOffset, &fileLength) ) {
+		struct stat stat_buf;
+		bool haveIdentity = ( fstat(file.getFileDescriptor(), &stat_buf) == 0 );
+		if ( haveIdentity && fatSliceMemoLookup(stat_buf, &fileOffset, &fileLength) ) {
+			if ( pread(file.getFileDescriptor(), firstPage, 4096, fileOffset) != 4096 )
+				return false;
+		}
+		else if ( fatFindBest(fileStartAsFat, &fileOffset, &fileLength) ) {
 			if ( pread(file.getFileDescriptor(), firstPage, 4096, fileOffset) != 4096 )
 				return false;
+			// remember the choice so loading this file later reads the slice directly
+			if ( haveIdentity )
+				fatSliceMemoRecord(stat_buf, fileOffset, fileLength, ((mach_header*)firstPage)->cpusubtype);
 		}
 		else {
 			return false;
@@ -4368,6 +5885,7 @@ static void preflight_finally(ImageLoader* image)
 {
 	if ( image->isBundle() ) {
 		removeImageFromAllImages(image->machHeader());
+		removeImageFromStateBuckets(image);
 		ImageLoader::deleteImage(image);
 	}
 	sBundleBeingLoaded = NULL;
@@ -4850,6 +6368,8 @@ _main(const macho_header* mainExecutableMH, uintptr_t mainExecutableSlide,
 		// add dyld itself to UUID list
 		addDyldImageToUUIDList();
 		CRSetCrashLogMessage(sLoadingCrashMessage);
+		// images loaded until the main executable is linked are never unloaded, so allocate them in load order together
+		ImageLoader::setArenaEnabled(true);
 		// instantiate ImageLoader for main executable
 		sMainExecutable = instantiateFromLoadedImage(mainExecutableMH, mainExecutableSlide, sExecPath);
 		gLinkContext.mainExecutable = sMainExecutable;
@@ -4899,9 +6419,17 @@ _main(const macho_header* mainExecutableMH, uintptr_t mainExecutableSlide,
 		// record count of inserted libraries so that a flat search will look at 
 		// inserted libraries, then main, then others.
 		sInsertedDylibCount = sAllImages.size()-1;
+		flushFlatSymbolIndex();
+
+	#if !TARGET_IPHONE_SIMULATOR
+		// a launch closure is checked against images as they are bound
+		if ( sLaunchClosurePath != NULL )
+			loadLaunchClosure();
+	#endif
 
 		// link main executable
 		gLinkContext.linkingMainExecutable = true;
+		gLinkContext.insertedLibraries = (sInsertedDylibCount > 0);
 		link(sMainExecutable, sEnv.DYLD_BIND_AT_LAUNCH, true, ImageLoader::RPathChain(NULL, NULL));
 		sMainExecutable->setNeverUnloadRecursive();
 		if ( sMainExecutable->forceFlat() ) {
@@ -4938,7 +6466,17 @@ _main(const macho_header* mainExecutableMH, uintptr_t mainExecutableSlide,
 		for(int i=0; i < sImageRoots.size(); ++i) {
 			sImageRoots[i]->applyInterposing(gLinkContext);
 		}
+		// bind info decoded during launch is only kept if interposing tuples can reuse it
+		if ( !ImageLoader::hasInterposingTuples() ) {
+			for (std::vector<ImageLoader*>::iterator it=sAllImages.begin(); it != sAllImages.end(); it++) {
+				(*it)->releaseDecodedBindInfo();
+			}
+		}
+	#if !TARGET_IPHONE_SIMULATOR
+		saveLaunchClosure();
+	#endif
 		gLinkContext.linkingMainExecutable = false;
+		ImageLoader::setArenaEnabled(false);
 		
 		// <rdar://problem/12186933> do weak binding only after all inserted images linked
 		sMainExecutable->weakBind(gLinkContext);
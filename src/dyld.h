@@ -86,10 +86,13 @@ namespace dyld {
 	extern ImageLoader*			findImageByName(const char* path);
 	extern ImageLoader*			findLoadedImageByInstallPath(const char* path);
 	extern bool					flatFindExportedSymbol(const char* name, const ImageLoader::Symbol** sym, const ImageLoader** image);
+	extern void					flushFlatSymbolIndex();
+	extern void					flushPathProbeCache();
 	extern bool					flatFindExportedSymbolWithHint(const char* name, const char* librarySubstring, const ImageLoader::Symbol** sym, const ImageLoader** image);
 	extern ImageLoader*			load(const char* path, const LoadContext& context);
 	extern ImageLoader*			loadFromMemory(const uint8_t* mem, uint64_t len, const char* moduleName);
 	extern void					removeImage(ImageLoader* image);
+	extern void					removeImageFromStateBuckets(const ImageLoader* image);
 	extern ImageLoader*			cloneImage(ImageLoader* image);
 	extern void					forEachImageDo( void (*)(ImageLoader*, void*), void*);
 	extern uintptr_t			_main(const macho_header* mainExecutableMH, uintptr_t mainExecutableSlide, int argc, const char* argv[], const char* envp[],
@@ -117,5 +120,6 @@ namespace dyld {
 	extern const char*			getStandardSharedCacheFilePath();
 	extern int					my_stat(const char* path, struct stat* buf);
 	extern int					my_open(const char* path, int flag, int other);
+	extern void					getPoolStatistics(uint64_t* bytesLive, uint64_t* bytesPeak, uint64_t* bytesWasted, uint32_t* largeAllocations);
 }
 
@@ -151,6 +151,7 @@ static struct dyld_func dyld_funcs[] = {
 	{"__dyld_shared_cache_file_path",					(void*)dyld::getStandardSharedCacheFilePath },
 #endif
     {"__dyld_get_image_header_containing_address",		(void*)dyld_image_header_containing_address },
+    {"__dyld_dladdr_batch",								(void*)dladdr_batch },
 
 	// deprecated
 #if DEPRECATED_APIS_SUPPORTED
@@ -862,6 +863,7 @@ bool NSDestroyObjectFileImage(NSObjectFileImage objectFileImage)
 			// and we should delete it
 			bool linkedImage = dyld::validImage(objectFileImage->image);
 			if ( ! linkedImage )  {
+				dyld::removeImageFromStateBuckets(objectFileImage->image);
 				ImageLoader::deleteImage(objectFileImage->image);
 				objectFileImage->image = NULL;
 			}
@@ -1235,6 +1237,8 @@ static bool NSMakePrivateModulePublic(NSModule module)
 	if ( image != NULL ) {
 		if ( image->hasHiddenExports() ) {
 			image->setHideExports(false);
+			// exports now visible to flat lookups that may have skipped this image
+			dyld::flushFlatSymbolIndex();
 			return true;
 		}
 	}
@@ -1468,6 +1472,10 @@ void* dlopen(const char* path, int mode)
 		context.origin			= callerImage != NULL ? callerImage->getPath() : NULL; // caller's image's path
 		context.rpath			= &callersRPaths;				// rpaths from caller and main executable
 		
+		// RTLD_NOCACHE means files may have been added to search paths since they were last probed
+		if ( (mode & RTLD_NOCACHE) != 0 )
+			dyld::flushPathProbeCache();
+		
 		image = load(path, context);
 		if ( image != NULL ) {
 			// bump reference count.  Do this before link() so that if an initializer calls dlopen and fails
@@ -1588,6 +1596,37 @@ int dlclose(void* handle)
 
 
 
+struct AddressIndexSorter
+{
+					AddressIndexSorter(const void* const addrs[]) : fAddrs(addrs) {}
+	bool			operator()(size_t left, size_t right) const { return (fAddrs[left] < fAddrs[right]); }
+	const void* const* fAddrs;
+};
+
+// fill in one Dl_info the same way dladdr() does, given the closest symbol found
+static void setDladdrInfo(const ImageLoader* image, const void* address, const char* symbolName, const void* symbolAddress, Dl_info* info)
+{
+	info->dli_fname = image->getRealPath();
+	info->dli_fbase = (void*)image->machHeader();
+	if ( address == info->dli_fbase ) {
+		// special case lookup of header
+		info->dli_sname = "__dso_handle";
+		info->dli_saddr = info->dli_fbase;
+	}
+	else if ( (symbolName == NULL) || (symbolAddress == info->dli_fbase) ) {
+		// never return the mach_header symbol
+		info->dli_sname = NULL;
+		info->dli_saddr = NULL;
+	}
+	else {
+		if ( symbolName[0] == '_' )
+			symbolName = symbolName +1; // strip off leading underscore
+		info->dli_sname = symbolName;
+		info->dli_saddr = (void*)symbolAddress;
+	}
+}
+
+
 int dladdr(const void* address, Dl_info* info)
 {
 	if ( dyld::gLogAPIs )
@@ -1596,33 +1635,13 @@ int dladdr(const void* address, Dl_info* info)
 	CRSetCrashLogMessage("dyld: in dladdr()");
 	ImageLoader* image = dyld::findImageContainingAddress(address);
 	if ( image != NULL ) {
-		info->dli_fname = image->getRealPath();
-		info->dli_fbase = (void*)image->machHeader();
-		if ( address == info->dli_fbase ) {
-			// special case lookup of header
-			info->dli_sname = "__dso_handle";
-			info->dli_saddr = info->dli_fbase;
-			CRSetCrashLogMessage(NULL);
-			return 1; // success
-		}
-		// find closest symbol in the image
-		info->dli_sname = image->findClosestSymbol(address, (const void**)&info->dli_saddr);
-		// never return the mach_header symbol
-		if ( info->dli_saddr == info->dli_fbase ) {
-			info->dli_sname = NULL;
-			info->dli_saddr = NULL;
-			CRSetCrashLogMessage(NULL);
-			return 1; // success
-		}
-		if ( info->dli_sname != NULL ) {
-			if ( info->dli_sname[0] == '_' )
-				info->dli_sname = info->dli_sname +1; // strip off leading underscore
-			//dyld::log("dladdr(%p) => %p %s\n", address, info->dli_saddr, info->dli_sname);
-			CRSetCrashLogMessage(NULL);
-			return 1; // success
-		}
-		info->dli_sname = NULL;
-		info->dli_saddr = NULL;
+		const char* symbolName = NULL;
+		const void* symbolAddress = NULL;
+		// find closest symbol in the image, no need for lookup of header
+		if ( address != (void*)image->machHeader() )
+			symbolName = image->findClosestSymbol(address, &symbolAddress);
+		setDladdrInfo(image, address, symbolName, symbolAddress, info);
+		//dyld::log("dladdr(%p) => %p %s\n", address, info->dli_saddr, info->dli_sname);
 		CRSetCrashLogMessage(NULL);
 		return 1; // success
 	}
@@ -1631,6 +1650,56 @@ int dladdr(const void* address, Dl_info* info)
 }
 
 
+//
+// Symbolicating a backtrace with dladdr() looks up the image and searches its symbols 
+// once per frame.  Here the addresses are visited in sorted order, so each run of 
+// addresses in the same image is resolved with one image lookup and one pass over 
+// that image's symbols.  Returns the number of addresses found in some image.
+//
+size_t dladdr_batch(const void* const addrs[], Dl_info out[], size_t count)
+{
+	if ( dyld::gLogAPIs )
+		dyld::log("%s(%p, %p, %lu)\n", __func__, addrs, out, count);
+
+	CRSetCrashLogMessage("dyld: in dladdr_batch()");
+	std::vector<size_t> order;
+	order.reserve(count);
+	for (size_t i=0; i < count; ++i)
+		order.push_back(i);
+	std::sort(order.begin(), order.end(), AddressIndexSorter(addrs));
+
+	std::vector<const void*> groupAddrs;
+	std::vector<const char*> groupNames;
+	std::vector<const void*> groupClosest;
+	size_t found = 0;
+	for (size_t start=0; start < count; ) {
+		ImageLoader* image = dyld::findImageContainingAddress(addrs[order[start]]);
+		if ( image == NULL ) {
+			bzero(&out[order[start]], sizeof(Dl_info));
+			++start;
+			continue;
+		}
+		// gather run of addresses in this image
+		size_t end = start+1;
+		while ( (end < count) && image->containsAddress(addrs[order[end]]) )
+			++end;
+		const unsigned int groupCount = (unsigned int)(end - start);
+		groupAddrs.resize(groupCount);
+		groupNames.resize(groupCount);
+		groupClosest.resize(groupCount);
+		for (unsigned int i=0; i < groupCount; ++i)
+			groupAddrs[i] = addrs[order[start+i]];
+		image->findClosestSymbols(&groupAddrs[0], groupCount, &groupNames[0], &groupClosest[0]);
+		for (unsigned int i=0; i < groupCount; ++i)
+			setDladdrInfo(image, groupAddrs[i], groupNames[i], groupClosest[i], &out[order[start+i]]);
+		found += groupCount;
+		start = end;
+	}
+	CRSetCrashLogMessage(NULL);
+	return found;
+}
+
+
 char* dlerror()
 {
 	if ( dyld::gLogAPIs )
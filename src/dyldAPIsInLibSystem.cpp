@@ -1290,6 +1290,7 @@ bool _dyld_all_twolevel_modules_prebound(void)
 #include <stddef.h>
 #include <pthread.h>
 #include <stdlib.h>
+#include <libkern/OSAtomic.h>
 #include <mach-o/dyld.h>
 #include <servers/bootstrap.h>
 #include "dyldLibSystemInterface.h"
@@ -1298,6 +1299,7 @@ bool _dyld_all_twolevel_modules_prebound(void)
 // pthread key used to access per-thread dlerror message
 static pthread_key_t dlerrorPerThreadKey;
 static bool dlerrorPerThreadKeyInitialized = false;
+static pthread_once_t dlerrorPerThreadKeyOnce = PTHREAD_ONCE_INIT;
 
 // data kept per-thread
 struct dlerrorPerThreadData
@@ -1306,15 +1308,19 @@ struct dlerrorPerThreadData
 	char		message[1];
 };
 
+static void create_dlerrorPerThreadKey()
+{
+	// create key and tell pthread package to call free() on any data associated with key if thread dies
+	pthread_key_create(&dlerrorPerThreadKey, &free);
+	OSMemoryBarrier();
+	dlerrorPerThreadKeyInitialized = true;
+}
+
 // function called by dyld to get buffer to store dlerror message
 static char* getPerThreadBufferFor_dlerror(size_t sizeRequired)
 {
-	// ok to create key lazily because this function is called within dyld lock, so there is no race condition
-	if (!dlerrorPerThreadKeyInitialized ) {
-		// create key and tell pthread package to call free() on any data associated with key if thread dies
-		pthread_key_create(&dlerrorPerThreadKey, &free);
-		dlerrorPerThreadKeyInitialized = true;
-	}
+	// dlsym() calls this from a read section, so other threads may be here too
+	pthread_once(&dlerrorPerThreadKeyOnce, &create_dlerrorPerThreadKey);
 
 	const size_t size = (sizeRequired < 256) ? 256 : sizeRequired;
 	dlerrorPerThreadData* data = (dlerrorPerThreadData*)pthread_getspecific(dlerrorPerThreadKey);
@@ -1377,7 +1383,7 @@ static void shared_cache_out_of_date()
 
 
 // the table passed to dyld containing thread helpers
-static dyld::LibSystemHelpers sHelpers = { 13, &dyldGlobalLockAcquire, &dyldGlobalLockRelease,
+static dyld::LibSystemHelpers sHelpers = { 14, &dyldGlobalLockAcquire, &dyldGlobalLockRelease,
 									&getPerThreadBufferFor_dlerror, &malloc, &free, &__cxa_atexit,
 						#if DYLD_SHARED_CACHE_SUPPORT
 									&shared_cache_missing, &shared_cache_out_of_date,
@@ -1394,7 +1400,9 @@ static dyld::LibSystemHelpers sHelpers = { 13, &dyldGlobalLockAcquire, &dyldGlob
 									&isLaunchdOwned,
 									&vm_allocate,
 									&mmap,
-									&__cxa_finalize_ranges};
+									&__cxa_finalize_ranges,
+									&dyldReadSectionEnter,
+									&dyldReadSectionExit};
 
 
 //
@@ -1435,6 +1443,16 @@ int dladdr(const void* addr, Dl_info* info)
 	return(p(addr, info));
 }
 
+size_t dladdr_batch(const void* const addrs[], Dl_info out[], size_t count)
+{
+	DYLD_LOCK_THIS_BLOCK;
+    static size_t (*p)(const void* const [], Dl_info [], size_t) = NULL;
+
+	if(p == NULL)
+	    _dyld_func_lookup("__dyld_dladdr_batch", (void**)&p);
+	return(p(addrs, out, count));
+}
+
 int dlclose(void* handle)
 {
 	DYLD_LOCK_THIS_BLOCK;
@@ -1475,9 +1493,17 @@ bool dlopen_preflight(const char* path)
 
 void* dlsym(void* handle, const char* symbol)
 {
-	DYLD_LOCK_THIS_BLOCK;
     static void* (*p)(void* handle, const char* symbol) = NULL;
 
+	// searching a real handle only reads dyld's data structures, so threads can do it concurrently
+	if ( (handle != RTLD_DEFAULT) && (handle != RTLD_NEXT) && (handle != RTLD_SELF) && (handle != RTLD_MAIN_ONLY) ) {
+		DYLD_READ_LOCK_THIS_BLOCK;
+		if(p == NULL)
+			_dyld_func_lookup("__dyld_dlsym", (void**)&p);
+		return(p(handle, symbol));
+	}
+
+	DYLD_LOCK_THIS_BLOCK;
 	if(p == NULL)
 	    _dyld_func_lookup("__dyld_dlsym", (void**)&p);
 	return(p(handle, symbol));
@@ -1605,6 +1631,8 @@ void _dyld_fork_child()
 
 	if(p == NULL)
 	    _dyld_func_lookup("__dyld_fork_child", (void**)&p);
+	// threads in read sections or waiting to acquire the global lock did not survive the fork
+	dyldGlobalLockForkChild();
 	return p();
 }
 
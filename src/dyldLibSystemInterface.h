@@ -74,6 +74,9 @@ namespace dyld {
 		void*		(*mmap)(void* addr, size_t len, int prot, int flags, int fd, off_t offset);
 		// added in version 13
 		void		(*cxa_finalize_ranges)(const struct __cxa_range_t ranges[], int count);
+		// added in version 14
+		bool		(*enterReadSection)();
+		void		(*exitReadSection)();
 	};
 #if __cplusplus
 }
@@ -23,6 +23,9 @@
  */
 
 #include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <libkern/OSAtomic.h>
 
 #include "dyldLock.h"
 
@@ -33,6 +36,82 @@ static pthread_mutex_t	sGlobalMutex = PTHREAD_RECURSIVE_MUTEX_INITIALIZER;
 // <rdar://problem/6361143> Need a way to determine if a gdb call to dlopen() would block
 int	__attribute__((visibility("hidden")))			_dyld_global_lock_held = 0;
 
+//
+// Read sections: a reader bumps sReaders, then checks sWriterActive.  The outermost acquire
+// of the global lock sets sWriterActive, then waits for sReaders to drain.  With a barrier
+// on both sides, either the reader sees the writer and backs off to the global lock, or
+// the writer sees the reader and waits for it.  Each thread's read section depth is kept
+// in thread specific data, so a read section that calls something needing the global lock
+// (e.g. a symbol resolver calling dlopen) steps out of its read sections while it holds it.
+// A writer yields briefly for read sections to drain, then sleeps on sReadersDrained, which
+// the thread that takes sReaders to zero signals.
+//
+enum { kWriterSpinCount = 100 };
+
+static volatile int32_t	sReaders = 0;
+static volatile int32_t	sWriterActive = 0;
+static pthread_t		sGlobalLockOwner = NULL;
+static pthread_key_t	sReadDepthKey;
+static pthread_once_t	sReadDepthKeyOnce = PTHREAD_ONCE_INIT;
+static pthread_mutex_t	sReadersDrainedMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	sReadersDrained = PTHREAD_COND_INITIALIZER;
+
+
+static void createReadDepthKey()
+{
+	pthread_key_create(&sReadDepthKey, NULL);
+}
+
+static int32_t readDepth()
+{
+	pthread_once(&sReadDepthKeyOnce, &createReadDepthKey);
+	return (int32_t)(intptr_t)pthread_getspecific(sReadDepthKey);
+}
+
+static void setReadDepth(int32_t depth)
+{
+	pthread_setspecific(sReadDepthKey, (void*)(intptr_t)depth);
+}
+
+// take count read sections out of sReaders, waking a writer waiting for them to drain
+static void leaveReadSections(int32_t count)
+{
+	if ( (OSAtomicAdd32Barrier(-count, &sReaders) == 0) && (sWriterActive != 0) ) {
+		pthread_mutex_lock(&sReadersDrainedMutex);
+		pthread_cond_signal(&sReadersDrained);
+		pthread_mutex_unlock(&sReadersDrainedMutex);
+	}
+}
+
+// called by the outermost acquire of the global lock, after setting sWriterActive
+static void waitForReadSectionsToDrain()
+{
+	for (int i=0; i < kWriterSpinCount; ++i) {
+		if ( sReaders == 0 )
+			return;
+		sched_yield();
+	}
+	// checked under the mutex, so a reader leaving after the check signals only once this thread waits
+	pthread_mutex_lock(&sReadersDrainedMutex);
+	while ( sReaders != 0 )
+		pthread_cond_wait(&sReadersDrained, &sReadersDrainedMutex);
+	pthread_mutex_unlock(&sReadersDrainedMutex);
+}
+
+// add this thread's read sections back, waiting out any writer
+static void rejoinReadSections(int32_t depth)
+{
+	for (;;) {
+		OSAtomicAdd32Barrier(depth, &sReaders);
+		if ( sWriterActive == 0 )
+			return;
+		leaveReadSections(depth);
+		// block until writer releases global lock
+		pthread_mutex_lock(&sGlobalMutex);
+		pthread_mutex_unlock(&sGlobalMutex);
+	}
+}
+
 
 LockHelper::LockHelper() 
 { 
@@ -44,16 +123,85 @@ LockHelper::~LockHelper()
 	dyldGlobalLockRelease();
 }
 
+ReadLockHelper::ReadLockHelper() 
+{ 
+	fTookGlobalLock = !dyldReadSectionEnter();
+	if ( fTookGlobalLock )
+		dyldGlobalLockAcquire();
+}
+
+ReadLockHelper::~ReadLockHelper() 
+{ 
+	if ( fTookGlobalLock )
+		dyldGlobalLockRelease();
+	else
+		dyldReadSectionExit();
+}
+
 void dyldGlobalLockAcquire() 
 {
+	if ( pthread_equal(sGlobalLockOwner, pthread_self()) ) {
+		// recursive acquire, read sections were already drained
+		pthread_mutex_lock(&sGlobalMutex);
+		++_dyld_global_lock_held;
+		return;
+	}
+	int32_t depth = readDepth();
+	if ( depth != 0 )
+		leaveReadSections(depth);
 	pthread_mutex_lock(&sGlobalMutex);
 	++_dyld_global_lock_held;
+	sGlobalLockOwner = pthread_self();
+	sWriterActive = 1;
+	OSMemoryBarrier();
+	waitForReadSectionsToDrain();
 }
 
 void dyldGlobalLockRelease() 
 {
-	--_dyld_global_lock_held;
-	pthread_mutex_unlock(&sGlobalMutex);
+	if ( --_dyld_global_lock_held == 0 ) {
+		sGlobalLockOwner = NULL;
+		OSMemoryBarrier();
+		sWriterActive = 0;
+		pthread_mutex_unlock(&sGlobalMutex);
+		int32_t depth = readDepth();
+		if ( depth != 0 )
+			rejoinReadSections(depth);
+	}
+	else {
+		pthread_mutex_unlock(&sGlobalMutex);
+	}
 }
 
+bool dyldReadSectionEnter()
+{
+	OSAtomicIncrement32Barrier(&sReaders);
+	if ( sWriterActive != 0 ) {
+		// some thread (maybe this one) holds the global lock
+		leaveReadSections(1);
+		return false;
+	}
+	setReadDepth(readDepth()+1);
+	return true;
+}
+
+void dyldReadSectionExit()
+{
+	setReadDepth(readDepth()-1);
+	leaveReadSections(1);
+}
+
+// only the thread that called fork() exists in the child, so only its read sections and lock remain
+void dyldGlobalLockForkChild()
+{
+	pthread_mutex_t drainedMutex = PTHREAD_MUTEX_INITIALIZER;
+	pthread_cond_t drained = PTHREAD_COND_INITIALIZER;
+	sReadersDrainedMutex = drainedMutex;
+	sReadersDrained = drained;
+	sReaders = readDepth();
+	if ( !pthread_equal(sGlobalLockOwner, pthread_self()) ) {
+		sGlobalLockOwner = NULL;
+		sWriterActive = 0;
+	}
+}
 
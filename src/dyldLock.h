@@ -47,7 +47,19 @@
 //	}
 //
 
+// An API that only reads dyld's data structures (dlsym() with a real handle) can instead use 
+// DYLD_READ_LOCK_THIS_BLOCK.  Any number of threads can be in read sections at once.  Taking 
+// the global lock waits for read sections on other threads to finish, and a read section
+// started while another thread holds the global lock takes the global lock instead.
+//
+//  void dyld_api_read_only() {
+//		DYLD_READ_LOCK_THIS_BLOCK;
+//		// can only read dyld internal data structures here
+//	}
+//
+
 #define DYLD_LOCK_THIS_BLOCK			LockHelper _dyld_lock;
+#define DYLD_READ_LOCK_THIS_BLOCK		ReadLockHelper _dyld_read_lock;
 #define DYLD_NO_LOCK_THIS_BLOCK
 
 // used by dyld wrapper functions in libSystem
@@ -59,10 +71,24 @@ public:
 };
 
 
+// used by dyld wrapper functions in libSystem for read-only APIs
+class __attribute__((visibility("hidden"))) ReadLockHelper
+{
+public:
+	ReadLockHelper();
+	~ReadLockHelper();
+private:
+	bool	fTookGlobalLock;
+};
+
+
 // to initialize
 extern void dyldGlobalLockInitialize()		__attribute__((visibility("hidden")));
 extern void dyldGlobalLockAcquire()			__attribute__((visibility("hidden")));
 extern void dyldGlobalLockRelease()			__attribute__((visibility("hidden")));
+extern bool dyldReadSectionEnter()			__attribute__((visibility("hidden")));
+extern void dyldReadSectionExit()			__attribute__((visibility("hidden")));
+extern void dyldGlobalLockForkChild()		__attribute__((visibility("hidden")));
 
 #endif // __DYLDLOCK__
 
@@ -27,7 +27,9 @@
 #include <stdint.h>
 #include <string.h>
 #include <mach/mach.h>
+#include <mach/vm_param.h>
 #include <sys/mman.h>
+#include <libkern/OSAtomic.h>
 
 extern "C" void* __dso_handle;
 
@@ -38,6 +40,11 @@ extern "C" void* __dso_handle;
 //	 dyld initially allocates all memory from a pool inside dyld.
 //   Once libSystem.dylib is initialized, dyld uses libSystem's malloc/free.
 //
+//   The pool is carved into 4KB slabs, each holding blocks of one size class.  Freed blocks
+//   go on a free list per size class and are reused, so dlopen()/dlclose() cycles before
+//   libSystem is initialized (or in a dyld that never gets libSystem helpers) do not grow
+//   the pool.  Allocations too big for a size class get their own vm_allocate()d region.
+//
 
 #if __LP64__
 	// room for about ~1000 initial dylibs
@@ -47,17 +54,238 @@ extern "C" void* __dso_handle;
 	#define DYLD_POOL_CHUNK_SIZE 150*1024
 #endif
 
+enum { kSlabSize = 4096, kSlabsPerPool = DYLD_POOL_CHUNK_SIZE/kSlabSize, kSizeClassCount = 18 };
+
+// all multiples of 16, so every block is 16 byte aligned
+static const uint16_t sSizeClasses[kSizeClassCount] = { 16, 32, 48, 64, 80, 96, 128, 160, 192, 256, 320, 384, 512, 768, 1024, 1536, 2048, 4096 };
+
 struct dyld_static_pool {
 	dyld_static_pool*	previousPool;
-	uint8_t*			current;
+	uint8_t*			start;			// first slab
+	uint8_t*			current;		// next slab to carve
 	uint8_t*			end;
-	uint8_t				pool[1]; 
+	uint8_t				slabSizeClass[kSlabsPerPool];
 };
 
+struct dyld_free_block {
+	dyld_free_block*	next;
+};
+
+// header in front of each allocation too big for a size class
+struct dyld_large_allocation {
+	dyld_large_allocation*	next;
+	size_t					size;		// bytes allocated, including this header
+	size_t					requested;	// bytes asked for
+} __attribute__((__aligned__(16)));
+
 // allocate initial pool independently of pool header to take less space on disk
 static uint8_t initialPoolContent[DYLD_POOL_CHUNK_SIZE] __attribute__((__aligned__(16)));
-static dyld_static_pool initialPool = { NULL, initialPoolContent, &initialPoolContent[DYLD_POOL_CHUNK_SIZE] };
+static dyld_static_pool initialPool = { NULL, initialPoolContent, initialPoolContent, &initialPoolContent[DYLD_POOL_CHUNK_SIZE] };
 static dyld_static_pool* currentPool = &initialPool;
+static dyld_free_block* sFreeBlocks[kSizeClassCount];
+static dyld_large_allocation* sLargeAllocations = NULL;
+static OSSpinLock sPoolLock = 0;
+
+// Exact regions handed out by vm_allocate(), so free() can reject libSystem pointers without sPoolLock.
+// A slot is one pointer, so is read atomically.  Pools are never freed, a large allocation slot is
+// cleared when freed and reused later.  A pointer being freed was returned by malloc() earlier, so its
+// slot is not changed while free() scans.  If slots run out, every pointer is checked under the lock.
+enum { kMaxPoolRegions = 32, kMaxLargeRegions = 64 };
+static uint8_t* volatile sPoolRegions[kMaxPoolRegions];			// start of each vm_allocate()d pool
+static dyld_large_allocation* volatile sLargeRegions[kMaxLargeRegions];
+static volatile bool sPoolRegionsOverflowed = false;
+
+// statistics
+static uint64_t sPoolBytesLive = 0;
+static uint64_t sPoolBytesPeak = 0;
+static uint64_t sPoolBytesReserved = DYLD_POOL_CHUNK_SIZE;		// pools plus large allocations
+static uint32_t sLargeAllocationCount = 0;
+
+
+static int sizeClassFor(size_t size)
+{
+	for (int i=0; i < kSizeClassCount; ++i) {
+		if ( size <= sSizeClasses[i] )
+			return i;
+	}
+	return -1;
+}
+
+// caller holds sPoolLock
+static void addPoolRegion(uint8_t* start)
+{
+	for (int i=0; i < kMaxPoolRegions; ++i) {
+		if ( sPoolRegions[i] == NULL ) {
+			sPoolRegions[i] = start;
+			return;
+		}
+	}
+	sPoolRegionsOverflowed = true;
+}
+
+// caller holds sPoolLock
+static void addLargeRegion(dyld_large_allocation* large)
+{
+	for (int i=0; i < kMaxLargeRegions; ++i) {
+		if ( sLargeRegions[i] == NULL ) {
+			sLargeRegions[i] = large;
+			return;
+		}
+	}
+	sPoolRegionsOverflowed = true;
+}
+
+// caller holds sPoolLock
+static void removeLargeRegion(dyld_large_allocation* large)
+{
+	for (int i=0; i < kMaxLargeRegions; ++i) {
+		if ( sLargeRegions[i] == large ) {
+			sLargeRegions[i] = NULL;
+			return;
+		}
+	}
+}
+
+// may be called without sPoolLock, false means ptr is definitely not from the pool
+static bool mayBePoolPointer(const void* ptr)
+{
+	if ( (initialPoolContent <= ptr) && (ptr < &initialPoolContent[DYLD_POOL_CHUNK_SIZE]) )
+		return true;
+	if ( sPoolRegionsOverflowed )
+		return true;
+	for (int i=0; i < kMaxPoolRegions; ++i) {
+		const uint8_t* start = sPoolRegions[i];
+		if ( start == NULL )
+			break;
+		if ( (start <= ptr) && (ptr < &start[DYLD_POOL_CHUNK_SIZE]) )
+			return true;
+	}
+	for (int i=0; i < kMaxLargeRegions; ++i) {
+		const dyld_large_allocation* large = sLargeRegions[i];
+		if ( (large != NULL) && (ptr == &large[1]) )
+			return true;
+	}
+	return false;
+}
+
+static void addLiveBytes(size_t size)
+{
+	sPoolBytesLive += size;
+	if ( sPoolBytesLive > sPoolBytesPeak )
+		sPoolBytesPeak = sPoolBytesLive;
+}
+
+static bool addPool()
+{
+	vm_address_t addr = 0;
+	kern_return_t r = vm_allocate(mach_task_self(), &addr, DYLD_POOL_CHUNK_SIZE, VM_FLAGS_ANYWHERE);
+	if ( r != KERN_SUCCESS )
+		return false;
+	dyld_static_pool* newPool = (dyld_static_pool*)addr;
+	newPool->start = (uint8_t*)((addr + sizeof(dyld_static_pool) + 15) & (-16));
+	newPool->current = newPool->start;
+	newPool->end = (uint8_t*)(addr + DYLD_POOL_CHUNK_SIZE);
+	newPool->previousPool = currentPool;
+	addPoolRegion((uint8_t*)addr);
+	currentPool = newPool;
+	sPoolBytesReserved += DYLD_POOL_CHUNK_SIZE;
+	return true;
+}
+
+// carves a new slab into blocks of one size class and puts them on its free list
+static bool addSlab(int sizeClass)
+{
+	if ( (currentPool->current + kSlabSize) > currentPool->end ) {
+		if ( !addPool() )
+			return false;
+	}
+	uint8_t* slab = currentPool->current;
+	currentPool->current += kSlabSize;
+	currentPool->slabSizeClass[(slab - currentPool->start)/kSlabSize] = sizeClass;
+	const size_t blockSize = sSizeClasses[sizeClass];
+	// push in reverse so blocks are handed out in address order
+	for (size_t i = kSlabSize/blockSize; i > 0; --i) {
+		dyld_free_block* block = (dyld_free_block*)&slab[(i-1)*blockSize];
+		block->next = sFreeBlocks[sizeClass];
+		sFreeBlocks[sizeClass] = block;
+	}
+	return true;
+}
+
+static void* poolMalloc(size_t size)
+{
+	int sizeClass = sizeClassFor(size);
+	if ( sizeClass == -1 ) {
+		// too big for a slab, give it its own pages
+		vm_address_t addr = 0;
+		vm_size_t allocSize = round_page(sizeof(dyld_large_allocation) + size);
+		if ( (allocSize < size) || (vm_allocate(mach_task_self(), &addr, allocSize, VM_FLAGS_ANYWHERE) != KERN_SUCCESS) ) {
+			dyld::log("dyld malloc overflow: size=%zu\n", size);
+			exit(1);
+		}
+		dyld_large_allocation* large = (dyld_large_allocation*)addr;
+		large->size = allocSize;
+		large->requested = size;
+		large->next = sLargeAllocations;
+		sLargeAllocations = large;
+		addLargeRegion(large);
+		++sLargeAllocationCount;
+		sPoolBytesReserved += allocSize;
+		addLiveBytes(size);
+		return &large[1];
+	}
+	if ( (sFreeBlocks[sizeClass] == NULL) && !addSlab(sizeClass) ) {
+		dyld::log("out of address space for dyld memory pool\n");
+		exit(1);
+	}
+	dyld_free_block* block = sFreeBlocks[sizeClass];
+	sFreeBlocks[sizeClass] = block->next;
+	addLiveBytes(sSizeClasses[sizeClass]);
+	return block;
+}
+
+// returns the usable size of a block allocated by poolMalloc(), or 0 if ptr is not from the pool
+static size_t poolBlockSize(const void* ptr, dyld_large_allocation*** largeLink)
+{
+	for (dyld_static_pool* p = currentPool; p != NULL; p = p->previousPool) {
+		if ( (p->start <= ptr) && (ptr < p->current) )
+			return sSizeClasses[p->slabSizeClass[((uint8_t*)ptr - p->start)/kSlabSize]];
+	}
+	for (dyld_large_allocation** link = &sLargeAllocations; *link != NULL; link = &(*link)->next) {
+		if ( ptr == &(*link)[1] ) {
+			if ( largeLink != NULL )
+				*largeLink = link;
+			return (*link)->size - sizeof(dyld_large_allocation);
+		}
+	}
+	return 0;
+}
+
+// returns false if ptr is not from the pool
+static bool poolFree(void* ptr)
+{
+	dyld_large_allocation** largeLink = NULL;
+	size_t size = poolBlockSize(ptr, &largeLink);
+	if ( size == 0 )
+		return false;
+	if ( largeLink != NULL ) {
+		dyld_large_allocation* large = *largeLink;
+		*largeLink = large->next;
+		removeLargeRegion(large);
+		--sLargeAllocationCount;
+		sPoolBytesReserved -= large->size;
+		sPoolBytesLive -= large->requested;
+		vm_deallocate(mach_task_self(), (vm_address_t)large, large->size);
+	}
+	else {
+		int sizeClass = sizeClassFor(size);
+		dyld_free_block* block = (dyld_free_block*)ptr;
+		block->next = sFreeBlocks[sizeClass];
+		sFreeBlocks[sizeClass] = block;
+		sPoolBytesLive -= size;
+	}
+	return true;
+}
 
 
 void* malloc(size_t size)
@@ -68,34 +296,10 @@ void* malloc(size_t size)
 		return p;
 	}
 	else {
-		if ( size > DYLD_POOL_CHUNK_SIZE ) {
-			dyld::log("dyld malloc overflow: size=%zu\n", size);
-			exit(1);
-		}
-		size = (size+sizeof(void*)-1) & (-sizeof(void*)); // pointer align
-		uint8_t* result = currentPool->current;
-		currentPool->current += size;
-		if ( currentPool->current > currentPool->end ) {
-			vm_address_t addr = 0;
-			kern_return_t r = vm_allocate(mach_task_self(), &addr, DYLD_POOL_CHUNK_SIZE, VM_FLAGS_ANYWHERE);
-			if ( r != KERN_SUCCESS ) {
-				dyld::log("out of address space for dyld memory pool\n");
-				exit(1);
-			}
-			dyld_static_pool* newPool = (dyld_static_pool*)addr;
-			newPool->previousPool = NULL;
-			newPool->current = newPool->pool;
-			newPool->end = (uint8_t*)(addr + DYLD_POOL_CHUNK_SIZE);
-			newPool->previousPool = currentPool;
-			currentPool = newPool;
-			if ( (currentPool->current + size) > currentPool->end ) {
-				dyld::log("dyld memory pool exhausted: size=%lu\n", size);
-				exit(1);
-			}
-			result = currentPool->current;
-			currentPool->current += size;
-		}
-		//dyld::log("%p = malloc(%3lu) from pool %p, free space = %lu\n", result, size, currentPool, (long)(currentPool->end - currentPool->current));
+		OSSpinLockLock(&sPoolLock);
+		void* result = poolMalloc(size);
+		OSSpinLockUnlock(&sPoolLock);
+		//dyld::log("%p = malloc(%3lu) from pool %p\n", result, size, currentPool);
 		return result;
 	}
 }
@@ -103,24 +307,22 @@ void* malloc(size_t size)
 
 void free(void* ptr)
 {
-	// ignore any pointer within dyld (i.e. stuff from pool or static strings)
+	if ( ptr == NULL )
+		return;
+	// pool blocks are reclaimed even after libSystem is initialized
+	// (a pointer being freed was returned by malloc() before this call, so its region is already recorded)
+	if ( mayBePoolPointer(ptr) ) {
+		OSSpinLockLock(&sPoolLock);
+		bool fromPool = poolFree(ptr);
+		OSSpinLockUnlock(&sPoolLock);
+		if ( fromPool )
+			return;
+	}
+	// ignore any other pointer within dyld (i.e. static strings)
 	if ( (dyld::gLibSystemHelpers != NULL) && ((ptr < &__dso_handle) || (ptr >= &initialPoolContent[DYLD_POOL_CHUNK_SIZE])) ) {
-		// ignore stuff in any dynamically alloated dyld pools
-		for (dyld_static_pool* p = currentPool; p != NULL; p = p->previousPool) {
-			if ( (p->pool <= ptr) && (ptr < p->end) ) {
-				// do nothing, pool entries can't be reclaimed
-				//dyld::log("free(%p) from dynamic pool\n", ptr);
-				return;
-			}
-		}
-		
 		//dyld::log("free(%p) from libSystem\n", ptr);
 		return dyld::gLibSystemHelpers->free(ptr);
 	}
-	else {
-		// do nothing, pool entries can't be reclaimed
-		//dyld::log("free(%p) from static pool\n", ptr);
-	}
 }
 
 
@@ -134,11 +336,14 @@ void* calloc(size_t count, size_t size)
 	else {
 		// Check for overflow of integer multiplication
 		size_t total = count * size;
-		if ( total/count != size ) {
+		if ( (count != 0) && (total/count != size) ) {
 			dyld::log("dyld calloc overflow: count=%zu, size=%zu\n", count, size);
 			exit(1);
 		}
-		return malloc(total);
+		// pool blocks may be reused, so are not necessarily zero filled
+		void* result = malloc(total);
+		bzero(result, total);
+		return result;
 	}
 }
 
@@ -146,10 +351,38 @@ void* calloc(size_t count, size_t size)
 void* realloc(void *ptr, size_t size)
 {
 	void* result = malloc(size);
-	memcpy(result, ptr, size);
+	if ( ptr != NULL ) {
+		size_t oldSize = 0;
+		if ( mayBePoolPointer(ptr) ) {
+			OSSpinLockLock(&sPoolLock);
+			oldSize = poolBlockSize(ptr, NULL);
+			OSSpinLockUnlock(&sPoolLock);
+		}
+		if ( (oldSize == 0) && (dyld::gLibSystemHelpers != NULL) && (dyld::gLibSystemHelpers->version >= 6) )
+			oldSize = dyld::gLibSystemHelpers->malloc_size(ptr);
+		if ( oldSize == 0 )
+			oldSize = size;
+		memcpy(result, ptr, (oldSize < size) ? oldSize : size);
+		free(ptr);
+	}
 	return result;
 }
 
+namespace dyld {
+
+void getPoolStatistics(uint64_t* bytesLive, uint64_t* bytesPeak, uint64_t* bytesWasted, uint32_t* largeAllocations)
+{
+	OSSpinLockLock(&sPoolLock);
+	*bytesLive = sPoolBytesLive;
+	*bytesPeak = sPoolBytesPeak;
+	// pool memory not handed out: free blocks, uncarved slabs and page rounding of large allocations
+	*bytesWasted = sPoolBytesReserved - sPoolBytesLive;
+	*largeAllocations = sLargeAllocationCount;
+	OSSpinLockUnlock(&sPoolLock);
+}
+
+}
+
 //     void* reallocf(void *ptr, size_t size);
 //     void* valloc(size_t size);
 
@@ -28,7 +28,7 @@
 #include <string.h>
 #include <mach-o/loader.h>
 
-#include <vector>
+#include <libkern/OSAtomic.h>
 
 #include "mach-o/dyld_gdb.h"
 #include "mach-o/dyld_images.h"
@@ -41,30 +41,167 @@
 	#define INITIAL_UUID_IMAGE_COUNT 32
 #endif
 
-VECTOR_NEVER_DESTRUCTED(dyld_image_info);
-VECTOR_NEVER_DESTRUCTED(dyld_uuid_info);
 
-static std::vector<dyld_image_info> sImageInfos;
-static std::vector<dyld_uuid_info>  sImageUUIDs;
+//
+// The infoArray and uuidArray published through dyld_all_image_infos must each be one
+// contiguous array of loaded images, but readers do not depend on the order of entries.
+// Each is kept in an AllImagesTable: a malloc()ed array with room to grow, plus a hash
+// index from load address to slot.  New entries are written past the published count and
+// then the count is published, so readers only see a NULL array while it is reallocated.
+// Removal moves the last entry into the removed slot, so load/unload churn is O(1) per
+// image instead of a linear search and a shift of every later entry.
+//
+template <typename E>
+class AllImagesTable
+{
+public:
+	uint32_t		count() const		{ return fCount; }
+	const E*		entries() const		{ return (fCount != 0) ? fEntries : NULL; }
+	bool			hasRoomFor(uint32_t extra) const { return (fCount + extra <= fCapacity); }
+	void			grow(uint32_t extra, uint32_t initialCapacity);
+	void			append(const E& entry);
+	bool			remove(const struct mach_header* loadAddress, E* removed);
+
+private:
+	static uint32_t	hash(const struct mach_header* loadAddress) { return (uint32_t)(((uintptr_t)loadAddress >> 12) * 2654435761U); }
+	void			indexAdd(uint32_t entryIndex);
+	uint32_t		indexSlot(const struct mach_header* loadAddress) const;
+	uint32_t		indexSlotOfEntry(uint32_t entryIndex) const;
+	void			indexRemoveSlot(uint32_t slot);
+
+	E*				fEntries;
+	uint32_t		fCount;
+	uint32_t		fCapacity;
+	uint32_t*		fIndex;				// entry index + 1, zero means slot unused
+	uint32_t		fIndexCapacity;		// power of two, at least twice fCapacity
+};
+
+template <typename E>
+void AllImagesTable<E>::grow(uint32_t extra, uint32_t initialCapacity)
+{
+	uint32_t newCapacity = (fCapacity != 0) ? fCapacity*2 : initialCapacity;
+	while ( newCapacity < fCount + extra )
+		newCapacity *= 2;
+	E* newEntries = (E*)malloc(newCapacity*sizeof(E));
+	uint32_t newIndexCapacity = 1;
+	while ( newIndexCapacity < newCapacity*2 )
+		newIndexCapacity *= 2;
+	uint32_t* newIndex = (uint32_t*)calloc(newIndexCapacity, sizeof(uint32_t));
+	if ( (newEntries == NULL) || (newIndex == NULL) )
+		dyld::throwf("out of memory for %u image infos", newCapacity);
+	if ( fEntries != NULL ) {
+		memcpy(newEntries, fEntries, fCount*sizeof(E));
+		free(fEntries);
+		free(fIndex);
+	}
+	fEntries = newEntries;
+	fCapacity = newCapacity;
+	fIndex = newIndex;
+	fIndexCapacity = newIndexCapacity;
+	for (uint32_t i=0; i < fCount; ++i)
+		indexAdd(i);
+}
+
+template <typename E>
+void AllImagesTable<E>::append(const E& entry)
+{
+	// caller has made room, entry is not visible to readers until caller publishes count
+	fEntries[fCount] = entry;
+	indexAdd(fCount);
+	++fCount;
+}
+
+template <typename E>
+bool AllImagesTable<E>::remove(const struct mach_header* loadAddress, E* removed)
+{
+	if ( fCount == 0 )
+		return false;
+	uint32_t slot = indexSlot(loadAddress);
+	if ( fIndex[slot] == 0 )
+		return false;
+	const uint32_t entryIndex = fIndex[slot] - 1;
+	const uint32_t lastIndex = fCount - 1;
+	*removed = fEntries[entryIndex];
+	if ( entryIndex != lastIndex ) {
+		// fill hole with last entry
+		fIndex[indexSlotOfEntry(lastIndex)] = entryIndex + 1;
+		fEntries[entryIndex] = fEntries[lastIndex];
+	}
+	indexRemoveSlot(slot);
+	--fCount;
+	return true;
+}
+
+template <typename E>
+void AllImagesTable<E>::indexAdd(uint32_t entryIndex)
+{
+	// duplicate load addresses each get a slot, lookups find the oldest first
+	const uint32_t mask = fIndexCapacity - 1;
+	uint32_t i = hash(fEntries[entryIndex].imageLoadAddress) & mask;
+	while ( fIndex[i] != 0 )
+		i = (i+1) & mask;
+	fIndex[i] = entryIndex + 1;
+}
+
+template <typename E>
+uint32_t AllImagesTable<E>::indexSlot(const struct mach_header* loadAddress) const
+{
+	// returns slot of entry, or the empty slot ending its probe chain
+	const uint32_t mask = fIndexCapacity - 1;
+	uint32_t i = hash(loadAddress) & mask;
+	while ( (fIndex[i] != 0) && (fEntries[fIndex[i]-1].imageLoadAddress != loadAddress) )
+		i = (i+1) & mask;
+	return i;
+}
+
+template <typename E>
+uint32_t AllImagesTable<E>::indexSlotOfEntry(uint32_t entryIndex) const
+{
+	// entry may share its load address with an older one, so match on index
+	const uint32_t mask = fIndexCapacity - 1;
+	uint32_t i = hash(fEntries[entryIndex].imageLoadAddress) & mask;
+	while ( fIndex[i] != entryIndex + 1 )
+		i = (i+1) & mask;
+	return i;
+}
+
+template <typename E>
+void AllImagesTable<E>::indexRemoveSlot(uint32_t slot)
+{
+	// linear probing without tombstones: shift back later entries whose chain crosses the hole
+	const uint32_t mask = fIndexCapacity - 1;
+	uint32_t hole = slot;
+	for (uint32_t i = (slot+1) & mask; fIndex[i] != 0; i = (i+1) & mask) {
+		uint32_t home = hash(fEntries[fIndex[i]-1].imageLoadAddress) & mask;
+		if ( ((i - home) & mask) >= ((i - hole) & mask) ) {
+			fIndex[hole] = fIndex[i];
+			hole = i;
+		}
+	}
+	fIndex[hole] = 0;
+}
+
+
+static AllImagesTable<dyld_image_info>	sImageInfos;
+static AllImagesTable<dyld_uuid_info>	sImageUUIDs;
 
 
 void addImagesToAllImages(uint32_t infoCount, const dyld_image_info info[])
 {
-	// make initial size large enough that we probably won't need to re-alloc it
-	if ( sImageInfos.size() == 0 )
-		sImageInfos.reserve(INITIAL_IMAGE_COUNT);
-	if ( sImageUUIDs.capacity() == 0 )
-		sImageUUIDs.reserve(4);
-	// set infoArray to NULL to denote it is in-use
-	dyld::gProcessInfo->infoArray = NULL;
+	// only when array must be reallocated, set infoArray to NULL to denote it is in-use
+	if ( !sImageInfos.hasRoomFor(infoCount) ) {
+		dyld::gProcessInfo->infoArray = NULL;
+		sImageInfos.grow(infoCount, INITIAL_IMAGE_COUNT);
+	}
 	
-	// append all new images
+	// append all new images past the published count
 	for (uint32_t i=0; i < infoCount; ++i)
-		sImageInfos.push_back(info[i]);
-	dyld::gProcessInfo->infoArrayCount = (uint32_t)sImageInfos.size();
+		sImageInfos.append(info[i]);
 	
-	// set infoArray back to base address of vector (other process can now read)
-	dyld::gProcessInfo->infoArray = &sImageInfos[0];
+	// make entries visible before the count that covers them (other process can now read)
+	OSMemoryBarrier();
+	dyld::gProcessInfo->infoArray = sImageInfos.entries();
+	dyld::gProcessInfo->infoArrayCount = sImageInfos.count();
 }
 
 #if TARGET_IPHONE_SIMULATOR
@@ -72,14 +209,15 @@ void addImagesToAllImages(uint32_t infoCount, const dyld_image_info info[])
 void syncProcessInfo()
 {
 	// may want to set version field of gProcessInfo if it might be different than host
-	if ( sImageInfos.size() == 0 ) {
-		sImageInfos.reserve(INITIAL_IMAGE_COUNT);
+	if ( sImageInfos.count() == 0 ) {
 		if ( dyld::gProcessInfo->infoArray != NULL ) {
-			for (uint32_t i=0; i < dyld::gProcessInfo->infoArrayCount; ++i) {
-				sImageInfos.push_back(dyld::gProcessInfo->infoArray[i]);
+			const uint32_t hostCount = dyld::gProcessInfo->infoArrayCount;
+			sImageInfos.grow(hostCount, INITIAL_IMAGE_COUNT);
+			for (uint32_t i=0; i < hostCount; ++i) {
+				sImageInfos.append(dyld::gProcessInfo->infoArray[i]);
 			}
-			dyld::gProcessInfo->infoArray = &sImageInfos[0];
-			dyld::gProcessInfo->infoArrayCount = (uint32_t)sImageInfos.size();
+			dyld::gProcessInfo->infoArray = sImageInfos.entries();
+			dyld::gProcessInfo->infoArrayCount = sImageInfos.count();
 		}
 	}
 	dyld::gProcessInfo->notification(dyld_image_info_change, 0, NULL);
@@ -101,52 +239,47 @@ const char* notifyGDB(enum dyld_image_states state, uint32_t infoCount, const dy
 
 void addNonSharedCacheImageUUID(const dyld_uuid_info& info)
 {
-	// set uuidArray to NULL to denote it is in-use
-	dyld::gProcessInfo->uuidArray = NULL;
+	// only when array must be reallocated, set uuidArray to NULL to denote it is in-use
+	if ( !sImageUUIDs.hasRoomFor(1) ) {
+		dyld::gProcessInfo->uuidArray = NULL;
+		sImageUUIDs.grow(1, INITIAL_UUID_IMAGE_COUNT);
+	}
 	
-	// append all new images
-	sImageUUIDs.push_back(info);
-	dyld::gProcessInfo->uuidArrayCount = sImageUUIDs.size();
+	// append new image past the published count
+	sImageUUIDs.append(info);
 	
-	// set uuidArray back to base address of vector (other process can now read)
-	dyld::gProcessInfo->uuidArray = &sImageUUIDs[0];
+	// make entry visible before the count that covers it (other process can now read)
+	OSMemoryBarrier();
+	dyld::gProcessInfo->uuidArray = sImageUUIDs.entries();
+	dyld::gProcessInfo->uuidArrayCount = sImageUUIDs.count();
 }
 
 void removeImageFromAllImages(const struct mach_header* loadAddress)
 {
 	dyld_image_info goingAway;
+	bzero(&goingAway, sizeof(goingAway));
 	
 	// set infoArray to NULL to denote it is in-use
 	dyld::gProcessInfo->infoArray = NULL;
 	
-	// remove image from infoArray
-	for (std::vector<dyld_image_info>::iterator it=sImageInfos.begin(); it != sImageInfos.end(); it++) {
-		if ( it->imageLoadAddress == loadAddress ) {
-			goingAway = *it;
-			sImageInfos.erase(it);
-			break;
-		}
-	}
-	dyld::gProcessInfo->infoArrayCount = (uint32_t)sImageInfos.size();
+	// remove image from infoArray, last image is moved into its slot
+	sImageInfos.remove(loadAddress, &goingAway);
+	dyld::gProcessInfo->infoArrayCount = sImageInfos.count();
 	
-	// set infoArray back to base address of vector
-	dyld::gProcessInfo->infoArray = &sImageInfos[0];
+	// set infoArray back to base address of table
+	dyld::gProcessInfo->infoArray = sImageInfos.entries();
 
 
-	// set uuidArrayCount to NULL to denote it is in-use
+	// set uuidArray to NULL to denote it is in-use
 	dyld::gProcessInfo->uuidArray = NULL;
 	
-	// remove image from infoArray
-	for (std::vector<dyld_uuid_info>::iterator it=sImageUUIDs.begin(); it != sImageUUIDs.end(); it++) {
-		if ( it->imageLoadAddress == loadAddress ) {
-			sImageUUIDs.erase(it);
-			break;
-		}
-	}
-	dyld::gProcessInfo->uuidArrayCount = sImageUUIDs.size();
+	// remove image from uuidArray
+	dyld_uuid_info uuidGoingAway;
+	sImageUUIDs.remove(loadAddress, &uuidGoingAway);
+	dyld::gProcessInfo->uuidArrayCount = sImageUUIDs.count();
 	
-	// set infoArray back to base address of vector
-	dyld::gProcessInfo->uuidArray = &sImageUUIDs[0];
+	// set uuidArray back to base address of table
+	dyld::gProcessInfo->uuidArray = sImageUUIDs.entries();
 
 	// tell gdb that about the new images
 	dyld::gProcessInfo->notification(dyld_image_removing, 1, &goingAway);
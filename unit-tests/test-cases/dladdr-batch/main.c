@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2015 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ * 
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ * 
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ * 
+ * @APPLE_LICENSE_HEADER_END@
+ */
+#include <stdio.h>  // fprintf(), NULL
+#include <stdbool.h>
+#include <stdlib.h> // exit(), EXIT_SUCCESS
+#include <string.h> 
+#include <dlfcn.h> 
+#include <mach-o/dyld.h> 
+
+#include "test.h" // PASS(), FAIL(), XPASS(), XFAIL()
+
+
+int bar()
+{
+	return 2;
+}
+
+static int foo()
+{
+	return 3;
+}
+
+__attribute__((visibility("hidden"))) int hide()
+{
+	return 4;
+}
+
+static int dataVar;
+
+static bool sameString(const char* a, const char* b)
+{
+	if ( (a == NULL) || (b == NULL) )
+		return (a == b);
+	return (strcmp(a, b) == 0);
+}
+
+int main()
+{
+	int local;
+	// unsorted, with duplicates, addresses in other images, and addresses in no image
+	const void* addrs[] = { &printf, (char*)&foo + 1, &bar, &local, &main, &hide, &strcmp, &bar, 
+							_dyld_get_image_header(0), &malloc, NULL, &foo, &dataVar };
+	const size_t count = sizeof(addrs)/sizeof(addrs[0]);
+	Dl_info batch[count];
+	memset(batch, 0xFF, sizeof(batch));
+
+	size_t found = dladdr_batch(addrs, batch, count);
+
+	// every entry should match what dladdr() returns for that address
+	size_t expectedFound = 0;
+	for (size_t i=0; i < count; ++i) {
+		Dl_info info;
+		if ( dladdr(addrs[i], &info) == 0 ) {
+			if ( batch[i].dli_fname != NULL ) {
+				FAIL("dladdr-batch: address %p should not be in an image", addrs[i]);
+				return EXIT_SUCCESS;
+			}
+			continue;
+		}
+		++expectedFound;
+		if ( !sameString(info.dli_fname, batch[i].dli_fname) || (info.dli_fbase != batch[i].dli_fbase) ) {
+			FAIL("dladdr-batch: image for address %p is %s instead of %s", addrs[i], batch[i].dli_fname, info.dli_fname);
+			return EXIT_SUCCESS;
+		}
+		if ( !sameString(info.dli_sname, batch[i].dli_sname) || (info.dli_saddr != batch[i].dli_saddr) ) {
+			FAIL("dladdr-batch: symbol for address %p is %s instead of %s", addrs[i], batch[i].dli_sname, info.dli_sname);
+			return EXIT_SUCCESS;
+		}
+	}
+	if ( found != expectedFound ) {
+		FAIL("dladdr-batch: found %lu addresses, expected %lu", found, expectedFound);
+		return EXIT_SUCCESS;
+	}
+	if ( !sameString(batch[2].dli_sname, "bar") || !sameString(batch[1].dli_sname, "foo") ) {
+		FAIL("dladdr-batch: wrong symbols for bar and foo+1");
+		return EXIT_SUCCESS;
+	}
+  
+	PASS("dladdr-batch");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2015 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ * 
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ * 
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ * 
+ * @APPLE_LICENSE_HEADER_END@
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <dlfcn.h>
+
+#include "test.h"
+
+
+int main(int argc, const char* argv[])
+{
+	const char* stashPath = argv[1];
+	const char* latePath = argv[2];
+
+	// put libbar.dylib back in case a previous run was interrupted
+	rename(latePath, stashPath);
+
+	// found in DYLD_LIBRARY_PATH, then again after being unloaded
+	for (int i=0; i < 3; ++i) {
+		void* handle = dlopen("libfoo.dylib", RTLD_LAZY);
+		if ( handle == NULL ) {
+			FAIL("dlopen-DYLD_LIBRARY_PATH-cache: %s", dlerror());
+			return EXIT_SUCCESS;
+		}
+		if ( dlsym(handle, "foo") == NULL ) {
+			FAIL("dlopen-DYLD_LIBRARY_PATH-cache: %s", dlerror());
+			return EXIT_SUCCESS;
+		}
+		dlclose(handle);
+	}
+
+	// missing from DYLD_LIBRARY_PATH and from the path given
+	if ( dlopen(latePath, RTLD_LAZY) != NULL ) {
+		FAIL("dlopen-DYLD_LIBRARY_PATH-cache: libbar.dylib should not be found yet");
+		return EXIT_SUCCESS;
+	}
+
+	if ( rename(stashPath, latePath) != 0 ) {
+		FAIL("dlopen-DYLD_LIBRARY_PATH-cache: could not move libbar.dylib");
+		return EXIT_SUCCESS;
+	}
+
+	// a path named explicitly is never answered from the cache
+	void* handle = dlopen(latePath, RTLD_LAZY);
+	rename(latePath, stashPath);
+	if ( handle == NULL ) {
+		FAIL("dlopen-DYLD_LIBRARY_PATH-cache: %s", dlerror());
+		return EXIT_SUCCESS;
+	}
+
+	PASS("dlopen-DYLD_LIBRARY_PATH-cache");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2015 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ * 
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ * 
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ * 
+ * @APPLE_LICENSE_HEADER_END@
+ */
+#include <stdio.h>  // fprintf(), NULL
+#include <stdlib.h> // exit(), EXIT_SUCCESS
+#include <string.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <mach/mach_time.h> 
+
+#include "test.h" // PASS(), FAIL(), XPASS(), XFAIL()
+
+#define LOOKUPS_PER_THREAD	200000
+#define MAX_THREADS			32
+
+typedef int (*proc_t)();
+
+static void*			sHandle = NULL;
+static volatile int		sStopChurning = 0;
+
+
+static uint64_t nanoseconds(uint64_t machTime)
+{
+	static mach_timebase_info_data_t timebase;
+	if ( timebase.denom == 0 )
+		mach_timebase_info(&timebase);
+	return machTime * timebase.numer / timebase.denom;
+}
+
+// looks up symbols in libfoo.dylib, every 16th lookup is of a missing symbol
+static void* lookup(void* ignore)
+{
+	static const char* const names[] = { "foo", "bar", "baz" };
+	for (int i=0; i < LOOKUPS_PER_THREAD; ++i) {
+		if ( (i % 16) == 15 ) {
+			if ( dlsym(sHandle, "missing") != NULL ) {
+				FAIL("dlsym-threaded-scaling: found missing symbol");
+				exit(0);
+			}
+			if ( dlerror() == NULL ) {
+				FAIL("dlsym-threaded-scaling: no dlerror() for missing symbol");
+				exit(0);
+			}
+			continue;
+		}
+		int which = i % 3;
+		proc_t proc = (proc_t)dlsym(sHandle, names[which]);
+		if ( (proc == NULL) || ((*proc)() != 10+which) ) {
+			FAIL("dlsym-threaded-scaling: dlsym(%s) failed: %s", names[which], dlerror());
+			exit(0);
+		}
+	}
+	return NULL;
+}
+
+// takes the global lock over and over while the lookups run
+static void* churn(void* ignore)
+{
+	while ( !sStopChurning ) {
+		void* h = dlopen("libchurn.dylib", RTLD_LAZY);
+		if ( h == NULL ) {
+			FAIL("dlsym-threaded-scaling: dlopen(libchurn.dylib) failed: %s", dlerror());
+			exit(0);
+		}
+		if ( dlsym(h, "churn") == NULL ) {
+			FAIL("dlsym-threaded-scaling: dlsym(churn) failed: %s", dlerror());
+			exit(0);
+		}
+		dlclose(h);
+		// will fail and cause exception to be thrown inside dyld
+		dlopen("/frazzle/dazzle", RTLD_LAZY);
+	}
+	return NULL;
+}
+
+
+int main()
+{
+	sHandle = dlopen("libfoo.dylib", RTLD_LAZY);
+	if ( sHandle == NULL ) {
+		FAIL("dlsym-threaded-scaling: dlopen(libfoo.dylib) failed: %s", dlerror());
+		exit(0);
+	}
+
+	pthread_t churner;
+	if ( pthread_create(&churner, NULL, churn, NULL) != 0 ) {
+		FAIL("dlsym-threaded-scaling: pthread_create failed");
+		exit(0);
+	}
+
+	for (int threadCount=1; threadCount <= MAX_THREADS; threadCount *= 2) {
+		pthread_t workers[MAX_THREADS];
+		uint64_t start = mach_absolute_time();
+		for (int i=0; i < threadCount; ++i) {
+			if ( pthread_create(&workers[i], NULL, lookup, NULL) != 0 ) {
+				FAIL("dlsym-threaded-scaling: pthread_create failed");
+				exit(0);
+			}
+		}
+		for (int i=0; i < threadCount; ++i) {
+			void* result;
+			pthread_join(workers[i], &result);
+		}
+		uint64_t ns = nanoseconds(mach_absolute_time() - start);
+		uint64_t lookups = (uint64_t)threadCount * LOOKUPS_PER_THREAD;
+		printf("%2d threads: %llu dlsym() calls per ms\n", threadCount, (ns != 0) ? lookups*1000000/ns : 0);
+	}
+
+	sStopChurning = 1;
+	void* result;
+	pthread_join(churner, &result);
+
+	// execute leaks command on myself
+	char cmd[512];
+	sprintf(cmd, "sudo leaks %u > /dev/null\n", getpid());
+	int status = system(cmd);
+	if ( status == EXIT_SUCCESS )
+		PASS("dlsym-threaded-scaling");
+	else
+		FAIL("dlsym-threaded-scaling");
+	 	
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2015 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ * 
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ * 
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ * 
+ * @APPLE_LICENSE_HEADER_END@
+ */
+#include <stdio.h>  // fprintf(), NULL
+#include <stdlib.h> // exit(), EXIT_SUCCESS
+#include <string.h>
+#include <dlfcn.h>
+#include <mach/mach_time.h> 
+
+#include "test.h" // PASS(), FAIL(), XPASS(), XFAIL()
+
+#define IMAGE_COUNT		200
+#define LOOKUP_COUNT	20000
+
+typedef int (*proc_t)();
+
+
+static uint64_t nanoseconds(uint64_t machTime)
+{
+	static mach_timebase_info_data_t timebase;
+	if ( timebase.denom == 0 )
+		mach_timebase_info(&timebase);
+	return machTime * timebase.numer / timebase.denom;
+}
+
+
+int main()
+{
+	for (int i=0; i < IMAGE_COUNT; ++i) {
+		char path[64];
+		sprintf(path, "foo%d%03d.bundle", i/20, i%20);
+		if ( dlopen(path, RTLD_LAZY) == NULL ) {
+			FAIL("flat-lookup-benchmark: dlopen(%s) failed: %s", path, dlerror());
+			exit(0);
+		}
+	}
+
+	// names that share prefixes with exports, so trie walks go a few levels before failing
+	static char names[LOOKUP_COUNT][16];
+	for (int i=0; i < LOOKUP_COUNT; ++i)
+		sprintf(names[i], "foo%dx", i);
+
+	uint64_t start = mach_absolute_time();
+	for (int i=0; i < LOOKUP_COUNT; ++i) {
+		if ( dlsym(RTLD_DEFAULT, names[i]) != NULL ) {
+			FAIL("flat-lookup-benchmark: found %s", names[i]);
+			exit(0);
+		}
+	}
+	uint64_t ns = nanoseconds(mach_absolute_time() - start);
+
+	// and a name that is found, in the first copy
+	proc_t proc = (proc_t)dlsym(RTLD_DEFAULT, "fizzbuzz");
+	if ( (proc == NULL) || ((*proc)() != 19) ) {
+		FAIL("flat-lookup-benchmark: dlsym(fizzbuzz) failed: %s", dlerror());
+		exit(0);
+	}
+
+	printf("%d flat lookups over %d images in %llu us, %llu ns per image searched\n", LOOKUP_COUNT, IMAGE_COUNT, 
+			ns/1000, ns/((uint64_t)LOOKUP_COUNT*IMAGE_COUNT));
+	PASS("flat-lookup-benchmark");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2015 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ * 
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ * 
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ * 
+ * @APPLE_LICENSE_HEADER_END@
+ */
+#include <stdio.h>  // fprintf(), NULL
+#include <stdlib.h> // exit(), EXIT_SUCCESS
+#include <string.h> 
+#include <limits.h> 
+#include <dlfcn.h> 
+#include <mach/mach_time.h> 
+#include <mach-o/dyld.h> 
+#include <mach-o/dyld_priv.h> 
+
+#include "test.h" // PASS(), FAIL(), XPASS(), XFAIL()
+
+
+static const char*	sExpectedPath = NULL;
+static int			sMappedCount = 0;
+static int			sBoundCount = 0;
+static int			sInitializedCount = 0;
+
+
+// each dlopen() should report only the bundle it loaded
+static void checkInfos(const char* which, uint32_t infoCount, const struct dyld_image_info info[])
+{
+	if ( sExpectedPath == NULL )
+		return;
+	if ( infoCount != 1 ) {
+		FAIL("image-state-batch-performance: %s handler given %u images for %s", which, infoCount, sExpectedPath);
+		exit(0);
+	}
+	if ( strstr(info[0].imageFilePath, sExpectedPath) == NULL ) {
+		FAIL("image-state-batch-performance: %s handler given %s, expected %s", which, info[0].imageFilePath, sExpectedPath);
+		exit(0);
+	}
+}
+
+static const char* batchMappedHandler(enum dyld_image_states state, uint32_t infoCount, const struct dyld_image_info info[])
+{
+	checkInfos("dependents_mapped", infoCount, info);
+	sMappedCount += infoCount;
+	return NULL;
+}
+
+static const char* batchBoundHandler(enum dyld_image_states state, uint32_t infoCount, const struct dyld_image_info info[])
+{
+	checkInfos("bound", infoCount, info);
+	sBoundCount += infoCount;
+	return NULL;
+}
+
+static const char* batchInitializedHandler(enum dyld_image_states state, uint32_t infoCount, const struct dyld_image_info info[])
+{
+	checkInfos("initialized", infoCount, info);
+	sInitializedCount += infoCount;
+	return NULL;
+}
+
+
+static uint64_t nanoseconds(uint64_t machTime)
+{
+	static mach_timebase_info_data_t timebase;
+	if ( timebase.denom == 0 )
+		mach_timebase_info(&timebase);
+	return machTime * timebase.numer / timebase.denom;
+}
+
+
+int main(int argc, const char* argv[])
+{
+	int bundleCount = (argc > 1) ? atoi(argv[1]) : 1000;
+
+	// registration reports existing images, so reset counts afterwards
+	dyld_register_image_state_change_handler(dyld_image_state_dependents_mapped, true, batchMappedHandler);
+	dyld_register_image_state_change_handler(dyld_image_state_bound, true, batchBoundHandler);
+	dyld_register_image_state_change_handler(dyld_image_state_initialized, true, batchInitializedHandler);
+	sMappedCount = 0;
+	sBoundCount = 0;
+	sInitializedCount = 0;
+
+	uint64_t start = mach_absolute_time();
+	for (int i=0; i < bundleCount; ++i) {
+		char path[PATH_MAX];
+		snprintf(path, sizeof(path), "bundles/bar%d.bundle", i);
+		sExpectedPath = path;
+		void* handle = dlopen(path, RTLD_LAZY);
+		if ( handle == NULL ) {
+			FAIL("image-state-batch-performance: dlopen(%s) failed: %s", path, dlerror());
+			exit(0);
+		}
+	}
+	uint64_t totalTime = mach_absolute_time() - start;
+	sExpectedPath = NULL;
+
+	if ( (sMappedCount != bundleCount) || (sBoundCount != bundleCount) || (sInitializedCount != bundleCount) ) {
+		FAIL("image-state-batch-performance: expected %d notifications per state, got mapped=%d bound=%d initialized=%d", 
+				bundleCount, sMappedCount, sBoundCount, sInitializedCount);
+		exit(0);
+	}
+	printf("%d bundles: %llu us per dlopen()\n", bundleCount, nanoseconds(totalTime)/bundleCount/1000);
+
+	PASS("image-state-batch-performance");
+	return EXIT_SUCCESS;
+}
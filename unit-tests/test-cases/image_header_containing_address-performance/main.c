@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2015 Apple Computer, Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ * 
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ * 
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ * 
+ * @APPLE_LICENSE_HEADER_END@
+ */
+#include <stdio.h>  // fprintf(), NULL
+#include <stdlib.h> // exit(), EXIT_SUCCESS
+#include <string.h> 
+#include <limits.h> 
+#include <dlfcn.h> 
+#include <mach/mach_time.h> 
+#include <mach-o/dyld.h> 
+#include <mach-o/dyld_priv.h> 
+
+#include "test.h" // PASS(), FAIL(), XPASS(), XFAIL()
+
+#define LOOKUPS_PER_ROUND	100000
+
+static const void*				sAddrs[2000];
+static const struct mach_header* sHeaders[2000];
+
+
+static uint64_t nanoseconds(uint64_t machTime)
+{
+	static mach_timebase_info_data_t timebase;
+	if ( timebase.denom == 0 )
+		mach_timebase_info(&timebase);
+	return machTime * timebase.numer / timebase.denom;
+}
+
+// look up addresses spread across all loaded bundles, verifying each result
+static void timeLookups(int count)
+{
+	uint64_t start = mach_absolute_time();
+	for (int i=0; i < LOOKUPS_PER_ROUND; ++i) {
+		int index = (i * 7919) % count;
+		if ( dyld_image_header_containing_address(sAddrs[index]) != sHeaders[index] ) {
+			FAIL("image_header_containing_address-performance: wrong image for bundle %d", index);
+			exit(0);
+		}
+	}
+	uint64_t headerTime = mach_absolute_time() - start;
+
+	start = mach_absolute_time();
+	for (int i=0; i < LOOKUPS_PER_ROUND; ++i) {
+		Dl_info info;
+		int index = (i * 7919) % count;
+		if ( (dladdr(sAddrs[index], &info) == 0) || (info.dli_fbase != sHeaders[index]) ) {
+			FAIL("image_header_containing_address-performance: dladdr wrong image for bundle %d", index);
+			exit(0);
+		}
+	}
+	uint64_t dladdrTime = mach_absolute_time() - start;
+
+	printf("%5d bundles: dyld_image_header_containing_address() %llu ns, dladdr() %llu ns per call\n", count,
+			nanoseconds(headerTime)/LOOKUPS_PER_ROUND, nanoseconds(dladdrTime)/LOOKUPS_PER_ROUND);
+}
+
+
+int main(int argc, const char* argv[])
+{
+	int bundleCount = (argc > 1) ? atoi(argv[1]) : 2000;
+	if ( bundleCount > 2000 )
+		bundleCount = 2000;
+	int loaded = 0;
+	const int rounds[] = { 100, 500, 2000 };
+	for (int r=0; r < 3; ++r) {
+		int target = (rounds[r] < bundleCount) ? rounds[r] : bundleCount;
+		for ( ; loaded < target; ++loaded) {
+			char path[PATH_MAX];
+			snprintf(path, sizeof(path), "bundles/bar%d.bundle", loaded);
+			void* handle = dlopen(path, RTLD_LAZY);
+			if ( handle == NULL ) {
+				FAIL("image_header_containing_address-performance: dlopen(%s) failed: %s", path, dlerror());
+				exit(0);
+			}
+			sAddrs[loaded] = dlsym(handle, "bar");
+			if ( sAddrs[loaded] == NULL ) {
+				FAIL("image_header_containing_address-performance: dlsym(bar) failed in %s", path);
+				exit(0);
+			}
+			Dl_info info;
+			if ( dladdr(sAddrs[loaded], &info) == 0 ) {
+				FAIL("image_header_containing_address-performance: dladdr() failed in %s", path);
+				exit(0);
+			}
+			sHeaders[loaded] = (const struct mach_header*)info.dli_fbase;
+		}
+		timeLookups(loaded);
+		if ( loaded == bundleCount )
+			break;
+	}
+
+	PASS("image_header_containing_address-performance");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2015 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ * 
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ * 
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ * 
+ * @APPLE_LICENSE_HEADER_END@
+ */
+#include <stdio.h>  // fprintf(), NULL
+#include <stdlib.h> // exit(), EXIT_SUCCESS
+#include <string.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <mach/mach_time.h> 
+
+#include "test.h" // PASS(), FAIL(), XPASS(), XFAIL()
+
+#define STUB_COUNT			1000
+#define MAX_THREADS			32
+
+typedef int (*callStub_t)(int);
+
+static callStub_t		sCallStub = NULL;
+static volatile int		sGo = 0;
+static volatile int		sStopChurning = 0;
+
+
+static uint64_t nanoseconds(uint64_t machTime)
+{
+	static mach_timebase_info_data_t timebase;
+	if ( timebase.denom == 0 )
+		mach_timebase_info(&timebase);
+	return machTime * timebase.numer / timebase.denom;
+}
+
+// calls every stub once, starting at a different stub in each thread so threads collide on binds
+static void* callAll(void* p)
+{
+	int first = (int)(long)p;
+	while ( !sGo )
+		;
+	for (int i=0; i < STUB_COUNT; ++i) {
+		int n = (first + i) % STUB_COUNT;
+		int result = (*sCallStub)(n);
+		if ( result != n ) {
+			FAIL("lazy-bind-threaded-throughput: stub %d returned %d", n, result);
+			exit(0);
+		}
+	}
+	return NULL;
+}
+
+// takes the global lock over and over while the binds run
+static void* churn(void* ignore)
+{
+	while ( !sStopChurning ) {
+		void* h = dlopen("libchurn.dylib", RTLD_LAZY);
+		if ( h == NULL ) {
+			FAIL("lazy-bind-threaded-throughput: dlopen(libchurn.dylib) failed: %s", dlerror());
+			exit(0);
+		}
+		dlclose(h);
+	}
+	return NULL;
+}
+
+
+int main()
+{
+	pthread_t churner;
+	if ( pthread_create(&churner, NULL, churn, NULL) != 0 ) {
+		FAIL("lazy-bind-threaded-throughput: pthread_create failed");
+		exit(0);
+	}
+
+	for (int threadCount=1; threadCount <= MAX_THREADS; threadCount *= 2) {
+		// a fresh copy of the bundle, so all its stubs are unbound
+		char path[64];
+		sprintf(path, "stubs%d.bundle", threadCount);
+		void* handle = dlopen(path, RTLD_LAZY);
+		if ( handle == NULL ) {
+			FAIL("lazy-bind-threaded-throughput: dlopen(%s) failed: %s", path, dlerror());
+			exit(0);
+		}
+		sCallStub = (callStub_t)dlsym(handle, "callStub");
+		if ( sCallStub == NULL ) {
+			FAIL("lazy-bind-threaded-throughput: dlsym(callStub) failed: %s", dlerror());
+			exit(0);
+		}
+
+		pthread_t workers[MAX_THREADS];
+		sGo = 0;
+		for (int i=0; i < threadCount; ++i) {
+			if ( pthread_create(&workers[i], NULL, callAll, (void*)(long)(i*STUB_COUNT/threadCount)) != 0 ) {
+				FAIL("lazy-bind-threaded-throughput: pthread_create failed");
+				exit(0);
+			}
+		}
+		uint64_t start = mach_absolute_time();
+		sGo = 1;
+		for (int i=0; i < threadCount; ++i) {
+			void* result;
+			pthread_join(workers[i], &result);
+		}
+		uint64_t ns = nanoseconds(mach_absolute_time() - start);
+		printf("%2d threads: %d stubs bound in %llu us, %llu stub calls per ms\n", threadCount, STUB_COUNT, ns/1000,
+				(ns != 0) ? (uint64_t)threadCount*STUB_COUNT*1000000/ns : 0);
+	}
+
+	sStopChurning = 1;
+	void* result;
+	pthread_join(churner, &result);
+
+	PASS("lazy-bind-threaded-throughput");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2015 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ * 
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ * 
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ * 
+ * @APPLE_LICENSE_HEADER_END@
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <dlfcn.h>
+
+#include "test.h"
+
+
+int main(int argc, const char* argv[])
+{
+	const char* stashPath = argv[1];
+	const char* rpathPath = argv[2];
+
+	// put libbar.dylib back in case a previous run was interrupted
+	rename(rpathPath, stashPath);
+
+	// probes hide/empty first, then finds libfoo.dylib in hide/hole
+	for (int i=0; i < 2; ++i) {
+		void* handle = dlopen("@rpath/libfoo.dylib", RTLD_LAZY);
+		if ( handle == NULL ) {
+			FAIL("rpath-path-cache: %s", dlerror());
+			return EXIT_SUCCESS;
+		}
+		if ( dlsym(handle, "foo") == NULL ) {
+			FAIL("rpath-path-cache: %s", dlerror());
+			return EXIT_SUCCESS;
+		}
+	}
+
+	if ( dlopen("@rpath/libbar.dylib", RTLD_LAZY) != NULL ) {
+		FAIL("rpath-path-cache: libbar.dylib should not be found yet");
+		return EXIT_SUCCESS;
+	}
+
+	if ( rename(stashPath, rpathPath) != 0 ) {
+		FAIL("rpath-path-cache: could not move libbar.dylib into rpath");
+		return EXIT_SUCCESS;
+	}
+
+	// hide/empty/libbar.dylib is remembered as missing
+	if ( dlopen("@rpath/libbar.dylib", RTLD_LAZY) != NULL ) {
+		FAIL("rpath-path-cache: missing rpath candidate was probed again");
+		rename(rpathPath, stashPath);
+		return EXIT_SUCCESS;
+	}
+
+	// RTLD_NOCACHE forgets what was missing
+	void* handle = dlopen("@rpath/libbar.dylib", RTLD_LAZY | RTLD_NOCACHE);
+	rename(rpathPath, stashPath);
+	if ( handle == NULL ) {
+		FAIL("rpath-path-cache: RTLD_NOCACHE: %s", dlerror());
+		return EXIT_SUCCESS;
+	}
+
+	PASS("rpath-path-cache");
+	return EXIT_SUCCESS;
+}